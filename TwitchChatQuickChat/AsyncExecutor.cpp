@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "AsyncExecutor.h"
+#include "Trace.h"
+#include <algorithm>
+
+namespace {
+    // Cancellation flag of the task running on this worker, if any
+    thread_local std::atomic<bool>* currentCancelled = nullptr;
+}
+
+AsyncExecutor& AsyncExecutor::Get() {
+    static AsyncExecutor executor;
+    return executor;
+}
+
+AsyncExecutor::~AsyncExecutor() {
+    Shutdown();
+}
+
+bool AsyncExecutor::IsCancellationRequested() {
+    if (Get().cancelled_.load(std::memory_order_acquire)) {
+        return true;
+    }
+    return currentCancelled && currentCancelled->load(std::memory_order_acquire);
+}
+
+AsyncExecutor::CancelScope::CancelScope(std::function<void()> onCancel)
+    : onCancel_(std::move(onCancel))
+{
+    AsyncExecutor& executor = Get();
+    std::lock_guard<std::mutex> lock(executor.mutex_);
+    executor.cancelScopes_.push_back(this);
+}
+
+AsyncExecutor::CancelScope::~CancelScope() {
+    // Shutdown() calls onCancel_ under the same lock, so it can't be running past here
+    AsyncExecutor& executor = Get();
+    std::lock_guard<std::mutex> lock(executor.mutex_);
+    executor.cancelScopes_.erase(std::find(executor.cancelScopes_.begin(), executor.cancelScopes_.end(), this));
+}
+
+size_t AsyncExecutor::Outstanding() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + urgent_.size() + running_;
+}
+
+void AsyncExecutor::Enqueue(Job job, bool urgent) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopping_ && urgent) {
+            urgent_.push_back(std::move(job));
+            // Whichever is free first takes it: an idle worker or the urgent one
+            if (!urgentWorker_.joinable()) {
+                urgentWorker_ = std::thread(&AsyncExecutor::WorkerLoop, this, true);
+            }
+            cv_.notify_all();
+            return;
+        }
+        if (!stopping_) {
+            queue_.push_back(std::move(job));
+
+            // Reuse idle workers; only grow the pool when there's more work than them
+            if (queue_.size() > idleWorkers_ && workers_.size() < kMaxWorkers) {
+                workers_.emplace_back(&AsyncExecutor::WorkerLoop, this, false);
+            } else {
+                cv_.notify_one();
+            }
+            return;
+        }
+    }
+
+    job.cancel();
+}
+
+void AsyncExecutor::WorkerLoop(bool urgentOnly) {
+    Trace::SetThreadName(urgentOnly ? "Urgent worker" : "Worker");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (!urgentOnly) {
+            ++idleWorkers_;
+        }
+        cv_.wait(lock, [this, urgentOnly]() { return stopping_ || !urgent_.empty() || (!urgentOnly && !queue_.empty()); });
+        if (!urgentOnly) {
+            --idleWorkers_;
+        }
+
+        if (urgent_.empty() && (urgentOnly || queue_.empty())) {
+            // Shutting down and nothing left to hand out
+            return;
+        }
+
+        std::deque<Job>& source = !urgent_.empty() ? urgent_ : queue_;
+
+        Job job = std::move(source.front());
+        source.pop_front();
+
+        if (job.cancelled->load(std::memory_order_acquire)) {
+            lock.unlock();
+            job.cancel();
+            lock.lock();
+            continue;
+        }
+
+        ++running_;
+        lock.unlock();
+
+        currentCancelled = job.cancelled.get();
+        job.run();
+        currentCancelled = nullptr;
+        // Release the task's captures before reporting it finished
+        job = Job();
+
+        lock.lock();
+        --running_;
+        if (queue_.empty() && urgent_.empty() && running_ == 0) {
+            drainedCv_.notify_all();
+        }
+    }
+}
+
+void AsyncExecutor::Shutdown(std::chrono::milliseconds drainTimeout) {
+    std::deque<Job> dropped;
+    std::vector<std::thread> workers;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+        cv_.notify_all();
+
+        // Workers keep taking queued tasks, without being told to cancel, until
+        // everything has finished or time is up
+        if (drainTimeout.count() > 0 && !workers_.empty()) {
+            drainedCv_.wait_for(lock, drainTimeout, [this]() { return queue_.empty() && urgent_.empty() && running_ == 0; });
+        }
+        cancelled_ = true;
+
+        // Break off blocking calls that don't poll the flag
+        for (CancelScope* scope : cancelScopes_) {
+            scope->onCancel_();
+        }
+
+        dropped.swap(queue_);
+        for (Job& job : urgent_) {
+            dropped.push_back(std::move(job));
+        }
+        urgent_.clear();
+        workers.swap(workers_);
+        if (urgentWorker_.joinable()) {
+            workers.push_back(std::move(urgentWorker_));
+        }
+    }
+
+    for (Job& job : dropped) {
+        job.cancel();
+    }
+
+    // Running tasks return promptly: blocking loops poll the flag, and other calls were
+    // broken off above
+    for (std::thread& worker : workers) {
+        if (worker.get_id() == std::this_thread::get_id()) {
+            // Shutdown from inside a task: that worker exits on its own once the task returns
+            worker.detach();
+        } else if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
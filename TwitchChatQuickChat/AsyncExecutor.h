@@ -0,0 +1,177 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Thrown from AsyncTask::Get() when the task was cancelled before it ran
+class TaskCancelled : public std::exception {
+public:
+    const char* what() const noexcept override { return "task cancelled"; }
+};
+
+// Handle to work submitted to the AsyncExecutor. Copies share the same task.
+template <typename T>
+class AsyncTask {
+public:
+    AsyncTask() = default;
+    AsyncTask(std::shared_future<T> future, std::shared_ptr<std::atomic<bool>> cancelled)
+        : future_(std::move(future)), cancelled_(std::move(cancelled)) {
+    }
+
+    // A queued task is dropped; a running one sees AsyncExecutor::IsCancellationRequested()
+    void Cancel() {
+        if (cancelled_) {
+            cancelled_->store(true, std::memory_order_release);
+        }
+    }
+    bool IsCancelled() const { return cancelled_ && cancelled_->load(std::memory_order_acquire); }
+
+    bool Valid() const { return future_.valid(); }
+    bool IsReady() const { return future_.valid() && future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+    template <typename Rep, typename Period>
+    bool WaitFor(std::chrono::duration<Rep, Period> timeout) const {
+        return future_.valid() && future_.wait_for(timeout) == std::future_status::ready;
+    }
+    // Blocks for the result; rethrows the task's exception or TaskCancelled
+    decltype(auto) Get() const { return future_.get(); }
+
+private:
+    std::shared_future<T> future_;
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// Small bounded worker pool for blocking network calls (Helix requests, handshakes).
+//
+// Replaces one detached thread per request: workers are started on demand up to
+// kMaxWorkers and reused, and Shutdown() on plugin unload drains or cancels whatever
+// is still queued and waits for running work, so no task outlives the DLL.
+//
+// Tasks block (a Helix call can wait out the rate limit for seconds), so a few slow
+// ones can hold every worker. Urgent tasks go ahead of the queue and have one more
+// worker that only runs them, so they start even when the pool is tied up.
+class AsyncExecutor {
+public:
+    static constexpr size_t kMaxWorkers = 4;
+    // How often blocking loops in tasks (connects, handshakes) check for cancellation
+    static constexpr std::chrono::milliseconds kCancelPollInterval{ 100 };
+
+    // For blocking calls a task can't poll, e.g. an httplib request: while the scope is
+    // alive, onCancel runs once Shutdown() runs out of drain time, from the thread
+    // calling Shutdown(), and should make the call return (close its socket). It must
+    // not block. It has finished by the time the destructor returns. Check
+    // IsCancellationRequested() after opening the scope, since onCancel only covers
+    // cancellation that happens later.
+    class CancelScope {
+    public:
+        explicit CancelScope(std::function<void()> onCancel);
+        ~CancelScope();
+
+        CancelScope(const CancelScope&) = delete;
+        CancelScope& operator=(const CancelScope&) = delete;
+
+    private:
+        friend class AsyncExecutor;
+        std::function<void()> onCancel_;
+    };
+
+    static AsyncExecutor& Get();
+
+    template <typename Fn>
+    auto Submit(Fn&& fn) -> AsyncTask<std::invoke_result_t<std::decay_t<Fn>&>>;
+    // For work that loses something if it waits, e.g. resolving a prediction
+    template <typename Fn>
+    auto SubmitUrgent(Fn&& fn) -> AsyncTask<std::invoke_result_t<std::decay_t<Fn>&>>;
+
+    // Stops accepting work, lets queued and running tasks finish for up to drainTimeout,
+    // then cancels what is left and joins the workers. Tasks submitted afterwards are
+    // cancelled immediately.
+    void Shutdown(std::chrono::milliseconds drainTimeout = std::chrono::milliseconds(0));
+
+    // For the task running on the calling worker: Cancel() was called, or Shutdown() ran
+    // out of drain time. Tasks check this before handing results back to the game thread.
+    static bool IsCancellationRequested();
+
+    // Queued plus running tasks
+    size_t Outstanding() const;
+
+private:
+    struct Job {
+        std::function<void()> run;
+        std::function<void()> cancel;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+    AsyncExecutor() = default;
+    ~AsyncExecutor();
+
+    template <typename Fn>
+    auto MakeJob(Fn&& fn, Job& job) -> AsyncTask<std::invoke_result_t<std::decay_t<Fn>&>>;
+    void Enqueue(Job job, bool urgent);
+    // The urgent worker only takes urgent jobs; the others take them first
+    void WorkerLoop(bool urgentOnly);
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable drainedCv_;
+    std::deque<Job> queue_;
+    std::deque<Job> urgent_;
+    std::vector<std::thread> workers_;
+    std::thread urgentWorker_;
+    size_t idleWorkers_ = 0;
+    size_t running_ = 0;
+    std::vector<CancelScope*> cancelScopes_;
+    std::atomic<bool> stopping_{ false };     // no new work; queued work still runs
+    std::atomic<bool> cancelled_{ false };    // drain time is up; running tasks should stop
+};
+
+template <typename Fn>
+auto AsyncExecutor::Submit(Fn&& fn) -> AsyncTask<std::invoke_result_t<std::decay_t<Fn>&>> {
+    Job job;
+    auto task = MakeJob(std::forward<Fn>(fn), job);
+    Enqueue(std::move(job), false);
+    return task;
+}
+
+template <typename Fn>
+auto AsyncExecutor::SubmitUrgent(Fn&& fn) -> AsyncTask<std::invoke_result_t<std::decay_t<Fn>&>> {
+    Job job;
+    auto task = MakeJob(std::forward<Fn>(fn), job);
+    Enqueue(std::move(job), true);
+    return task;
+}
+
+template <typename Fn>
+auto AsyncExecutor::MakeJob(Fn&& fn, Job& job) -> AsyncTask<std::invoke_result_t<std::decay_t<Fn>&>> {
+    using Result = std::invoke_result_t<std::decay_t<Fn>&>;
+
+    auto promise = std::make_shared<std::promise<Result>>();
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    AsyncTask<Result> task(promise->get_future().share(), cancelled);
+
+    job.cancelled = cancelled;
+    job.run = [promise, work = std::forward<Fn>(fn)]() mutable {
+        try {
+            if constexpr (std::is_void_v<Result>) {
+                work();
+                promise->set_value();
+            } else {
+                promise->set_value(work());
+            }
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    };
+    job.cancel = [promise]() {
+        promise->set_exception(std::make_exception_ptr(TaskCancelled()));
+    };
+    return task;
+}
@@ -0,0 +1,231 @@
+#include "pch.h"
+#include "AsyncLog.h"
+#include "FilePath.h"
+#include <ctime>
+
+AsyncLog& AsyncLog::Get() {
+    static AsyncLog instance;
+    return instance;
+}
+
+AsyncLog::AsyncLog() {
+    for (size_t i = 0; i < kCapacity; ++i) {
+        records_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+AsyncLog::~AsyncLog() {
+    Stop();
+}
+
+void AsyncLog::Start(ConsoleSink console) {
+    {
+        std::lock_guard<std::mutex> lock(sinkMutex_);
+        console_ = std::move(console);
+    }
+    if (running_.exchange(true)) {
+        return;
+    }
+    stopping_ = false;
+    consumer_ = std::thread(&AsyncLog::ConsumerLoop, this);
+}
+
+void AsyncLog::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    // Callers that saw running_ just before may still be filling a slot they claimed;
+    // once they are done nothing else can enter the ring, and the consumer drains it
+    while (writers_.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stopping_ = true;
+    }
+    wakeCv_.notify_one();
+    if (consumer_.joinable()) {
+        consumer_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    console_ = nullptr;
+}
+
+void AsyncLog::SetFile(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    filePath_ = path;
+    fileBytes_ = 0;
+}
+
+bool AsyncLog::BeginWrite() {
+    // Counted before running_ is checked; Stop() clears running_ before it waits for
+    // the count, so either it sees this call or this call sees it stopped
+    writers_.fetch_add(1, std::memory_order_seq_cst);
+    if (!running_.load(std::memory_order_seq_cst)) {
+        EndWrite();
+        return false;
+    }
+    return true;
+}
+
+void AsyncLog::Publish(Record& record, size_t position) {
+    record.sequence.store(position + 1, std::memory_order_release);
+
+    // Pairs with the fence in ConsumerLoop: either the consumer sees this record
+    // before it sleeps, or we see it sleeping and wake it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false, std::memory_order_relaxed)) {
+        // Taking the lock orders us after the consumer's check; notify after releasing
+        // it so the consumer doesn't wake straight into a held mutex
+        { std::lock_guard<std::mutex> lock(wakeMutex_); }
+        wakeCv_.notify_one();
+    }
+}
+
+AsyncLog::Record* AsyncLog::Claim(size_t& position) {
+    position = tail_.load(std::memory_order_relaxed);
+    while (true) {
+        Record& record = At(position);
+        size_t sequence = record.sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                return &record;
+            }
+        } else if (difference < 0) {
+            // The consumer hasn't freed this slot yet: full
+            return nullptr;
+        } else {
+            position = tail_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLog::ConsumerLoop() {
+    while (true) {
+        bool stopping = stopping_.load(std::memory_order_acquire);
+        if (DrainOnce()) {
+            continue;
+        }
+        if (stopping) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wakeCv_.wait(lock, [this]() { return HasPublished() || stopping_.load(std::memory_order_acquire); });
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+bool AsyncLog::DrainOnce() {
+    bool any = false;
+    int64_t timestampUs = NowUs();
+    while (true) {
+        Record& record = At(head_);
+        if (record.sequence.load(std::memory_order_acquire) != head_ + 1) {
+            return any;
+        }
+
+        if (record.format) {
+            std::string_view format(record.text, record.textLength);
+            std::string line;
+            try {
+                line = record.format(format, record.payload);
+            } catch (const std::format_error&) {
+                line = std::string(format);
+            }
+            if (record.location) {
+                line = WithLocation(std::move(line), record.location);
+            }
+            Emit(line, timestampUs);
+        }
+
+        record.sequence.store(head_ + kCapacity, std::memory_order_release);
+        ++head_;
+        any = true;
+    }
+}
+
+void AsyncLog::Emit(const std::string& line, int64_t timestampUs) {
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    if (console_) {
+        console_(line);
+    } else if (_globalCvarManager) {
+        _globalCvarManager->log(line);
+    }
+    if (!filePath_.empty()) {
+        WriteToFile(line, timestampUs);
+    }
+}
+
+void AsyncLog::WriteNow(std::string line) {
+    Emit(line, NowUs());
+}
+
+std::string AsyncLog::WithLocation(std::string text, const LogSite* location) {
+    if (location) {
+        text += ' ';
+        text += LogSites::Get().Location(*location);
+    }
+    return text;
+}
+
+void AsyncLog::WriteToFile(const std::string& line, int64_t timestampUs) {
+    // plugin.log -> plugin.1.log -> plugin.2.log, oldest dropped
+    if (file_ && fileBytes_ >= kMaxFileBytes) {
+        std::fclose(file_);
+        file_ = nullptr;
+
+        std::error_code error;
+        auto rotated = [this](int index) {
+            std::filesystem::path path = filePath_;
+            return path.replace_extension(std::to_string(index) + filePath_.extension().string());
+        };
+        std::filesystem::remove(rotated(kMaxFiles - 1), error);
+        for (int i = kMaxFiles - 2; i >= 1; --i) {
+            std::filesystem::rename(rotated(i), rotated(i + 1), error);
+        }
+        std::filesystem::rename(filePath_, rotated(1), error);
+    }
+
+    if (!file_) {
+        std::error_code error;
+        std::filesystem::create_directories(filePath_.parent_path(), error);
+        file_ = FilePath::Open(filePath_, "ab");
+        if (!file_) {
+            return;
+        }
+        fileBytes_ = std::filesystem::file_size(filePath_, error);
+    }
+
+    std::time_t seconds = static_cast<std::time_t>(timestampUs / 1000000);
+    std::tm local = {};
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    char stamp[32];
+    size_t length = std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+    std::string text = std::format("{}.{:03} {}\n", std::string_view(stamp, length), (timestampUs / 1000) % 1000, line);
+
+    std::fwrite(text.data(), 1, text.size(), file_);
+    std::fflush(file_);
+    fileBytes_ += text.size();
+}
+
+int64_t AsyncLog::NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
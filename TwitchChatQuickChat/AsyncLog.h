@@ -0,0 +1,223 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+#include "LogSite.h"
+
+namespace AsyncLogDetail {
+
+    // How one argument is stored in a record and read back on the logging thread.
+    // Numbers are copied as-is and anything string-like as length + bytes; other
+    // types are formatted on the calling thread and stored as text.
+    template <typename T>
+    struct ArgCodec {
+        using Decayed = std::remove_cvref_t<T>;
+        static constexpr bool kNumber = std::is_arithmetic_v<Decayed>;
+        static constexpr bool kText = std::is_convertible_v<const Decayed&, std::string_view>;
+        using View = std::conditional_t<kNumber, Decayed, std::string_view>;
+
+        static bool Write(char*& cursor, const char* end, const T& value) {
+            if constexpr (kNumber) {
+                if (end - cursor < static_cast<ptrdiff_t>(sizeof(Decayed))) {
+                    return false;
+                }
+                std::memcpy(cursor, &value, sizeof(Decayed));
+                cursor += sizeof(Decayed);
+                return true;
+            } else if constexpr (kText) {
+                return WriteText(cursor, end, std::string_view(value));
+            } else {
+                return WriteText(cursor, end, std::format("{}", value));
+            }
+        }
+
+        static View Read(const char*& cursor) {
+            if constexpr (kNumber) {
+                Decayed value;
+                std::memcpy(&value, cursor, sizeof(Decayed));
+                cursor += sizeof(Decayed);
+                return value;
+            } else {
+                uint16_t length;
+                std::memcpy(&length, cursor, sizeof(length));
+                std::string_view text(cursor + sizeof(length), length);
+                cursor += sizeof(length) + length;
+                return text;
+            }
+        }
+
+        // Long strings are cut to what fits rather than losing the whole line
+        static bool WriteText(char*& cursor, const char* end, std::string_view text) {
+            if (end - cursor < static_cast<ptrdiff_t>(sizeof(uint16_t))) {
+                return false;
+            }
+            size_t room = static_cast<size_t>(end - cursor) - sizeof(uint16_t);
+            uint16_t length = static_cast<uint16_t>((std::min)({ text.size(), room, size_t(UINT16_MAX) }));
+            std::memcpy(cursor, &length, sizeof(length));
+            std::memcpy(cursor + sizeof(length), text.data(), length);
+            cursor += sizeof(length) + length;
+            return true;
+        }
+    };
+
+    template <typename... Args>
+    std::string FormatRecord(std::string_view format, const char* payload) {
+        // Unused when the call had no arguments
+        [[maybe_unused]] const char* cursor = payload;
+        // Braced initialisation reads the arguments back in order
+        std::tuple<typename ArgCodec<Args>::View...> values{ ArgCodec<Args>::Read(cursor)... };
+        return std::apply([format](auto&... value) {
+            return std::vformat(format, std::make_format_args(value...));
+        }, values);
+    }
+
+} // namespace AsyncLogDetail
+
+// Backend for LOG/DEBUGLOG that keeps formatting and console/file output off the
+// calling thread.
+//
+// A call copies its arguments into a slot of a fixed ring (a bounded lock-free MPSC
+// queue: one CAS to claim a slot, one store to publish it) and returns. The logging
+// thread formats the records and hands the lines to the console and, if set, a
+// rotating log file. When the ring is full the line is dropped and counted instead
+// of blocking the caller.
+//
+// The logging thread sleeps on a condition variable while the ring is empty; a
+// caller only takes the lock to wake it when it is actually asleep.
+//
+// Format strings are kept by pointer, so they must outlive the call - LOG only
+// accepts compile-time format strings. Reading the clock would cost about as much as the rest of
+// the call, so lines are timestamped when the logging thread picks them up.
+class AsyncLog {
+public:
+    using ConsoleSink = std::function<void(const std::string& line)>;
+
+    static constexpr size_t kCapacity = 1024;           // records, power of two
+    static constexpr size_t kRecordSize = 256;          // bytes per slot, header included
+    static constexpr uintmax_t kMaxFileBytes = 1024 * 1024;
+    static constexpr int kMaxFiles = 3;                 // current file plus rotations
+
+    static AsyncLog& Get();
+
+    // Starts the logging thread; until then (and after Stop) lines are written
+    // synchronously by the caller
+    void Start(ConsoleSink console);
+    // Waits for calls already writing a record, drains what's queued and stops the
+    // logging thread
+    void Stop();
+    bool IsRunning() const { return running_.load(std::memory_order_acquire); }
+
+    // Also write lines to path (rotated at kMaxFileBytes); empty turns it off
+    void SetFile(const std::filesystem::path& path);
+
+    template <typename... Args>
+    void Write(std::string_view format, const LogSite* location, const Args&... args);
+
+    uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    using FormatFn = std::string(*)(std::string_view format, const char* payload);
+
+    static constexpr size_t kPayloadSize = 192;
+
+    struct alignas(64) Record {
+        std::atomic<size_t> sequence;
+        FormatFn format;            // nullptr: nothing to print
+        const char* text;
+        uint32_t textLength;
+        const LogSite* location;    // DEBUGLOG only: append the call site
+        char payload[kPayloadSize];
+    };
+    static_assert(sizeof(Record) <= kRecordSize, "record grew past kRecordSize");
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+
+    AsyncLog();
+    ~AsyncLog();
+
+    Record& At(size_t position) { return records_[position & (kCapacity - 1)]; }
+    // Claims the next slot; nullptr if the ring is full
+    Record* Claim(size_t& position);
+    void Publish(Record& record, size_t position);
+    // Brackets a call that may write into the ring, so Stop() can wait for it.
+    // False once stopped: the caller writes synchronously instead.
+    bool BeginWrite();
+    void EndWrite() { writers_.fetch_sub(1, std::memory_order_release); }
+    bool HasPublished() { return At(head_).sequence.load(std::memory_order_acquire) == head_ + 1; }
+
+    // Caller's thread, for when the logging thread isn't running or a record can't hold the arguments
+    void WriteNow(std::string line);
+    static std::string WithLocation(std::string text, const LogSite* location);
+
+    void ConsumerLoop();
+    bool DrainOnce();
+    void Emit(const std::string& line, int64_t timestampUs);
+    void WriteToFile(const std::string& line, int64_t timestampUs);
+    static int64_t NowUs();
+
+    Record records_[kCapacity];
+    alignas(64) std::atomic<size_t> tail_{ 0 };         // next position producers claim
+    alignas(64) size_t head_ = 0;                       // next position the consumer reads
+    std::atomic<uint64_t> dropped_{ 0 };
+
+    std::atomic<bool> running_{ false };
+    std::atomic<bool> stopping_{ false };
+    std::atomic<uint32_t> writers_{ 0 };                // calls between BeginWrite and EndWrite
+    std::thread consumer_;
+
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCv_;
+    std::atomic<bool> sleeping_{ false };               // consumer is (about to be) waiting on wakeCv_
+
+    std::mutex sinkMutex_;                              // console_, file settings
+    ConsoleSink console_;
+    std::filesystem::path filePath_;
+    FILE* file_ = nullptr;
+    uintmax_t fileBytes_ = 0;
+};
+
+template <typename... Args>
+void AsyncLog::Write(std::string_view format, const LogSite* location, const Args&... args) {
+    if (!BeginWrite()) {
+        std::string text = std::vformat(format, std::make_format_args(args...));
+        WriteNow(WithLocation(std::move(text), location));
+        return;
+    }
+
+    size_t position;
+    Record* record = Claim(position);
+    if (!record) {
+        EndWrite();
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    [[maybe_unused]] char* cursor = record->payload;
+    [[maybe_unused]] const char* end = record->payload + kPayloadSize;
+    bool fits = (AsyncLogDetail::ArgCodec<Args>::Write(cursor, end, args) && ...);
+
+    record->format = fits ? &AsyncLogDetail::FormatRecord<Args...> : nullptr;
+    record->text = format.data();
+    record->textLength = static_cast<uint32_t>(format.size());
+    record->location = location;
+    Publish(*record, position);
+    EndWrite();
+
+    if (!fits) {
+        // Too many arguments for one record: this slot is published empty and the
+        // line is written directly instead
+        std::string text = std::vformat(format, std::make_format_args(args...));
+        WriteNow(WithLocation(std::move(text), location));
+    }
+}
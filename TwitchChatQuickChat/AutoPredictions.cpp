@@ -1,59 +1,86 @@
 #include "pch.h"
 #include "AutoPredictions.h"
-#include "Config.h"
-#include <httplib.h>
-#include <thread>
+#include "Trace.h"
+#include "AsyncExecutor.h"
+#include "Json.h"
+
+namespace {
+    // Retrying won't change the answer: it worked, or Twitch rejected it for good
+    // (already resolved, not found, ...). 429s were already retried by HelixClient.
+    bool IsFinalResponse(const httplib::Result& result)
+    {
+        return result && result->status != 429 && result->status < 500;
+    }
+}
 
 AutoPredictions::AutoPredictions(std::shared_ptr<GameWrapper> gameWrapper,
-                                 std::shared_ptr<CVarManagerWrapper> cvarManager)
+                                 std::shared_ptr<CVarManagerWrapper> cvarManager,
+                                 std::shared_ptr<HelixClient> helix,
+                                 std::shared_ptr<TwitchEventSub> eventSub)
     : gameWrapper_(gameWrapper)
     , cvarManager_(cvarManager)
+    , helix_(helix)
+    , eventSub_(eventSub)
+    , outbox_(gameWrapper->GetDataFolder() / "TwitchChatQuickChat" / "predictions.journal")
 {
 }
 
-void AutoPredictions::Initialize(const std::string& accessToken, const std::string& broadcasterId)
+void AutoPredictions::Initialize(const std::string& broadcasterId)
 {
     // Prevent double initialization
     if (initialized_) {
-        //LOG("AutoPredictions: Already initialized, updating credentials");
-        accessToken_ = accessToken;
+        DEBUGLOG("AutoPredictions: Already initialized, updating credentials");
         broadcasterId_ = broadcasterId;
         return;
     }
 
-    accessToken_ = accessToken;
     broadcasterId_ = broadcasterId;
 
+    // Open the Helix connections now so the first prediction doesn't pay for the handshake
+    AsyncExecutor::Get().Submit([helix = helix_]() {
+        helix->Warm();
+    });
+
+    // Prediction status arrives over EventSub so match start/end don't have to ask Helix
+    SubscribeToPredictionEvents();
+
+    // Finish what a crash or unload interrupted last time
+    ReplayOutbox();
+
     // Hook for when the match countdown begins
     gameWrapper_->HookEvent("Function GameEvent_TA.Countdown.BeginState",
         [this](std::string eventName) {
-            //LOG("AutoPredictions: Countdown.BeginState event fired");
+            DEBUGLOG("AutoPredictions: Countdown.BeginState event fired");
+            TraceSpan span("predictions", "Countdown.BeginState");
             OnMatchStarted();
         });
 
     // Hook for when match ends and winner is determined
     gameWrapper_->HookEvent("Function TAGame.GameEvent_Soccar_TA.OnMatchWinnerSet",
         [this](std::string eventName) {
-            //LOG("AutoPredictions: OnMatchWinnerSet event fired");
+            DEBUGLOG("AutoPredictions: OnMatchWinnerSet event fired");
+            TraceSpan span("predictions", "OnMatchWinnerSet");
             OnMatchEnded();
         });
 
     // Hook for when player leaves the match (returns to main menu)
     gameWrapper_->HookEvent("Function TAGame.GFxData_MainMenu_TA.MainMenuAdded",
         [this](std::string eventName) {
-            //LOG("AutoPredictions: MainMenuAdded event fired");
+            DEBUGLOG("AutoPredictions: MainMenuAdded event fired");
+            TraceSpan span("predictions", "MainMenuAdded");
             OnPlayerLeftMatch();
         });
 
     // Hook for match destroyed/ended without winner
     gameWrapper_->HookEvent("Function TAGame.GameEvent_Soccar_TA.Destroyed",
         [this](std::string eventName) {
-            //LOG("AutoPredictions: GameEvent destroyed");
+            DEBUGLOG("AutoPredictions: GameEvent destroyed");
+            TraceSpan span("predictions", "GameEvent.Destroyed");
             OnPlayerLeftMatch();
         });
 
     initialized_ = true;
-    //LOG("AutoPredictions: Initialized and hooks registered");
+    LOG("AutoPredictions: Initialized and hooks registered");
 }
 
 void AutoPredictions::Disable()
@@ -67,30 +94,63 @@ void AutoPredictions::Disable()
     gameWrapper_->UnhookEvent("Function TAGame.GFxData_MainMenu_TA.MainMenuAdded");
     gameWrapper_->UnhookEvent("Function TAGame.GameEvent_Soccar_TA.Destroyed");
 
+    UnsubscribeFromPredictionEvents();
+
     // Cancel any active prediction
     if (predictionActive_ && !currentPredictionId_.empty()) {
         CancelPrediction();
     }
 
     initialized_ = false;
-    //LOG("AutoPredictions: Disabled and hooks unregistered");
+    LOG("AutoPredictions: Disabled and hooks unregistered");
+}
+
+void AutoPredictions::FlushOutbox()
+{
+    outbox_.Flush();
+}
+
+void AutoPredictions::ReplayOutbox()
+{
+    AsyncExecutor::Get().SubmitUrgent([this, broadcasterId = broadcasterId_]() {
+        for (const PredictionOutbox::Entry& entry : outbox_.TakeUnfinished(broadcasterId)) {
+            if (AsyncExecutor::IsCancellationRequested()) {
+                return;
+            }
+
+            // A prediction still open when the last session ended can't be resolved
+            // fairly any more, so it's cancelled
+            std::string body = R"({"broadcaster_id":")" + entry.broadcasterId + R"(","id":")" + entry.predictionId;
+            if (entry.action == PredictionOutbox::Action::Resolve) {
+                body += R"(","status":"RESOLVED","winning_outcome_id":")" + entry.outcomeId + R"("})";
+            } else {
+                body += R"(","status":"CANCELED"})";
+            }
+
+            LOG("AutoPredictions: Replaying {} for prediction {}", static_cast<char>(entry.action), entry.predictionId);
+            auto result = helix_->Patch("/helix/predictions", body, HelixPriority::Critical);
+            if (IsFinalResponse(result)) {
+                outbox_.Finished(entry.predictionId);
+            }
+        }
+    });
 }
 
 void AutoPredictions::OnMatchStarted()
 {
     // Don't start prediction if one is already active
     if (predictionActive_) {
-        //LOG("AutoPredictions: Prediction already active, skipping");
+        DEBUGLOG("AutoPredictions: Prediction already active, skipping");
         return;
     }
 
     // Skip training modes and replays
     if (gameWrapper_->IsInFreeplay() || gameWrapper_->IsInCustomTraining() || gameWrapper_->IsInReplay()) {
-        //LOG("AutoPredictions: In training/replay, skipping");
+        DEBUGLOG("AutoPredictions: In training/replay, skipping");
         return;
     }
 
-    //LOG("AutoPredictions: Starting prediction creation");
+    DEBUGLOG("AutoPredictions: Starting prediction creation");
     CreatePrediction();
 }
 
@@ -98,13 +158,13 @@ void AutoPredictions::OnMatchEnded()
 {
     // Only process if we have an active prediction
     if (!predictionActive_ || currentPredictionId_.empty()) {
-        //LOG("AutoPredictions: No active prediction to resolve");
+        DEBUGLOG("AutoPredictions: No active prediction to resolve");
         return;
     }
 
     ServerWrapper server = gameWrapper_->GetCurrentGameState();
     if (!server) {
-        //LOG("AutoPredictions: No server, canceling prediction");
+        LOG("AutoPredictions: No server, canceling prediction");
         CancelPrediction();
         return;
     }
@@ -116,7 +176,7 @@ void AutoPredictions::OnMatchEnded()
     }
 
     if (!winningTeam) {
-        //LOG("AutoPredictions: No winning team, canceling prediction");
+        LOG("AutoPredictions: No winning team, canceling prediction");
         CancelPrediction();
         return;
     }
@@ -124,21 +184,21 @@ void AutoPredictions::OnMatchEnded()
     // Get the local player's team
     PlayerControllerWrapper localPlayer = gameWrapper_->GetPlayerController();
     if (!localPlayer) {
-        //LOG("AutoPredictions: No local player, canceling prediction");
+        LOG("AutoPredictions: No local player, canceling prediction");
         CancelPrediction();
         return;
     }
 
     PriWrapper pri = localPlayer.GetPRI();
     if (!pri) {
-        //LOG("AutoPredictions: No PRI, canceling prediction");
+        LOG("AutoPredictions: No PRI, canceling prediction");
         CancelPrediction();
         return;
     }
 
     TeamInfoWrapper playerTeamInfo = pri.GetTeam();
     if (!playerTeamInfo) {
-        //LOG("AutoPredictions: No team info, canceling prediction");
+        LOG("AutoPredictions: No team info, canceling prediction");
         CancelPrediction();
         return;
     }
@@ -147,7 +207,7 @@ void AutoPredictions::OnMatchEnded()
     int winningTeamIndex = winningTeam.GetTeamIndex();
 
     bool playerWon = (winningTeamIndex == playerTeamIndex);
-    //LOG("AutoPredictions: Player {} (team {} vs winner {})", playerWon ? "WON" : "LOST", playerTeamIndex, winningTeamIndex);
+    LOG("AutoPredictions: Player {} (team {} vs winner {})", playerWon ? "WON" : "LOST", playerTeamIndex, winningTeamIndex);
 
     std::string winningOutcomeId = playerWon ? outcomeWinId_ : outcomeLoseId_;
     ResolvePrediction(winningOutcomeId);
@@ -160,14 +220,14 @@ void AutoPredictions::OnPlayerLeftMatch()
         return;
     }
 
-    //LOG("AutoPredictions: Player left match, checking game state");
+    DEBUGLOG("AutoPredictions: Player left match, checking game state");
 
     // Try to determine winner from current score
     std::string outcomeId = DetermineOutcomeFromGameState();
     
     if (outcomeId.empty()) {
         // Couldn't determine, default to loss (player quit/forfeited)
-        //LOG("AutoPredictions: Could not determine winner, defaulting to L");
+        LOG("AutoPredictions: Could not determine winner, defaulting to L");
         outcomeId = outcomeLoseId_;
     }
 
@@ -178,7 +238,7 @@ std::string AutoPredictions::DetermineOutcomeFromGameState()
 {
     ServerWrapper server = gameWrapper_->GetCurrentGameState();
     if (!server) {
-        //LOG("AutoPredictions: No server available");
+        DEBUGLOG("AutoPredictions: No server available");
         return "";
     }
 
@@ -201,7 +261,7 @@ std::string AutoPredictions::DetermineOutcomeFromGameState()
             int score0 = teams.Get(0).GetScore();
             int score1 = teams.Get(1).GetScore();
             
-            //LOG("AutoPredictions: Overtime scores - Team0: {}, Team1: {}", score0, score1);
+            DEBUGLOG("AutoPredictions: Overtime scores - Team0: {}, Team1: {}", score0, score1);
             
             if (score0 != score1) {
                 // Someone scored in OT - determine winner
@@ -210,7 +270,7 @@ std::string AutoPredictions::DetermineOutcomeFromGameState()
                 
                 if (playerTeamIndex >= 0) {
                     bool playerWon = (winningTeamIndex == playerTeamIndex);
-                    //LOG("AutoPredictions: OT winner determined - Player {} (team {} vs winner {})", playerWon ? "WON" : "LOST", playerTeamIndex, winningTeamIndex);
+                    LOG("AutoPredictions: OT winner determined - Player {} (team {} vs winner {})", playerWon ? "WON" : "LOST", playerTeamIndex, winningTeamIndex);
                     return playerWon ? outcomeWinId_ : outcomeLoseId_;
                 }
             }
@@ -231,7 +291,7 @@ std::string AutoPredictions::GetOutcomeForWinner(TeamWrapper winningTeam)
     int winningTeamIndex = winningTeam.GetTeamIndex();
     bool playerWon = (winningTeamIndex == playerTeamIndex);
     
-    //LOG("AutoPredictions: Winner determined - Player {} (team {} vs winner {})", playerWon ? "WON" : "LOST", playerTeamIndex, winningTeamIndex);
+    LOG("AutoPredictions: Winner determined - Player {} (team {} vs winner {})", playerWon ? "WON" : "LOST", playerTeamIndex, winningTeamIndex);
     
     return playerWon ? outcomeWinId_ : outcomeLoseId_;
 }
@@ -256,135 +316,171 @@ int AutoPredictions::GetPlayerTeamIndex()
     return playerTeamInfo.GetTeamIndex();
 }
 
-bool AutoPredictions::HasActivePrediction()
+void AutoPredictions::SubscribeToPredictionEvents()
 {
-    std::string status = GetPredictionStatus();
-    return status == "ACTIVE" || status == "LOCKED";
+    std::string condition = R"({"broadcaster_user_id":")" + broadcasterId_ + R"("})";
+    for (const char* type : { "channel.prediction.begin", "channel.prediction.progress",
+                              "channel.prediction.lock", "channel.prediction.end" }) {
+        eventSubscriptions_.push_back(eventSub_->Subscribe(type, "1", condition,
+            [this](const EventSubMessage& message) {
+                OnPredictionEvent(message);
+            }));
+    }
 }
 
-std::string AutoPredictions::GetPredictionStatus()
+void AutoPredictions::UnsubscribeFromPredictionEvents()
 {
-    httplib::SSLClient client("api.twitch.tv");
-    client.set_connection_timeout(5);
-    client.set_read_timeout(5);
+    for (TwitchEventSub::SubscriptionId id : eventSubscriptions_) {
+        eventSub_->Unsubscribe(id);
+    }
+    eventSubscriptions_.clear();
 
-    httplib::Headers headers = {
-        {"Authorization", "Bearer " + accessToken_},
-        {"Client-Id", Config::TWITCH_CLIENT_ID}
-    };
+    twitchPredictionId_.clear();
+    twitchPredictionStatus_ = PredictionStatus::Unknown;
+}
 
-    auto result = client.Get(("/helix/predictions?broadcaster_id=" + broadcasterId_).c_str(), headers);
+void AutoPredictions::OnPredictionEvent(const EventSubMessage& message)
+{
+    std::string predictionId = Json::Find(message.event, "id").ToString();
+    if (predictionId.empty()) {
+        return;
+    }
 
-    if (!result || result->status != 200) {
-        //LOG("AutoPredictions: Failed to get prediction status");
-        return "";
+    PredictionStatus status = PredictionStatus::Active;
+    if (message.subscriptionType == "channel.prediction.lock") {
+        status = PredictionStatus::Locked;
+    } else if (message.subscriptionType == "channel.prediction.end") {
+        status = PredictionStatus::Ended;
     }
 
-    const std::string& body = result->body;
-    
-    // Find status in response
-    size_t statusPos = body.find("\"status\":\"");
-    if (statusPos != std::string::npos) {
-        size_t start = statusPos + 10;
-        size_t end = body.find('"', start);
-        if (end != std::string::npos) {
-            std::string status = body.substr(start, end - start);
-            //LOG("AutoPredictions: Current prediction status: {}", status);
-            return status;
+    DEBUGLOG("AutoPredictions: Event {} for prediction {}", message.subscriptionType, predictionId);
+
+    gameWrapper_->Execute([this, predictionId, status](GameWrapper* gw) {
+        // A late progress event must not reopen a locked or ended prediction
+        if (predictionId == twitchPredictionId_ && status < twitchPredictionStatus_) {
+            return;
         }
+        twitchPredictionId_ = predictionId;
+        twitchPredictionStatus_ = status;
+    });
+}
+
+bool AutoPredictions::PredictionEventsLive() const
+{
+    if (eventSubscriptions_.empty()) {
+        return false;
     }
 
-    return "";
+    for (TwitchEventSub::SubscriptionId id : eventSubscriptions_) {
+        if (!eventSub_->IsSubscribed(id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AutoPredictions::HasActivePrediction(const std::string& broadcasterId)
+{
+    std::string status = GetPredictionStatus(broadcasterId);
+    return status == "ACTIVE" || status == "LOCKED";
+}
+
+std::string AutoPredictions::GetPredictionStatus(const std::string& broadcasterId)
+{
+    auto result = helix_->Get("/helix/predictions?broadcaster_id=" + broadcasterId, HelixPriority::Background);
+
+    if (!result || result->status != 200) {
+        LOG("AutoPredictions: Failed to get prediction status");
+        return "";
+    }
+
+    // {"data":[{"id":"...","status":"ACTIVE",...},...]}, most recent first
+    std::string status;
+    Json::Value data = Json::Find(Json::Parse(result->body), "data");
+    Json::ForEachElement(data, [&status](const Json::Value& prediction) {
+        status = Json::Find(prediction, "status").ToString();
+        return false;
+    });
+    DEBUGLOG("AutoPredictions: Current prediction status: {}", status);
+    return status;
 }
 
 void AutoPredictions::CreatePrediction()
 {
-    //LOG("AutoPredictions: Creating prediction on Twitch");
-    //LOG("AutoPredictions: Broadcaster ID: {}", broadcasterId_);
+    DEBUGLOG("AutoPredictions: Creating prediction for broadcaster {}", broadcasterId_);
 
-    std::thread([this]() {
-        // Check if there's already an active prediction on Twitch
-        if (HasActivePrediction()) {
-            //LOG("AutoPredictions: Active prediction already exists on Twitch, skipping");
+    // With the prediction events flowing, Twitch's state is already known locally
+    bool eventsLive = PredictionEventsLive();
+    if (eventsLive && (twitchPredictionStatus_ == PredictionStatus::Active ||
+                       twitchPredictionStatus_ == PredictionStatus::Locked)) {
+        LOG("AutoPredictions: Active prediction already exists on Twitch, skipping");
+        return;
+    }
+
+    // broadcasterId_ belongs to the game thread; the task gets its own copy
+    AsyncExecutor::Get().Submit([this, eventsLive, broadcasterId = broadcasterId_]() {
+        // Otherwise ask Helix if there's already an active prediction on Twitch
+        if (!eventsLive && HasActivePrediction(broadcasterId)) {
+            LOG("AutoPredictions: Active prediction already exists on Twitch, skipping");
             return;
         }
 
-        httplib::SSLClient client("api.twitch.tv");
-        client.set_connection_timeout(10);
-        client.set_read_timeout(10);
-
-        httplib::Headers headers = {
-            {"Authorization", "Bearer " + accessToken_},
-            {"Client-Id", Config::TWITCH_CLIENT_ID},
-            {"Content-Type", "application/json"}
-        };
-
         // Build JSON body for prediction (compact JSON, no extra whitespace)
-        std::string body = R"({"broadcaster_id":")" + broadcasterId_ +
+        std::string body = R"({"broadcaster_id":")" + broadcasterId +
             R"(","title":"W or L?","outcomes":[{"title":"W"},{"title":"L"}],"prediction_window":120})";
 
-        //LOG("AutoPredictions: Request body: {}", body);
-
-        auto result = client.Post("/helix/predictions", headers, body, "application/json");
+        auto result = helix_->Post("/helix/predictions", body);
 
         if (!result) {
-            //LOG("AutoPredictions: No response from Twitch API (connection failed)");
+            LOG("AutoPredictions: No response from Twitch API (connection failed)");
             return;
         }
 
-        //LOG("AutoPredictions: Response status: {}", result->status);
-        //LOG("AutoPredictions: Response body: {}", result->body);
-
         if (result->status == 200) {
-            std::string responseBody = result->body;
-
-            size_t idPos = responseBody.find("\"id\":\"");
-            if (idPos != std::string::npos) {
-                size_t start = idPos + 6;
-                size_t end = responseBody.find('"', start);
-                if (end != std::string::npos) {
-                    std::string predictionId = responseBody.substr(start, end - start);
-
-                    std::string outcomeWinId, outcomeLoseId;
-
-                    size_t outcomesPos = responseBody.find("\"outcomes\":");
-                    if (outcomesPos != std::string::npos) {
-                        size_t firstOutcomeIdPos = responseBody.find("\"id\":\"", outcomesPos);
-                        if (firstOutcomeIdPos != std::string::npos) {
-                            size_t s1 = firstOutcomeIdPos + 6;
-                            size_t e1 = responseBody.find('"', s1);
-                            if (e1 != std::string::npos) {
-                                outcomeWinId = responseBody.substr(s1, e1 - s1);
-                            }
-
-                            size_t secondOutcomeIdPos = responseBody.find("\"id\":\"", e1);
-                            if (secondOutcomeIdPos != std::string::npos) {
-                                size_t s2 = secondOutcomeIdPos + 6;
-                                size_t e2 = responseBody.find('"', s2);
-                                if (e2 != std::string::npos) {
-                                    outcomeLoseId = responseBody.substr(s2, e2 - s2);
-                                }
-                            }
-                        }
-                    }
-
-                    //LOG("AutoPredictions: Prediction ID: {}", predictionId);
-                    //LOG("AutoPredictions: Win outcome ID: {}", outcomeWinId);
-                    //LOG("AutoPredictions: Lose outcome ID: {}", outcomeLoseId);
-
-                    gameWrapper_->Execute([this, predictionId, outcomeWinId, outcomeLoseId](GameWrapper* gw) {
-                        currentPredictionId_ = predictionId;
-                        outcomeWinId_ = outcomeWinId;
-                        outcomeLoseId_ = outcomeLoseId;
-                        predictionActive_ = true;
-                        //LOG("AutoPredictions: Prediction state updated, active = true");
-                    });
+            // {"data":[{"id":"...","outcomes":[{"id":"...","title":"W",...},...],...}]}
+            Json::Value prediction;
+            Json::ForEachElement(Json::Find(Json::Parse(result->body), "data"), [&prediction](const Json::Value& entry) {
+                prediction = entry;
+                return false;
+            });
+
+            std::string predictionId = Json::Find(prediction, "id").ToString();
+            if (predictionId.empty()) {
+                LOG("AutoPredictions: Prediction response had no id: {}", result->body);
+                return;
+            }
+            // Journaled first, so a crash from here on still gets it closed
+            outbox_.Created(broadcasterId, predictionId);
+
+            // Matched by title rather than position
+            std::string outcomeWinId, outcomeLoseId;
+            Json::ForEachElement(Json::Find(prediction, "outcomes"), [&](const Json::Value& outcome) {
+                Json::Value title = Json::Find(outcome, "title");
+                if (title.Equals("W")) {
+                    outcomeWinId = Json::Find(outcome, "id").ToString();
+                } else if (title.Equals("L")) {
+                    outcomeLoseId = Json::Find(outcome, "id").ToString();
                 }
+                return true;
+            });
+
+            LOG("AutoPredictions: Created prediction {} (W {}, L {})", predictionId, outcomeWinId, outcomeLoseId);
+
+            // The plugin may be unloading; don't post back into it
+            if (AsyncExecutor::IsCancellationRequested()) {
+                return;
             }
+
+            gameWrapper_->Execute([this, predictionId, outcomeWinId, outcomeLoseId](GameWrapper* gw) {
+                currentPredictionId_ = predictionId;
+                outcomeWinId_ = outcomeWinId;
+                outcomeLoseId_ = outcomeLoseId;
+                predictionActive_ = true;
+            });
         } else {
-            //LOG("AutoPredictions: API error - Status {}: {}", result->status, result->body);
+            LOG("AutoPredictions: API error - Status {}: {}", result->status, result->body);
         }
-    }).detach();
+    });
 }
 
 void AutoPredictions::ResolvePrediction(const std::string& winningOutcomeId)
@@ -395,7 +491,7 @@ void AutoPredictions::ResolvePrediction(const std::string& winningOutcomeId)
 
     // Guard against empty outcome ID
     if (predictionId.empty() || outcomeId.empty()) {
-        //LOG("AutoPredictions: Cannot resolve - missing prediction ID or outcome ID");
+        LOG("AutoPredictions: Cannot resolve - missing prediction ID or outcome ID");
         predictionActive_ = false;
         currentPredictionId_.clear();
         outcomeWinId_.clear();
@@ -408,58 +504,58 @@ void AutoPredictions::ResolvePrediction(const std::string& winningOutcomeId)
     outcomeWinId_.clear();
     outcomeLoseId_.clear();
 
-    //LOG("AutoPredictions: Resolving prediction {} with outcome {}", predictionId, outcomeId);
+    LOG("AutoPredictions: Resolving prediction {} with outcome {}", predictionId, outcomeId);
 
-    std::thread([this, predictionId, outcomeId]() {
+    // Use the event-fed status for this prediction when there is one
+    bool statusKnown = PredictionEventsLive() && twitchPredictionId_ == predictionId;
+    if (statusKnown && twitchPredictionStatus_ == PredictionStatus::Ended) {
+        LOG("AutoPredictions: Prediction already ended on Twitch");
+        outbox_.Finished(predictionId);
+        return;
+    }
+    bool votingOpen = statusKnown && twitchPredictionStatus_ == PredictionStatus::Active;
+
+    // Urgent so it doesn't wait behind Background calls holding every worker
+    AsyncExecutor::Get().SubmitUrgent([this, broadcasterId = broadcasterId_, predictionId, outcomeId, statusKnown, votingOpen]() {
         // Check if prediction is still in ACTIVE state (voting window open)
-        std::string status = GetPredictionStatus();
-        if (status == "ACTIVE") {
-            //LOG("AutoPredictions: Prediction still ACTIVE (voting open), canceling instead of resolving");
+        bool stillOpen = statusKnown ? votingOpen : GetPredictionStatus(broadcasterId) == "ACTIVE";
+        if (stillOpen) {
+            LOG("AutoPredictions: Prediction still ACTIVE (voting open), canceling instead of resolving");
             
-            httplib::SSLClient client("api.twitch.tv");
-            client.set_connection_timeout(10);
-            client.set_read_timeout(10);
-
-            httplib::Headers headers = {
-                {"Authorization", "Bearer " + accessToken_},
-                {"Client-Id", Config::TWITCH_CLIENT_ID},
-                {"Content-Type", "application/json"}
-            };
-
-            std::string body = R"({"broadcaster_id":")" + broadcasterId_ +
+            std::string body = R"({"broadcaster_id":")" + broadcasterId +
                 R"(","id":")" + predictionId + R"(","status":"CANCELED"})";
 
-            auto result = client.Patch("/helix/predictions", headers, body, "application/json");
+            outbox_.Cancelling(broadcasterId, predictionId);
+            auto result = helix_->Patch("/helix/predictions", body, HelixPriority::Critical);
+            if (IsFinalResponse(result)) {
+                outbox_.Finished(predictionId);
+            }
 
-            if (result) {
-                //LOG("AutoPredictions: Cancel response - Status {}: {}", result->status, result->body);
+            if (!result) {
+                LOG("AutoPredictions: Cancel failed - no response");
+            } else if (result->status != 200) {
+                LOG("AutoPredictions: Cancel response - Status {}: {}", result->status, result->body);
             }
             return;
         }
 
         // Prediction is LOCKED, proceed with resolve
-        httplib::SSLClient client("api.twitch.tv");
-        client.set_connection_timeout(10);
-        client.set_read_timeout(10);
-
-        httplib::Headers headers = {
-            {"Authorization", "Bearer " + accessToken_},
-            {"Client-Id", Config::TWITCH_CLIENT_ID},
-            {"Content-Type", "application/json"}
-        };
-
-        std::string body = R"({"broadcaster_id":")" + broadcasterId_ +
+        std::string body = R"({"broadcaster_id":")" + broadcasterId +
             R"(","id":")" + predictionId +
             R"(","status":"RESOLVED","winning_outcome_id":")" + outcomeId + R"("})";
 
-        auto result = client.Patch("/helix/predictions", headers, body, "application/json");
+        outbox_.Resolving(broadcasterId, predictionId, outcomeId);
+        auto result = helix_->Patch("/helix/predictions", body, HelixPriority::Critical);
+        if (IsFinalResponse(result)) {
+            outbox_.Finished(predictionId);
+        }
 
-        if (result) {
-            //LOG("AutoPredictions: Resolve response - Status {}: {}", result->status, result->body);
-        } else {
-            //LOG("AutoPredictions: Resolve failed - no response");
+        if (!result) {
+            LOG("AutoPredictions: Resolve failed - no response");
+        } else if (result->status != 200) {
+            LOG("AutoPredictions: Resolve response - Status {}: {}", result->status, result->body);
         }
-    }).detach();
+    });
 }
 
 void AutoPredictions::CancelPrediction()
@@ -471,26 +567,22 @@ void AutoPredictions::CancelPrediction()
     outcomeWinId_.clear();
     outcomeLoseId_.clear();
 
-    //LOG("AutoPredictions: Canceling prediction {}", predictionId);
+    LOG("AutoPredictions: Canceling prediction {}", predictionId);
+    outbox_.Cancelling(broadcasterId_, predictionId);
 
-    std::thread([this, predictionId]() {
-        httplib::SSLClient client("api.twitch.tv");
-        client.set_connection_timeout(10);
-        client.set_read_timeout(10);
-
-        httplib::Headers headers = {
-            {"Authorization", "Bearer " + accessToken_},
-            {"Client-Id", Config::TWITCH_CLIENT_ID},
-            {"Content-Type", "application/json"}
-        };
-
-        std::string body = R"({"broadcaster_id":")" + broadcasterId_ +
+    AsyncExecutor::Get().SubmitUrgent([this, broadcasterId = broadcasterId_, predictionId]() {
+        std::string body = R"({"broadcaster_id":")" + broadcasterId +
             R"(","id":")" + predictionId + R"(","status":"CANCELED"})";
 
-        auto result = client.Patch("/helix/predictions", headers, body, "application/json");
+        auto result = helix_->Patch("/helix/predictions", body, HelixPriority::Critical);
+        if (IsFinalResponse(result)) {
+            outbox_.Finished(predictionId);
+        }
 
-        if (result) {
-            //LOG("AutoPredictions: Cancel response - Status {}: {}", result->status, result->body);
+        if (!result) {
+            LOG("AutoPredictions: Cancel failed - no response");
+        } else if (result->status != 200) {
+            LOG("AutoPredictions: Cancel response - Status {}: {}", result->status, result->body);
         }
-    }).detach();
+    });
 }
\ No newline at end of file
@@ -1,25 +1,49 @@
 #pragma once
 
 #include "bakkesmod/plugin/bakkesmodplugin.h"
+#include "HelixClient.h"
+#include "TwitchEventSub.h"
+#include "PredictionOutbox.h"
 #include <string>
 #include <memory>
+#include <vector>
 
 class AutoPredictions
 {
 public:
     AutoPredictions(std::shared_ptr<GameWrapper> gameWrapper, 
-                    std::shared_ptr<CVarManagerWrapper> cvarManager);
+                    std::shared_ptr<CVarManagerWrapper> cvarManager,
+                    std::shared_ptr<HelixClient> helix,
+                    std::shared_ptr<TwitchEventSub> eventSub);
     
-    void Initialize(const std::string& accessToken, const std::string& broadcasterId);
+    void Initialize(const std::string& broadcasterId);
     void Disable();
+    // Waits until every journaled prediction action is on disk
+    void FlushOutbox();
     
 private:
+    // Where Twitch says a prediction is, as last reported by channel.prediction.* events
+    enum class PredictionStatus
+    {
+        Unknown,
+        Active,
+        Locked,
+        Ended,
+    };
+
     void OnMatchStarted();
     void OnMatchEnded();
     void OnPlayerLeftMatch();
     
-    bool HasActivePrediction();
-    std::string GetPredictionStatus();
+    void SubscribeToPredictionEvents();
+    void UnsubscribeFromPredictionEvents();
+    void OnPredictionEvent(const EventSubMessage& message);
+    bool PredictionEventsLive() const;
+
+    // Helix fallbacks for when the prediction events aren't flowing; called from
+    // executor tasks, so they take the broadcaster the task captured
+    bool HasActivePrediction(const std::string& broadcasterId);
+    std::string GetPredictionStatus(const std::string& broadcasterId);
     std::string DetermineOutcomeFromGameState();
     std::string GetOutcomeForWinner(TeamWrapper winningTeam);
     int GetPlayerTeamIndex();
@@ -27,12 +51,17 @@ private:
     void CreatePrediction();
     void ResolvePrediction(const std::string& winningOutcomeId);
     void CancelPrediction();
+    // Sends whatever a previous session left unresolved
+    void ReplayOutbox();
     
     std::shared_ptr<GameWrapper> gameWrapper_;
     std::shared_ptr<CVarManagerWrapper> cvarManager_;
+    std::shared_ptr<HelixClient> helix_;
+    std::shared_ptr<TwitchEventSub> eventSub_;
     
-    std::string accessToken_;
     std::string broadcasterId_;
+    std::vector<TwitchEventSub::SubscriptionId> eventSubscriptions_;
+    PredictionOutbox outbox_;
     
     // Prediction state
     bool initialized_ = false;
@@ -40,4 +69,8 @@ private:
     std::string currentPredictionId_;
     std::string outcomeWinId_;
     std::string outcomeLoseId_;
+
+    // Twitch-side state, only touched on the game thread
+    std::string twitchPredictionId_;
+    PredictionStatus twitchPredictionStatus_ = PredictionStatus::Unknown;
 };
\ No newline at end of file
@@ -1,43 +1,173 @@
 #include "pch.h"
 #include "Chat.h"
-#include "Config.h"
-#include <thread>
+#include "Trace.h"
+#include <algorithm>
 
-Chat::Chat(std::shared_ptr<GameWrapper> gameWrapper)
+Chat::Chat(std::shared_ptr<GameWrapper> gameWrapper,
+           std::shared_ptr<CVarManagerWrapper> cvarManager,
+           std::shared_ptr<TwitchEventSub> eventSub)
     : gameWrapper_(gameWrapper)
+    , cvarManager_(cvarManager)
+    , eventSub_(eventSub)
 {
 }
 
-void Chat::Initialize(const std::string& accessToken, const std::string& userId, const std::string& channelId)
+void Chat::Initialize(const std::string& userId, const std::string& channelId)
 {
-    accessToken_ = accessToken;
     userId_ = userId;
     channelId_ = channelId;
 }
 
 void Chat::Connect()
 {
-    if (twitchEventSub_) {
-        twitchEventSub_->Disconnect();
-    }
+    Disconnect();
+
+    std::string condition = R"({"broadcaster_user_id":")" + channelId_ +
+        R"(","user_id":")" + userId_ + R"("})";
 
-    twitchEventSub_ = std::make_unique<TwitchEventSub>();
-    twitchEventSub_->SetMessageCallback([this](const std::string& username, const std::string& message) {
-        gameWrapper_->Execute([this, username, message](GameWrapper* gw) {
-            OnTwitchMessage(username, message);
+    subscription_ = eventSub_->Subscribe("channel.chat.message", "1", condition,
+        [this](const EventSubMessage& message) {
+            OnChatEvent(message);
         });
+}
+
+void Chat::Disconnect()
+{
+    if (subscription_ != 0) {
+        eventSub_->Unsubscribe(subscription_);
+        subscription_ = 0;
+    }
+}
+
+void Chat::OnChatEvent(const EventSubMessage& message)
+{
+    // One pass over the event for both fields
+    Json::Value chatterName, messageObject;
+    Json::ForEachMember(message.event, [&](const Json::Value& key, const Json::Value& value) {
+        if (key.raw == "chatter_user_name") {
+            chatterName = value;
+        } else if (key.raw == "message") {
+            messageObject = value;
+        }
+        return !chatterName || !messageObject;
     });
+    Json::Value messageText = Json::Find(messageObject, "text");
 
-    std::thread([this]() {
-        twitchEventSub_->Connect(accessToken_, Config::TWITCH_CLIENT_ID, userId_, channelId_);
-    }).detach();
+    if (chatterName.IsString() && messageText.IsString() && !messageText.raw.empty()) {
+        ChatMessage entry{ chatterName.ToString(), messageText.ToString(), message.receivedAt, ChatFloodControl::Clock::now() };
+        latency_[SocketToParsed].Record(entry.parsed - entry.received);
+        EnqueueMessage(std::move(entry));
+    }
 }
 
-void Chat::Disconnect()
+void Chat::EnqueueMessage(ChatMessage entry)
 {
-    if (twitchEventSub_) {
-        twitchEventSub_->Disconnect();
+    if (!pending_.TryPush(std::move(entry))) {
+        // The game thread is a full queue behind; showing this one late is worse than not at all
+        droppedMessages_.fetch_add(1, std::memory_order_relaxed);
+        return;
     }
+
+    ScheduleDrain();
+}
+
+void Chat::ScheduleDrain()
+{
+    // Only the first message after a drain finishes posts a task
+    if (drainScheduled_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    gameWrapper_->Execute([this](GameWrapper*) {
+        DrainMessages();
+    });
+}
+
+void Chat::DrainMessages()
+{
+    TraceSpan span("chat", "DrainMessages");
+    int budget = 10;
+    CVarWrapper budgetCvar = cvarManager_->getCvar("twitchChatQuickChat_chat_frame_budget");
+    if (budgetCvar) {
+        budget = (std::max)(1, budgetCvar.getIntValue());
+    }
+
+    floodControl_.Configure(ReadFloodSettings());
+    auto now = ChatFloodControl::Clock::now();
+
+    ChatMessage entry;
+    for (int taken = 0; taken < budget && pending_.TryPop(entry); ++taken) {
+        latency_[ParsedToGameThread].Record(now - entry.parsed);
+        floodControl_.Submit(std::move(entry.username), std::move(entry.message), now, entry.received);
+    }
+
+    floodControl_.Flush(now, budget, [this](const std::string& username, const std::string& message,
+                                            ChatFloodControl::Clock::time_point received,
+                                            ChatFloodControl::Clock::time_point submitted) {
+        OnTwitchMessage(username, message);
+        auto shown = ChatFloodControl::Clock::now();
+        latency_[GameThreadToChatbox].Record(shown - submitted);
+        latency_[SocketToChatbox].Record(shown - received);
+    });
+
+    if (pending_.Empty() && !floodControl_.HasBacklog()) {
+        // The exchange pairs with the producer's, so a message pushed before it is seen below
+        drainScheduled_.exchange(false, std::memory_order_acq_rel);
+        if (pending_.Empty() || drainScheduled_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+    }
+
+    // More to do: continue next tick, or when the rate limit frees a slot if only the
+    // backlog is left. Execute would run inline here on the game thread, so use a timeout.
+    float delay = 0.0f;
+    if (pending_.Empty()) {
+        delay = std::chrono::duration<float>(floodControl_.TimeUntilNextSlot(now)).count();
+    }
+    gameWrapper_->SetTimeout([this](GameWrapper*) {
+        DrainMessages();
+    }, delay);
+}
+
+ChatFloodControl::Settings Chat::ReadFloodSettings() const
+{
+    ChatFloodControl::Settings settings;
+
+    CVarWrapper rateCvar = cvarManager_->getCvar("twitchChatQuickChat_chat_max_per_second");
+    if (rateCvar) {
+        settings.maxPerSecond = rateCvar.getIntValue();
+    }
+
+    CVarWrapper policyCvar = cvarManager_->getCvar("twitchChatQuickChat_chat_overflow_policy");
+    if (policyCvar) {
+        settings.policy = policyCvar.getIntValue() == 1
+            ? ChatFloodControl::OverflowPolicy::Sample
+            : ChatFloodControl::OverflowPolicy::DropOldest;
+    }
+
+    CVarWrapper sampleCvar = cvarManager_->getCvar("twitchChatQuickChat_chat_sample_every");
+    if (sampleCvar) {
+        settings.sampleEvery = sampleCvar.getIntValue();
+    }
+
+    CVarWrapper collapseCvar = cvarManager_->getCvar("twitchChatQuickChat_chat_collapse_duplicates");
+    if (collapseCvar) {
+        settings.collapseDuplicates = collapseCvar.getBoolValue();
+    }
+
+    CVarWrapper userCapCvar = cvarManager_->getCvar("twitchChatQuickChat_chat_user_cap");
+    if (userCapCvar) {
+        settings.perUserCap = userCapCvar.getIntValue();
+    }
+
+    return settings;
+}
+
+ChatFloodControl::Stats Chat::GetFloodStats() const
+{
+    ChatFloodControl::Stats stats = floodControl_.GetStats();
+    stats.droppedQueueFull = droppedMessages_.load(std::memory_order_relaxed);
+    return stats;
 }
 
 void Chat::OnTwitchMessage(const std::string& username, const std::string& message)
@@ -2,27 +2,73 @@
 
 #include "bakkesmod/plugin/bakkesmodplugin.h"
 #include "TwitchEventSub.h"
-#include <string>
+#include "SpscQueue.h"
+#include "ChatFloodControl.h"
+#include "LatencyHistogram.h"
 #include <string>
 #include <memory>
+#include <atomic>
 
 class Chat
 {
 public:
-    Chat(std::shared_ptr<GameWrapper> gameWrapper);
+    Chat(std::shared_ptr<GameWrapper> gameWrapper,
+         std::shared_ptr<CVarManagerWrapper> cvarManager,
+         std::shared_ptr<TwitchEventSub> eventSub);
 
-    void Initialize(const std::string& accessToken, const std::string& userId, const std::string& channelId);
+    void Initialize(const std::string& userId, const std::string& channelId);
     void Connect();
     void Disconnect();
 
+    // Shown/merged/dropped counts since the plugin loaded; safe to call from any thread
+    ChatFloodControl::Stats GetFloodStats() const;
+
+    // Steps a chat message goes through between the socket and the chatbox
+    enum LatencyStage {
+        SocketToParsed,         // envelope and event parsed on the network thread
+        ParsedToGameThread,     // waiting in pending_ and for the Execute hop
+        GameThreadToChatbox,    // held by flood control, then LogToChatbox
+        SocketToChatbox,        // the whole way
+        LatencyStageCount
+    };
+    // Histograms are lock-free; safe to read or reset from any thread
+    LatencyHistogram& GetLatency(LatencyStage stage) { return latency_[stage]; }
+
 private:
+    struct ChatMessage {
+        std::string username;
+        std::string message;
+        ChatFloodControl::Clock::time_point received;   // frame off the socket
+        ChatFloodControl::Clock::time_point parsed;     // handed to the queue
+    };
+
+    // Network thread: pulls the chatter and text out of a channel.chat.message event
+    void OnChatEvent(const EventSubMessage& message);
+    // Network thread: hands a message to the game thread
+    void EnqueueMessage(ChatMessage entry);
+    void ScheduleDrain();
+    // Game thread: filters up to the per-frame budget, shows what flood control allows,
+    // then yields to the next tick
+    void DrainMessages();
+    ChatFloodControl::Settings ReadFloodSettings() const;
+
     void OnTwitchMessage(const std::string& username, const std::string& message);
 
     std::shared_ptr<GameWrapper> gameWrapper_;
+    std::shared_ptr<CVarManagerWrapper> cvarManager_;
+    std::shared_ptr<TwitchEventSub> eventSub_;
 
-    std::string accessToken_;
     std::string userId_;
     std::string channelId_;
 
-    std::unique_ptr<TwitchEventSub> twitchEventSub_;
+    TwitchEventSub::SubscriptionId subscription_ = 0;
+
+    // Messages waiting for the game thread. At most one drain task is queued at a time.
+    static constexpr size_t kQueueCapacity = 1024;
+    SpscQueue<ChatMessage, kQueueCapacity> pending_;
+    std::atomic<bool> drainScheduled_{ false };
+    std::atomic<uint64_t> droppedMessages_{ 0 };
+
+    ChatFloodControl floodControl_;
+    LatencyHistogram latency_[LatencyStageCount];
 };
@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "ChatFloodControl.h"
+#include <algorithm>
+
+void ChatFloodControl::Configure(const Settings& settings)
+{
+    settings_ = settings;
+    settings_.maxPerSecond = (std::max)(0, settings_.maxPerSecond);
+    settings_.sampleEvery = (std::max)(1, settings_.sampleEvery);
+    settings_.perUserCap = (std::max)(0, settings_.perUserCap);
+}
+
+void ChatFloodControl::Submit(std::string username, std::string message, Clock::time_point now,
+                              Clock::time_point received)
+{
+    if (!AllowUser(username, now)) {
+        droppedUserCap_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Held copies whose window is over go ahead of this message, which came later
+    ReleaseRecent(now);
+
+    // The same text still waiting to be shown just bumps its count
+    if (settings_.collapseDuplicates) {
+        for (Entry& entry : backlog_) {
+            if (entry.message == message) {
+                ++entry.count;
+                entry.severalUsers = entry.severalUsers || entry.username != username;
+                merged_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+
+        // Or a line shown moments ago: held until its window ends
+        for (Recent& recent : recent_) {
+            if (recent.message == message) {
+                Entry& held = recent.held;
+                if (held.count == 0) {
+                    held.username = std::move(username);
+                    held.received = received;
+                    held.submitted = now;
+                    ++heldCopies_;
+                } else {
+                    held.severalUsers = held.severalUsers || held.username != username;
+                }
+                ++held.count;
+                merged_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    // A non-empty backlog means the display rate is already behind
+    bool backedUp = !backlog_.empty();
+    if (!backedUp) {
+        sampleCounter_ = 0;
+    } else if (settings_.policy == OverflowPolicy::Sample && settings_.sampleEvery > 1) {
+        if (++sampleCounter_ % settings_.sampleEvery != 0) {
+            droppedSampled_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    Enqueue({ std::move(username), std::move(message), 1, false, received, now });
+}
+
+void ChatFloodControl::Enqueue(Entry entry)
+{
+    // Both policies fall back to dropping the oldest once the backlog is full
+    if (backlog_.size() >= kMaxBacklog) {
+        backlog_.pop_front();
+        droppedOverflow_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    backlog_.push_back(std::move(entry));
+}
+
+void ChatFloodControl::Flush(Clock::time_point now, int maxCount, const DisplayFn& display)
+{
+    RefillTokens(now);
+    ReleaseRecent(now);
+
+    int shown = 0;
+    while (!backlog_.empty() && shown < maxCount) {
+        if (settings_.maxPerSecond > 0) {
+            if (tokens_ < 1.0) {
+                break;
+            }
+            tokens_ -= 1.0;
+        }
+
+        // Taken out first: releasing held copies below can push to the backlog
+        Entry entry = std::move(backlog_.front());
+        backlog_.pop_front();
+        if (entry.count > 1) {
+            // Not credited to the first sender alone when others said it too
+            display(entry.severalUsers ? entry.username + " and others" : entry.username,
+                    entry.message + " x" + std::to_string(entry.count), entry.received, entry.submitted);
+        } else {
+            display(entry.username, entry.message, entry.received, entry.submitted);
+        }
+        if (settings_.collapseDuplicates) {
+            if (recent_.size() >= kMaxRecent) {
+                // Full: the oldest line's window ends early
+                ReleaseRecent(recent_.front().shownAt + kCollapseWindow);
+            }
+            recent_.push_back({ std::move(entry.message), now });
+        }
+        ++shown;
+    }
+
+    shown_.fetch_add(shown, std::memory_order_relaxed);
+}
+
+void ChatFloodControl::ReleaseRecent(Clock::time_point now)
+{
+    while (!recent_.empty() && (!settings_.collapseDuplicates || now - recent_.front().shownAt >= kCollapseWindow)) {
+        Recent& recent = recent_.front();
+        if (recent.held.count > 0) {
+            // Shown as "text xN", N counting the copies after the line already shown
+            recent.held.message = std::move(recent.message);
+            Enqueue(std::move(recent.held));
+            --heldCopies_;
+        }
+        recent_.pop_front();
+    }
+}
+
+ChatFloodControl::Clock::duration ChatFloodControl::TimeUntilNextSlot(Clock::time_point now) const
+{
+    if (backlog_.empty()) {
+        // Only held copies left: the next chance to show them is when their window ends
+        for (const Recent& recent : recent_) {
+            if (recent.held.count > 0) {
+                return (std::max)(recent.shownAt + kCollapseWindow - now, Clock::duration::zero());
+            }
+        }
+        return Clock::duration::zero();
+    }
+
+    if (settings_.maxPerSecond <= 0 || tokens_ >= 1.0) {
+        return Clock::duration::zero();
+    }
+
+    std::chrono::duration<double> wait((1.0 - tokens_) / settings_.maxPerSecond);
+    Clock::duration sinceRefill = now - lastRefill_;
+    Clock::duration remaining = std::chrono::duration_cast<Clock::duration>(wait) - sinceRefill;
+    return (std::max)(remaining, Clock::duration::zero());
+}
+
+ChatFloodControl::Stats ChatFloodControl::GetStats() const
+{
+    Stats stats;
+    stats.shown = shown_.load(std::memory_order_relaxed);
+    stats.merged = merged_.load(std::memory_order_relaxed);
+    stats.droppedUserCap = droppedUserCap_.load(std::memory_order_relaxed);
+    stats.droppedSampled = droppedSampled_.load(std::memory_order_relaxed);
+    stats.droppedOverflow = droppedOverflow_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ChatFloodControl::Reset()
+{
+    backlog_.clear();
+    recent_.clear();
+    heldCopies_ = 0;
+    users_.clear();
+    tokens_ = 0.0;
+    lastRefill_ = {};
+    sampleCounter_ = 0;
+
+    shown_ = 0;
+    merged_ = 0;
+    droppedUserCap_ = 0;
+    droppedSampled_ = 0;
+    droppedOverflow_ = 0;
+}
+
+bool ChatFloodControl::AllowUser(const std::string& username, Clock::time_point now)
+{
+    if (settings_.perUserCap <= 0) {
+        return true;
+    }
+
+    // Raids bring thousands of one-off chatters; forget the ones whose window has passed
+    if (users_.size() >= kMaxTrackedUsers) {
+        for (auto it = users_.begin(); it != users_.end();) {
+            if (now - it->second.start >= kUserWindow) {
+                it = users_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    UserWindow& window = users_[username];
+    if (window.count == 0 || now - window.start >= kUserWindow) {
+        window.start = now;
+        window.count = 0;
+    }
+
+    if (window.count >= settings_.perUserCap) {
+        return false;
+    }
+    ++window.count;
+    return true;
+}
+
+void ChatFloodControl::RefillTokens(Clock::time_point now)
+{
+    if (settings_.maxPerSecond <= 0) {
+        return;
+    }
+
+    // Allow a burst of up to one second's worth
+    double capacity = static_cast<double>(settings_.maxPerSecond);
+    if (lastRefill_ == Clock::time_point{}) {
+        tokens_ = capacity;
+    } else {
+        std::chrono::duration<double> elapsed = now - lastRefill_;
+        tokens_ = (std::min)(capacity, tokens_ + elapsed.count() * settings_.maxPerSecond);
+    }
+    lastRefill_ = now;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// Decides which chat messages reach the chatbox when chat is faster than anyone can read.
+// Runs entirely on the game thread; only the counters are read from elsewhere (settings UI).
+class ChatFloodControl
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    // received and submitted are the times passed to Submit, for latency tracking
+    using DisplayFn = std::function<void(const std::string& username, const std::string& message,
+                                         Clock::time_point received, Clock::time_point submitted)>;
+
+    enum class OverflowPolicy
+    {
+        DropOldest = 0,     // keep the newest messages waiting for a display slot
+        Sample = 1,         // while backed up, let only every Nth message in
+    };
+
+    struct Settings
+    {
+        int maxPerSecond = 0;       // 0 = no display rate limit
+        OverflowPolicy policy = OverflowPolicy::DropOldest;
+        int sampleEvery = 5;
+        bool collapseDuplicates = false;
+        int perUserCap = 0;         // messages per user per kUserWindow, 0 = no cap
+    };
+
+    struct Stats
+    {
+        uint64_t shown = 0;
+        uint64_t merged = 0;
+        uint64_t droppedUserCap = 0;
+        uint64_t droppedSampled = 0;
+        uint64_t droppedOverflow = 0;
+        uint64_t droppedQueueFull = 0;  // filled in by Chat; never reached the filter
+    };
+
+    void Configure(const Settings& settings);
+
+    // Filters one incoming message; it is either shown by a later Flush, merged or dropped.
+    // received is when it arrived from Twitch, only handed back to the display callback.
+    void Submit(std::string username, std::string message, Clock::time_point now,
+                Clock::time_point received = {});
+    // Shows waiting messages the rate limit allows, at most maxCount
+    void Flush(Clock::time_point now, int maxCount, const DisplayFn& display);
+
+    // Messages waiting for a slot, or copies of a recent line waiting to be shown as one
+    bool HasBacklog() const { return !backlog_.empty() || heldCopies_ > 0; }
+    // How long until Flush could show another message
+    Clock::duration TimeUntilNextSlot(Clock::time_point now) const;
+
+    Stats GetStats() const;
+    void Reset();
+
+private:
+    struct Entry
+    {
+        std::string username;
+        std::string message;
+        int count = 1;
+        bool severalUsers = false;  // merged with the same text from someone else
+        // A merged entry keeps the times of its first message
+        Clock::time_point received;
+        Clock::time_point submitted;
+    };
+
+    // A line shown within the last kCollapseWindow. Copies of it that arrive in the
+    // meantime fold into held and come out as one "text xN" line when the window
+    // ends, so the first one isn't delayed and a flood spread over several drains
+    // still collapses.
+    struct Recent
+    {
+        std::string message;
+        Clock::time_point shownAt;
+        Entry held{ {}, {}, 0, false, {}, {} };     // count 0 until a copy arrives
+    };
+
+    struct UserWindow
+    {
+        Clock::time_point start;
+        int count = 0;
+    };
+
+    bool AllowUser(const std::string& username, Clock::time_point now);
+    void RefillTokens(Clock::time_point now);
+    void Enqueue(Entry entry);
+    // Moves held copies whose window has ended (all of them when collapsing is off)
+    // into the backlog
+    void ReleaseRecent(Clock::time_point now);
+
+    static constexpr size_t kMaxBacklog = 20;
+    static constexpr std::chrono::seconds kUserWindow{ 10 };
+    static constexpr size_t kMaxTrackedUsers = 4096;
+    static constexpr std::chrono::seconds kCollapseWindow{ 1 };
+    static constexpr size_t kMaxRecent = 64;
+
+    Settings settings_;
+
+    std::deque<Entry> backlog_;
+    std::deque<Recent> recent_;     // oldest first
+    size_t heldCopies_ = 0;         // entries of recent_ holding at least one copy
+    std::unordered_map<std::string, UserWindow> users_;
+
+    double tokens_ = 0.0;
+    Clock::time_point lastRefill_{};
+    uint64_t sampleCounter_ = 0;
+
+    std::atomic<uint64_t> shown_{ 0 };
+    std::atomic<uint64_t> merged_{ 0 };
+    std::atomic<uint64_t> droppedUserCap_{ 0 };
+    std::atomic<uint64_t> droppedSampled_{ 0 };
+    std::atomic<uint64_t> droppedOverflow_{ 0 };
+};
@@ -0,0 +1,97 @@
+#include "pch.h"
+#include "EventSubMessage.h"
+
+bool EventSubMessage::Parse(std::string_view payload, EventSubMessage& out) {
+    Json::Value root = Json::Parse(payload);
+    if (!root.IsObject()) {
+        return false;
+    }
+
+    Json::ForEachMember(root, [&out](const Json::Value& key, const Json::Value& value) {
+        if (key.raw == "metadata") {
+            Json::ForEachMember(value, [&out](const Json::Value& k, const Json::Value& v) {
+                if (k.raw == "message_type") {
+                    out.messageType = v.raw;
+                } else if (k.raw == "message_id") {
+                    out.messageId = v.raw;
+                } else if (k.raw == "message_timestamp") {
+                    out.messageTimestamp = v.raw;
+                } else if (k.raw == "subscription_type") {
+                    out.subscriptionType = v.raw;
+                }
+                return true;
+            });
+        } else if (key.raw == "payload") {
+            Json::ForEachMember(value, [&out](const Json::Value& k, const Json::Value& v) {
+                if (k.raw == "subscription") {
+                    Json::ForEachMember(v, [&out](const Json::Value& field, const Json::Value& fieldValue) {
+                        if (field.raw == "type" && fieldValue.IsString()) {
+                            out.subscriptionType = fieldValue.raw;
+                        } else if (field.raw == "id" && fieldValue.IsString()) {
+                            out.subscriptionId = fieldValue.raw;
+                        }
+                        return out.subscriptionType.empty() || out.subscriptionId.empty();
+                    });
+                } else if (k.raw == "session") {
+                    out.session = v;
+                } else if (k.raw == "event") {
+                    out.event = v;
+                }
+                return true;
+            });
+        }
+        return true;
+    });
+
+    return !out.messageType.empty();
+}
+
+namespace {
+    bool ReadDigits(std::string_view text, size_t offset, size_t count, int& out) {
+        if (offset + count > text.size()) {
+            return false;
+        }
+        out = 0;
+        for (size_t i = offset; i < offset + count; ++i) {
+            if (text[i] < '0' || text[i] > '9') {
+                return false;
+            }
+            out = out * 10 + (text[i] - '0');
+        }
+        return true;
+    }
+}
+
+bool EventSubMessage::ParseTimestamp(std::string_view text, std::chrono::system_clock::time_point& out) {
+    // YYYY-MM-DDTHH:MM:SS[.fraction]Z
+    int year, month, day, hour, minute, second;
+    if (!ReadDigits(text, 0, 4, year) || !ReadDigits(text, 5, 2, month) || !ReadDigits(text, 8, 2, day) ||
+        !ReadDigits(text, 11, 2, hour) || !ReadDigits(text, 14, 2, minute) || !ReadDigits(text, 17, 2, second)) {
+        return false;
+    }
+
+    std::chrono::year_month_day date{ std::chrono::year(year), std::chrono::month(month), std::chrono::day(day) };
+    if (!date.ok()) {
+        return false;
+    }
+
+    // Up to microseconds of the fraction; the clock doesn't need more
+    int64_t micros = 0;
+    size_t i = 19;
+    if (i < text.size() && text[i] == '.') {
+        int digits = 0;
+        for (++i; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+            if (digits < 6) {
+                micros = micros * 10 + (text[i] - '0');
+                ++digits;
+            }
+        }
+        for (; digits < 6; ++digits) {
+            micros *= 10;
+        }
+    }
+
+    out = std::chrono::sys_days(date) + std::chrono::hours(hour) + std::chrono::minutes(minute) +
+        std::chrono::seconds(second) + std::chrono::microseconds(micros);
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <chrono>
+#include <string_view>
+#include "Json.h"
+
+// The fields of an EventSub WebSocket envelope that the plugin dispatches on,
+// found in a single pass over the message. Everything points into the original
+// payload, which must outlive this struct.
+struct EventSubMessage {
+    std::string_view messageId;
+    std::string_view messageType;       // metadata.message_type
+    std::string_view messageTimestamp;  // metadata.message_timestamp
+    std::string_view subscriptionType;  // payload.subscription.type
+    std::string_view subscriptionId;    // payload.subscription.id
+
+    Json::Value session;                // payload.session (welcome/reconnect)
+    Json::Value event;                  // payload.event (notifications)
+
+    // When the frame came off the socket; set by TwitchEventSub, not by Parse
+    std::chrono::steady_clock::time_point receivedAt;
+
+    static bool Parse(std::string_view payload, EventSubMessage& out);
+    // RFC 3339 UTC as Twitch sends it, e.g. 2023-07-19T14:56:51.634234626Z
+    static bool ParseTimestamp(std::string_view text, std::chrono::system_clock::time_point& out);
+};
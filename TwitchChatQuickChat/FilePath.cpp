@@ -0,0 +1,19 @@
+#include "pch.h"
+#include "FilePath.h"
+#include <cstring>
+
+namespace FilePath {
+    FILE* Open(const std::filesystem::path& path, const char* mode) {
+#ifdef _WIN32
+        std::wstring wideMode(mode, mode + std::strlen(mode));
+        return _wfopen(path.c_str(), wideMode.c_str());
+#else
+        return std::fopen(path.c_str(), mode);
+#endif
+    }
+
+    std::string ToString(const std::filesystem::path& path) {
+        std::u8string text = path.u8string();
+        return std::string(text.begin(), text.end());
+    }
+}
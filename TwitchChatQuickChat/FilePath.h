@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+// The data folder sits under the Windows user name, which may not fit the ANSI code
+// page; path::string() throws for such paths, so files are opened through the wide API.
+namespace FilePath {
+    // std::fopen with the same modes
+    FILE* Open(const std::filesystem::path& path, const char* mode);
+    // UTF-8 text for messages, where string() could throw
+    std::string ToString(const std::filesystem::path& path);
+}
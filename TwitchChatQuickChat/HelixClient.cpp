@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "HelixClient.h"
+#include "Trace.h"
+#include "Config.h"
+#include "AsyncExecutor.h"
+#include <cstdlib>
+
+HelixClient::HelixClient()
+{
+}
+
+void HelixClient::SetAccessToken(const std::string& accessToken)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    accessToken_ = accessToken;
+}
+
+httplib::Headers HelixClient::BuildHeaders()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {
+        {"Authorization", "Bearer " + accessToken_},
+        {"Client-Id", Config::TWITCH_CLIENT_ID}
+    };
+}
+
+std::unique_ptr<httplib::SSLClient> HelixClient::Acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            auto client = std::move(idle_.back());
+            idle_.pop_back();
+            return client;
+        }
+    }
+
+    auto client = std::make_unique<httplib::SSLClient>("api.twitch.tv");
+    client->set_connection_timeout(10);
+    client->set_read_timeout(10);
+    client->set_keep_alive(true);
+    return client;
+}
+
+void HelixClient::Release(std::unique_ptr<httplib::SSLClient> client)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.size() < kPoolSize) {
+        idle_.push_back(std::move(client));
+    }
+}
+
+httplib::Result HelixClient::Send(HelixPriority priority, bool idempotent,
+    const std::function<httplib::Result(httplib::SSLClient& client, const httplib::Headers& headers)>& request)
+{
+    std::optional<httplib::Result> last;
+
+    scheduler_.Execute(priority, idempotent, [&]() {
+        // Time spent waiting on the rate limit shows as gaps between attempts
+        TraceSpan span("helix", "Attempt");
+        auto client = Acquire();
+        {
+            // Unload doesn't wait out the read timeout for a request in flight
+            AsyncExecutor::CancelScope cancel([&client]() { client->stop(); });
+            if (AsyncExecutor::IsCancellationRequested()) {
+                return HelixResponseInfo();
+            }
+            last.emplace(request(*client, BuildHeaders()));
+        }
+        Release(std::move(client));
+        return ReadRateLimit(*last);
+    });
+
+    if (!last) {
+        // Never sent: the deadline passed waiting for the rate limit, or we're unloading
+        return httplib::Result(nullptr, httplib::Error::Unknown);
+    }
+    return std::move(*last);
+}
+
+HelixResponseInfo HelixClient::ReadRateLimit(const httplib::Result& result)
+{
+    HelixResponseInfo info;
+    if (!result) {
+        return info;
+    }
+
+    info.status = result->status;
+    if (result->has_header("Ratelimit-Limit")) {
+        info.limit = std::atoi(result->get_header_value("Ratelimit-Limit").c_str());
+    }
+    if (result->has_header("Ratelimit-Remaining")) {
+        info.remaining = std::atoi(result->get_header_value("Ratelimit-Remaining").c_str());
+    }
+    if (result->has_header("Ratelimit-Reset")) {
+        info.resetUnix = std::atoll(result->get_header_value("Ratelimit-Reset").c_str());
+    }
+    return info;
+}
+
+httplib::Result HelixClient::Get(const std::string& path, HelixPriority priority)
+{
+    TraceSpan span("helix", "GET", path);
+    return Send(priority, true, [&](httplib::SSLClient& client, const httplib::Headers& headers) {
+        return client.Get(path, headers);
+    });
+}
+
+httplib::Result HelixClient::Post(const std::string& path, const std::string& body, HelixPriority priority)
+{
+    TraceSpan span("helix", "POST", path);
+    return Send(priority, false, [&](httplib::SSLClient& client, const httplib::Headers& headers) {
+        return client.Post(path, headers, body, "application/json");
+    });
+}
+
+httplib::Result HelixClient::Patch(const std::string& path, const std::string& body, HelixPriority priority)
+{
+    TraceSpan span("helix", "PATCH", path);
+    // Every PATCH we send sets a final state, so repeating one is harmless
+    return Send(priority, true, [&](httplib::SSLClient& client, const httplib::Headers& headers) {
+        return client.Patch(path, headers, body, "application/json");
+    });
+}
+
+httplib::Result HelixClient::Delete(const std::string& path, HelixPriority priority)
+{
+    TraceSpan span("helix", "DELETE", path);
+    return Send(priority, true, [&](httplib::SSLClient& client, const httplib::Headers& headers) {
+        return client.Delete(path, headers);
+    });
+}
+
+void HelixClient::Warm()
+{
+    // Check out every pooled connection at once so each one gets its own socket
+    std::vector<std::unique_ptr<httplib::SSLClient>> clients;
+    for (size_t i = 0; i < kPoolSize; ++i) {
+        clients.push_back(Acquire());
+    }
+
+    // Any cheap request opens the kept-alive connection; the response itself doesn't matter
+    for (auto& client : clients) {
+        // Like Send: unload doesn't wait out the connect and read timeouts of a warm-up
+        AsyncExecutor::CancelScope cancel([&client]() { client->stop(); });
+        if (AsyncExecutor::IsCancellationRequested()) {
+            break;
+        }
+        client->Options("/helix");
+    }
+
+    for (auto& client : clients) {
+        Release(std::move(client));
+    }
+}
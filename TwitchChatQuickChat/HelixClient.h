@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <optional>
+#include <httplib.h>
+#include "HelixScheduler.h"
+
+// Shared client for api.twitch.tv.
+//
+// Keeps a small pool of kept-alive TLS connections so back-to-back Helix calls
+// skip the TCP + TLS handshake. Each request checks a connection out for its
+// duration, so calls from different threads never share a socket.
+//
+// Every call goes through a HelixScheduler: it waits when the rate limit is nearly
+// spent and retries transient failures, so calls may block for up to the priority's
+// deadline. Call off the game thread.
+class HelixClient
+{
+public:
+    static constexpr size_t kPoolSize = 2;
+
+    HelixClient();
+
+    void SetAccessToken(const std::string& accessToken);
+
+    httplib::Result Get(const std::string& path, HelixPriority priority = HelixPriority::Normal);
+    httplib::Result Post(const std::string& path, const std::string& body, HelixPriority priority = HelixPriority::Normal);
+    httplib::Result Patch(const std::string& path, const std::string& body, HelixPriority priority = HelixPriority::Normal);
+    httplib::Result Delete(const std::string& path, HelixPriority priority = HelixPriority::Normal);
+
+    HelixScheduler::Stats GetSchedulerStats() const { return scheduler_.GetStats(); }
+
+    // Opens the pooled connections ahead of time. Blocks; call off the game thread.
+    void Warm();
+
+private:
+    std::unique_ptr<httplib::SSLClient> Acquire();
+    void Release(std::unique_ptr<httplib::SSLClient> client);
+    httplib::Headers BuildHeaders();
+    // Sends through the scheduler on a pooled connection
+    httplib::Result Send(HelixPriority priority, bool idempotent,
+                         const std::function<httplib::Result(httplib::SSLClient& client, const httplib::Headers& headers)>& request);
+    static HelixResponseInfo ReadRateLimit(const httplib::Result& result);
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<httplib::SSLClient>> idle_;
+    std::string accessToken_;
+    HelixScheduler scheduler_;
+};
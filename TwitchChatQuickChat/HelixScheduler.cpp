@@ -0,0 +1,151 @@
+#include "pch.h"
+#include "HelixScheduler.h"
+#include "AsyncExecutor.h"
+#include "ReconnectPolicy.h"
+#include <algorithm>
+#include <thread>
+
+std::chrono::milliseconds HelixScheduler::DeadlineFor(HelixPriority priority) {
+    switch (priority) {
+    case HelixPriority::Critical: return std::chrono::seconds(30);
+    case HelixPriority::Normal: return std::chrono::seconds(10);
+    default: return std::chrono::seconds(5);
+    }
+}
+
+int HelixScheduler::ReserveFor(HelixPriority priority) {
+    switch (priority) {
+    case HelixPriority::Critical: return 0;
+    case HelixPriority::Normal: return 5;
+    default: return 40;
+    }
+}
+
+HelixResponseInfo HelixScheduler::Execute(HelixPriority priority, bool idempotent, const SendFn& send) {
+    Clock::time_point deadline = Clock::now() + DeadlineFor(priority);
+    ReconnectBackoff backoff(kRetryBase, kRetryCap);
+    HelixResponseInfo info;
+
+    while (true) {
+        if (!Acquire(priority, deadline)) {
+            break;
+        }
+
+        info = send();
+        Complete(info);
+
+        bool throttled = info.status == 429;
+        bool transient = info.status == 0 || info.status >= 500;
+        if (!throttled && !(transient && idempotent)) {
+            return info;
+        }
+
+        // A 429 already emptied the bucket, so Acquire() waits for the reset;
+        // the backoff only spreads the retries out
+        Clock::time_point retryAt = Clock::now() + backoff.Next();
+        if (retryAt >= deadline || !SleepUntil(retryAt)) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.retried++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.gaveUp++;
+    return info;
+}
+
+bool HelixScheduler::Acquire(HelixPriority priority, Clock::time_point deadline) {
+    size_t index = static_cast<size_t>(priority);
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    waiting_[index]++;
+    bool granted = false;
+    while (true) {
+        Clock::time_point now = Clock::now();
+        if (CanSendLocked(priority, now)) {
+            granted = true;
+            break;
+        }
+        if (now >= deadline || AsyncExecutor::IsCancellationRequested()) {
+            break;
+        }
+
+        // Wake at the bucket reset at the latest; completions notify sooner
+        Clock::time_point wakeAt = (std::min)({ deadline, now + kWaitSlice,
+            resetAt_ > now ? resetAt_ : now + kWaitSlice });
+        cv_.wait_until(lock, wakeAt);
+    }
+    waiting_[index]--;
+
+    if (granted) {
+        inFlight_++;
+        stats_.sent++;
+    }
+    // Lower priorities may have been held back by this waiter
+    cv_.notify_all();
+    return granted;
+}
+
+bool HelixScheduler::CanSendLocked(HelixPriority priority, Clock::time_point now) const {
+    for (size_t i = 0; i < static_cast<size_t>(priority); ++i) {
+        if (waiting_[i] > 0) {
+            return false;
+        }
+    }
+
+    // Unknown bucket or a bucket that has refilled since
+    if (remaining_ < 0 || now >= resetAt_) {
+        return true;
+    }
+    // Small buckets (e.g. in tests) can't afford the full reserve
+    int reserve = ReserveFor(priority);
+    if (limit_ > 0) {
+        reserve = (std::min)(reserve, limit_ / 4);
+    }
+    return remaining_ - inFlight_ > reserve;
+}
+
+void HelixScheduler::Complete(const HelixResponseInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    inFlight_--;
+
+    if (info.status == 429) {
+        stats_.throttled++;
+        remaining_ = 0;
+    } else if (info.remaining >= 0) {
+        remaining_ = info.remaining;
+    }
+    if (info.limit > 0) {
+        limit_ = info.limit;
+    }
+
+    if (info.resetUnix > 0) {
+        // Ratelimit-Reset is wall-clock; convert to the steady clock
+        auto untilReset = std::chrono::seconds(info.resetUnix) -
+            std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch());
+        resetAt_ = Clock::now() + (std::max)(untilReset, std::chrono::seconds(0));
+    } else if (info.status == 429) {
+        // No reset time given; wait a second before trying again
+        resetAt_ = Clock::now() + std::chrono::seconds(1);
+    }
+
+    stats_.remaining = remaining_;
+    cv_.notify_all();
+}
+
+bool HelixScheduler::SleepUntil(Clock::time_point until) {
+    while (Clock::now() < until) {
+        if (AsyncExecutor::IsCancellationRequested()) {
+            return false;
+        }
+        std::this_thread::sleep_for((std::min)(std::chrono::duration_cast<std::chrono::milliseconds>(until - Clock::now()), kWaitSlice));
+    }
+    return true;
+}
+
+HelixScheduler::Stats HelixScheduler::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Which Helix calls go first when the rate limit runs low. Critical calls may spend
+// the last points of the bucket; the others leave some for them.
+enum class HelixPriority : uint8_t {
+    Critical,       // resolving or cancelling a prediction: losing it leaves the prediction open
+    Normal,         // creating predictions and subscriptions, user lookups
+    Background,     // status reads and cache refreshes
+    Count
+};
+
+// Rate-limit state reported by one Helix response
+struct HelixResponseInfo {
+    int status = 0;             // 0 when no response arrived
+    int limit = -1;             // Ratelimit-Limit, -1 if absent
+    int remaining = -1;         // Ratelimit-Remaining
+    int64_t resetUnix = 0;      // Ratelimit-Reset, unix seconds
+};
+
+// Paces Helix requests against Twitch's token bucket and retries the ones that fail
+// for transient reasons.
+//
+// Each response's Ratelimit-* headers update the bucket. When it runs low, requests
+// wait for the reset - higher priorities first - instead of collecting 429s. A 429,
+// a 5xx or a lost connection is retried with jittered backoff until the priority's
+// deadline; non-idempotent requests are only retried on 429, which Twitch guarantees
+// wasn't processed.
+class HelixScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using SendFn = std::function<HelixResponseInfo()>;
+
+    static constexpr std::chrono::milliseconds kRetryBase{ 250 };
+    static constexpr std::chrono::milliseconds kRetryCap{ 4000 };
+    // Waits are sliced so unload (AsyncExecutor cancellation) is noticed promptly
+    static constexpr std::chrono::milliseconds kWaitSlice{ 100 };
+
+    static std::chrono::milliseconds DeadlineFor(HelixPriority priority);
+    // Points of the bucket a priority leaves untouched for the ones above it
+    static int ReserveFor(HelixPriority priority);
+
+    // Runs send() when the bucket allows, retrying as described above. Returns the
+    // last attempt's info; status 0 if nothing could be sent before the deadline.
+    HelixResponseInfo Execute(HelixPriority priority, bool idempotent, const SendFn& send);
+
+    struct Stats {
+        uint64_t sent = 0;
+        uint64_t throttled = 0;     // 429s received
+        uint64_t retried = 0;
+        uint64_t gaveUp = 0;        // deadline passed without success
+        int remaining = -1;
+    };
+    Stats GetStats() const;
+
+private:
+    // Waits for budget until deadline; false on timeout or cancellation
+    bool Acquire(HelixPriority priority, Clock::time_point deadline);
+    void Complete(const HelixResponseInfo& info);
+    bool CanSendLocked(HelixPriority priority, Clock::time_point now) const;
+    // Sleeps until the given time unless cancelled
+    static bool SleepUntil(Clock::time_point until);
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    int limit_ = -1;
+    int remaining_ = -1;            // -1 until the first response tells us
+    Clock::time_point resetAt_;
+    int inFlight_ = 0;              // granted but not answered yet
+    int waiting_[static_cast<size_t>(HelixPriority::Count)] = {};
+
+    Stats stats_;
+};
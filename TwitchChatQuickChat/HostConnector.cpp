@@ -0,0 +1,226 @@
+#include "pch.h"
+#include "HostConnector.h"
+#include "AsyncExecutor.h"
+#include "logging.h"
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#define closesocket close
+#define WSAPoll poll
+#include <cerrno>
+#include <netinet/tcp.h>
+#endif
+
+namespace {
+    void SetBlocking(SOCKET socket, bool blocking) {
+#ifdef _WIN32
+        u_long nonBlocking = blocking ? 0 : 1;
+        ioctlsocket(socket, FIONBIO, &nonBlocking);
+#else
+        int flags = fcntl(socket, F_GETFL, 0);
+        fcntl(socket, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+#endif
+    }
+
+    // Frames go out as one write each, and a message sent while the previous one
+    // is unacknowledged shouldn't wait for the ack (up to 40 ms with delayed acks)
+    void SetNoDelay(SOCKET socket) {
+        int one = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+    }
+
+    bool ConnectInProgress() {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EINPROGRESS;
+#endif
+    }
+
+    int PendingError(SOCKET socket) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) != 0) {
+            return -1;
+        }
+        return error;
+    }
+}
+
+DnsCache& DnsCache::Get() {
+    static DnsCache instance;
+    return instance;
+}
+
+std::vector<ResolvedAddress> DnsCache::Resolve(const std::string& host, const std::string& port) {
+    std::string key = host + ":" + port;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && Clock::now() < it->second.expires) {
+            return it->second.addresses;
+        }
+    }
+
+    // Resolve without holding the lock; two threads missing together both look up
+    struct addrinfo hints = {}, *result = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    std::vector<ResolvedAddress> addresses;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) == 0) {
+        for (struct addrinfo* info = result; info; info = info->ai_next) {
+            if ((info->ai_family != AF_INET && info->ai_family != AF_INET6) ||
+                info->ai_addrlen > sizeof(sockaddr_storage)) {
+                continue;
+            }
+            ResolvedAddress address;
+            std::memcpy(&address.storage, info->ai_addr, info->ai_addrlen);
+            address.length = static_cast<socklen_t>(info->ai_addrlen);
+            address.family = info->ai_family;
+            addresses.push_back(address);
+        }
+        freeaddrinfo(result);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (addresses.empty()) {
+        LOG("Failed to resolve {}", host);
+        // Better a stale answer than none
+        auto it = entries_.find(key);
+        return it != entries_.end() ? it->second.addresses : addresses;
+    }
+
+    Entry& entry = entries_[key];
+    entry.addresses = addresses;
+    entry.expires = Clock::now() + kTtl;
+    return addresses;
+}
+
+void DnsCache::Invalidate(const std::string& host, const std::string& port) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(host + ":" + port);
+}
+
+SOCKET HostConnector::Connect(const std::string& host, const std::string& port) {
+    std::vector<ResolvedAddress> addresses = DnsCache::Get().Resolve(host, port);
+    if (addresses.empty()) {
+        return INVALID_SOCKET;
+    }
+
+    SOCKET socket = Connect(addresses);
+    if (socket == INVALID_SOCKET) {
+        LOG("Failed to connect to {}", host);
+        // The addresses may have moved; look them up again next time
+        DnsCache::Get().Invalidate(host, port);
+    }
+    return socket;
+}
+
+SOCKET HostConnector::Connect(const std::vector<ResolvedAddress>& addresses) {
+    using Clock = std::chrono::steady_clock;
+
+    struct Attempt {
+        SOCKET socket;
+        Clock::time_point deadline;
+    };
+
+    std::vector<ResolvedAddress> order = Interleave(addresses);
+    std::vector<Attempt> attempts;
+    std::vector<pollfd> fds;
+    size_t next = 0;
+    Clock::time_point nextStart = Clock::now();
+    SOCKET winner = INVALID_SOCKET;
+
+    while (winner == INVALID_SOCKET && (next < order.size() || !attempts.empty())) {
+        // Unloading; the attempts are closed below
+        if (AsyncExecutor::IsCancellationRequested()) {
+            break;
+        }
+        Clock::time_point now = Clock::now();
+
+        // Start the next address when its turn comes, or right away if nothing is pending
+        if (next < order.size() && (now >= nextStart || attempts.empty())) {
+            const ResolvedAddress& address = order[next++];
+            SOCKET socket = ::socket(address.family, SOCK_STREAM, IPPROTO_TCP);
+            if (socket != INVALID_SOCKET) {
+                SetBlocking(socket, false);
+                SetNoDelay(socket);
+                if (connect(socket, address.Get(), address.length) == 0) {
+                    winner = socket;
+                    break;
+                }
+                if (ConnectInProgress()) {
+                    attempts.push_back({ socket, now + kAttemptTimeout });
+                } else {
+                    closesocket(socket);
+                }
+            }
+            nextStart = now + kAttemptDelay;
+            continue;
+        }
+
+        // Wait until an attempt finishes, times out, or the next one is due
+        Clock::time_point wakeAt = next < order.size() ? nextStart : Clock::time_point::max();
+        for (const Attempt& attempt : attempts) {
+            wakeAt = (std::min)(wakeAt, attempt.deadline);
+        }
+        int timeoutMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - now).count());
+        timeoutMs = (std::min)((std::max)(timeoutMs, 0) + 1, static_cast<int>(AsyncExecutor::kCancelPollInterval.count()));
+
+        fds.clear();
+        for (const Attempt& attempt : attempts) {
+            pollfd fd = {};
+            fd.fd = attempt.socket;
+            fd.events = POLLOUT;
+            fds.push_back(fd);
+        }
+        WSAPoll(fds.data(), static_cast<unsigned long>(fds.size()), timeoutMs);
+
+        now = Clock::now();
+        bool failed = false;
+        for (size_t i = attempts.size(); i-- > 0;) {
+            SOCKET socket = attempts[i].socket;
+            bool done = (fds[i].revents & (POLLOUT | POLLERR | POLLHUP)) != 0;
+            if (done && winner == INVALID_SOCKET && PendingError(socket) == 0) {
+                winner = socket;
+            } else if (done || now >= attempts[i].deadline) {
+                closesocket(socket);
+                failed = true;
+            } else {
+                continue;
+            }
+            attempts.erase(attempts.begin() + i);
+        }
+
+        // A failure frees its slot for the next address immediately
+        if (failed) {
+            nextStart = now;
+        }
+    }
+
+    for (const Attempt& attempt : attempts) {
+        closesocket(attempt.socket);
+    }
+
+    // Left non-blocking: the handshakes that follow keep their own deadline
+    return winner;
+}
+
+std::vector<ResolvedAddress> HostConnector::Interleave(const std::vector<ResolvedAddress>& addresses) {
+    std::vector<ResolvedAddress> v6;
+    std::vector<ResolvedAddress> v4;
+    for (const ResolvedAddress& address : addresses) {
+        (address.family == AF_INET6 ? v6 : v4).push_back(address);
+    }
+
+    std::vector<ResolvedAddress> order;
+    order.reserve(addresses.size());
+    for (size_t i = 0; i < (std::max)(v6.size(), v4.size()); ++i) {
+        if (i < v6.size()) order.push_back(v6[i]);
+        if (i < v4.size()) order.push_back(v4[i]);
+    }
+    return order;
+}
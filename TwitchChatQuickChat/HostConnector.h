@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+
+#include "WebSocketTransport.h"
+
+// A resolved address in a form that can be copied around and cached
+struct ResolvedAddress {
+    sockaddr_storage storage = {};
+    socklen_t length = 0;
+    int family = AF_UNSPEC;
+
+    const sockaddr* Get() const { return reinterpret_cast<const sockaddr*>(&storage); }
+};
+
+// getaddrinfo results for the handful of Twitch hosts, kept for kTtl.
+//
+// getaddrinfo doesn't report record TTLs, so entries live for a fixed time. A stale
+// entry is still returned when a fresh lookup fails, and callers Invalidate() a host
+// once none of its addresses connect.
+class DnsCache {
+public:
+    static constexpr std::chrono::seconds kTtl{ 300 };
+
+    static DnsCache& Get();
+
+    // IPv6 and IPv4 addresses in the resolver's order; empty if resolution failed.
+    // Blocks on a miss; call off the game thread.
+    std::vector<ResolvedAddress> Resolve(const std::string& host, const std::string& port);
+    void Invalidate(const std::string& host, const std::string& port);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::vector<ResolvedAddress> addresses;
+        Clock::time_point expires;
+    };
+
+    DnsCache() = default;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;   // keyed by "host:port"
+};
+
+// Opens a TCP connection to host:port, racing IPv6 and IPv4 addresses (RFC 8305).
+//
+// Attempts start kAttemptDelay apart, alternating families, or sooner when one
+// fails; the first to complete wins and the rest are closed. Each attempt gives
+// up after kAttemptTimeout, so one black-holed address costs at most that long
+// rather than the OS connect timeout. Returns a non-blocking socket, or INVALID_SOCKET.
+class HostConnector {
+public:
+    static constexpr std::chrono::milliseconds kAttemptDelay{ 250 };
+    static constexpr std::chrono::milliseconds kAttemptTimeout{ 5000 };
+
+    static SOCKET Connect(const std::string& host, const std::string& port);
+    static SOCKET Connect(const std::vector<ResolvedAddress>& addresses);
+
+private:
+    // IPv6 first, then alternating families, keeping the resolver's order within each
+    static std::vector<ResolvedAddress> Interleave(const std::vector<ResolvedAddress>& addresses);
+};
@@ -0,0 +1,143 @@
+#include "pch.h"
+#include "IrcMessage.h"
+
+namespace {
+    // Splits off the next space-delimited token; IRC allows runs of spaces
+    std::string_view NextToken(std::string_view& rest) {
+        size_t start = rest.find_first_not_of(' ');
+        if (start == std::string_view::npos) {
+            rest = {};
+            return {};
+        }
+        rest.remove_prefix(start);
+
+        size_t end = rest.find(' ');
+        std::string_view token = rest.substr(0, end);
+        rest.remove_prefix(end == std::string_view::npos ? rest.size() : end);
+        return token;
+    }
+}
+
+bool IrcMessage::Parse(std::string_view line, IrcMessage& out) {
+    // Only what's always read is reset; tag values and params are guarded by
+    // tagPresent and paramCount, so they don't need clearing
+    out.tags = {};
+    out.prefix = {};
+    out.command = {};
+    out.paramCount = 0;
+    out.trailing = {};
+    out.hasTrailing = false;
+    out.tagPresent = 0;
+
+    std::string_view rest = line;
+
+    if (!rest.empty() && rest.front() == '@') {
+        std::string_view tags = NextToken(rest);
+        tags.remove_prefix(1);
+        out.tags = tags;
+
+        // key=value;key=value;key   (a missing value means empty)
+        while (!tags.empty()) {
+            size_t end = tags.find(';');
+            std::string_view pair = tags.substr(0, end);
+            size_t eq = pair.find('=');
+            std::string_view key = pair.substr(0, eq);
+
+            IrcTag::Id id = IrcTag::Lookup(key);
+            if (id != IrcTag::Unknown) {
+                out.tagValues[id] = eq == std::string_view::npos ? std::string_view() : pair.substr(eq + 1);
+                out.tagPresent |= uint64_t(1) << id;
+            }
+
+            if (end == std::string_view::npos) {
+                break;
+            }
+            tags.remove_prefix(end + 1);
+        }
+    }
+
+    size_t start = rest.find_first_not_of(' ');
+    if (start != std::string_view::npos && rest[start] == ':') {
+        std::string_view prefix = NextToken(rest);
+        prefix.remove_prefix(1);
+        out.prefix = prefix;
+    }
+
+    out.command = NextToken(rest);
+    if (out.command.empty()) {
+        return false;
+    }
+
+    while (true) {
+        start = rest.find_first_not_of(' ');
+        if (start == std::string_view::npos) {
+            break;
+        }
+        if (rest[start] == ':') {
+            out.trailing = rest.substr(start + 1);
+            out.hasTrailing = true;
+            break;
+        }
+        if (out.paramCount == kMaxParams) {
+            // RFC 1459 caps params at 15; the remainder is the last one
+            out.trailing = rest.substr(start);
+            out.hasTrailing = true;
+            break;
+        }
+
+        out.params[out.paramCount++] = NextToken(rest);
+    }
+
+    return true;
+}
+
+std::string_view IrcMessage::Tag(std::string_view key) const {
+    IrcTag::Id id = IrcTag::Lookup(key);
+    if (id != IrcTag::Unknown) {
+        return Tag(id);
+    }
+
+    std::string_view rest = tags;
+    while (!rest.empty()) {
+        size_t end = rest.find(';');
+        std::string_view pair = rest.substr(0, end);
+        size_t eq = pair.find('=');
+        if (pair.substr(0, eq) == key) {
+            return eq == std::string_view::npos ? std::string_view() : pair.substr(eq + 1);
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        rest.remove_prefix(end + 1);
+    }
+    return {};
+}
+
+std::string_view IrcMessage::Nick() const {
+    return prefix.substr(0, prefix.find('!'));
+}
+
+std::string UnescapeTagValue(std::string_view value) {
+    std::string out;
+    out.reserve(value.size());
+
+    for (size_t i = 0; i < value.size(); ++i) {
+        char c = value[i];
+        if (c != '\\') {
+            out.push_back(c);
+            continue;
+        }
+        // A trailing lone backslash is dropped
+        if (++i == value.size()) {
+            break;
+        }
+        switch (value[i]) {
+        case 's': out.push_back(' '); break;
+        case ':': out.push_back(';'); break;
+        case 'r': out.push_back('\r'); break;
+        case 'n': out.push_back('\n'); break;
+        default: out.push_back(value[i]); break;
+        }
+    }
+    return out;
+}
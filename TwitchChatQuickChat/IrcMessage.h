@@ -0,0 +1,135 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Twitch IRCv3 tags the plugin knows by name.
+//
+// Tag keys are looked up through a perfect hash: every known key lands in its own
+// slot of a 64-entry table, checked at compile time, so a lookup is one hash and
+// one string compare.
+namespace IrcTag {
+
+    enum Id : uint8_t {
+        BadgeInfo, Badges, Bits, ClientNonce, Color, DisplayName, EmoteOnly, Emotes,
+        FirstMsg, Flags, MessageId, Login, Mod, MsgId, ReplyParentMsgId, ReplyParentUserId,
+        ReplyParentUserLogin, ReplyParentDisplayName, ReplyParentMsgBody, ReturningChatter,
+        RoomId, Subscriber, SystemMsg, TargetUserId, TmiSentTs, Turbo, UserId, UserType,
+        Vip, BanDuration, FollowersOnly, R9k, Slow, SubsOnly,
+        Count,
+        Unknown = Count,
+    };
+
+    inline constexpr std::string_view kNames[Count] = {
+        "badge-info", "badges", "bits", "client-nonce", "color", "display-name", "emote-only", "emotes",
+        "first-msg", "flags", "id", "login", "mod", "msg-id", "reply-parent-msg-id", "reply-parent-user-id",
+        "reply-parent-user-login", "reply-parent-display-name", "reply-parent-msg-body", "returning-chatter",
+        "room-id", "subscriber", "system-msg", "target-user-id", "tmi-sent-ts", "turbo", "user-id", "user-type",
+        "vip", "ban-duration", "followers-only", "r9k", "slow", "subs-only",
+    };
+
+    // FNV-1a with a seed picked so the known keys don't collide in the top 6 bits
+    inline constexpr uint32_t kSeed = 0x811D5C52;
+    inline constexpr size_t kTableBits = 6;
+    inline constexpr size_t kTableSize = size_t(1) << kTableBits;
+
+    constexpr size_t Slot(std::string_view key) {
+        uint32_t hash = kSeed;
+        for (char c : key) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 16777619u;
+        }
+        return hash >> (32 - kTableBits);
+    }
+
+    constexpr std::array<uint8_t, kTableSize> BuildTable() {
+        std::array<uint8_t, kTableSize> table{};
+        for (auto& entry : table) {
+            entry = Unknown;
+        }
+        for (uint8_t id = 0; id < Count; ++id) {
+            table[Slot(kNames[id])] = id;
+        }
+        return table;
+    }
+
+    constexpr bool IsPerfect() {
+        std::array<bool, kTableSize> used{};
+        for (uint8_t id = 0; id < Count; ++id) {
+            size_t slot = Slot(kNames[id]);
+            if (used[slot]) {
+                return false;
+            }
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    static_assert(IsPerfect(), "IRC tag names collide; pick another kSeed");
+
+    inline constexpr std::array<uint8_t, kTableSize> kTable = BuildTable();
+
+    constexpr Id Lookup(std::string_view key) {
+        uint8_t id = kTable[Slot(key)];
+        return id != Unknown && kNames[id] == key ? static_cast<Id>(id) : Unknown;
+    }
+
+} // namespace IrcTag
+
+// One parsed IRC line. Everything is a view into the line, which must outlive it;
+// parsing never allocates.
+//
+//   @tags :prefix COMMAND param1 param2 :trailing
+struct IrcMessage {
+    static constexpr size_t kMaxParams = 15;
+
+    std::string_view tags;      // without the leading '@'
+    std::string_view prefix;    // without the leading ':'
+    std::string_view command;
+    std::array<std::string_view, kMaxParams> params;     // middle params, [0, paramCount)
+    size_t paramCount = 0;
+    std::string_view trailing;  // text after " :", without the colon
+    bool hasTrailing = false;
+
+    // Still IRCv3-escaped; see UnescapeTagValue
+    std::string_view Tag(IrcTag::Id id) const { return HasTag(id) ? tagValues[id] : std::string_view(); }
+    bool HasTag(IrcTag::Id id) const { return id < IrcTag::Count && (tagPresent >> id) & 1; }
+    // Slower path for keys outside IrcTag; scans the tag string
+    std::string_view Tag(std::string_view key) const;
+
+    // nick from "nick!user@host"
+    std::string_view Nick() const;
+
+    // Parses one line (without its \r\n); false if there's no command
+    static bool Parse(std::string_view line, IrcMessage& out);
+
+private:
+    std::array<std::string_view, IrcTag::Count> tagValues;  // valid where tagPresent is set
+    uint64_t tagPresent = 0;
+};
+
+static_assert(IrcTag::Count <= 64, "tagPresent is a 64-bit mask");
+
+// Undoes IRCv3 tag value escaping (\s \: \\ \r \n)
+std::string UnescapeTagValue(std::string_view value);
+
+// Calls fn(line) for every non-empty line of a frame; Twitch packs several
+// \r\n-terminated lines into one WebSocket message
+template <typename Fn>
+void ForEachIrcLine(std::string_view frame, Fn&& fn) {
+    while (!frame.empty()) {
+        size_t end = frame.find('\n');
+        std::string_view line = frame.substr(0, end);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            fn(line);
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        frame.remove_prefix(end + 1);
+    }
+}
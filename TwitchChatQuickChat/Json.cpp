@@ -0,0 +1,309 @@
+#include "pch.h"
+#include "Json.h"
+#include <cstring>
+
+namespace Json {
+
+    namespace Detail {
+
+        size_t SkipWhitespace(std::string_view json, size_t pos) {
+            while (pos < json.size() &&
+                   (json[pos] == ' ' || json[pos] == '\n' || json[pos] == '\r' || json[pos] == '\t')) {
+                ++pos;
+            }
+            return pos;
+        }
+
+        // pos points just past the opening quote; returns the position of the closing quote
+        size_t ScanString(std::string_view json, size_t pos, bool& escaped) {
+            const char* begin = json.data();
+            const char* end = begin + json.size();
+            const char* p = begin + pos;
+            while (p < end) {
+                // memchr is vectorized; most strings contain no escapes at all
+                const char* quote = static_cast<const char*>(std::memchr(p, '"', end - p));
+                if (!quote) {
+                    break;
+                }
+
+                const char* slash = static_cast<const char*>(std::memchr(p, '\\', quote - p));
+                if (!slash) {
+                    return quote - begin;
+                }
+
+                escaped = true;
+                // Count the backslashes right before the quote; an odd run escapes it
+                size_t run = 0;
+                for (const char* q = quote - 1; q >= slash && *q == '\\'; --q) {
+                    ++run;
+                }
+                if (run % 2 == 0) {
+                    return quote - begin;
+                }
+                p = quote + 1;
+            }
+            return std::string_view::npos;
+        }
+
+        size_t NextMember(std::string_view json, size_t pos, char closer) {
+            pos = SkipWhitespace(json, pos);
+            if (pos >= json.size()) {
+                return std::string_view::npos;
+            }
+            if (json[pos] == closer) {
+                return pos;
+            }
+            if (json[pos] != ',') {
+                return std::string_view::npos;
+            }
+            // A trailing comma isn't followed by another member
+            pos = SkipWhitespace(json, pos + 1);
+            if (pos >= json.size() || json[pos] == closer) {
+                return std::string_view::npos;
+            }
+            return pos;
+        }
+
+        // pos points at '{' or '['; returns the position just past the matching bracket,
+        // or npos if a closer doesn't match its opener
+        size_t SkipContainer(std::string_view json, size_t pos) {
+            // Openers still waiting for their closer. Twitch nests a handful deep, so
+            // anything past kMaxDepth is treated as malformed rather than allocated for.
+            constexpr int kMaxDepth = 64;
+            char open[kMaxDepth];
+            int depth = 0;
+            const size_t size = json.size();
+            const char* data = json.data();
+            while (pos < size) {
+                char c = data[pos];
+                switch (c) {
+                case '"': {
+                    bool escaped = false;
+                    pos = ScanString(json, pos + 1, escaped);
+                    if (pos == std::string_view::npos) {
+                        return pos;
+                    }
+                    break;
+                }
+                case '{':
+                case '[':
+                    if (depth == kMaxDepth) {
+                        return std::string_view::npos;
+                    }
+                    open[depth++] = c;
+                    break;
+                case '}':
+                case ']':
+                    if (depth == 0 || open[--depth] != (c == '}' ? '{' : '[')) {
+                        return std::string_view::npos;
+                    }
+                    if (depth == 0) {
+                        return pos + 1;
+                    }
+                    break;
+                default:
+                    break;
+                }
+                ++pos;
+            }
+            return std::string_view::npos;
+        }
+
+        size_t ReadValue(std::string_view json, size_t pos, Value& out) {
+            pos = SkipWhitespace(json, pos);
+            if (pos >= json.size()) {
+                return std::string_view::npos;
+            }
+
+            size_t start = pos;
+            char c = json[pos];
+            if (c == '"') {
+                bool escaped = false;
+                size_t end = ScanString(json, pos + 1, escaped);
+                if (end == std::string_view::npos) {
+                    return end;
+                }
+                out.type = Type::String;
+                out.raw = json.substr(start + 1, end - start - 1);
+                out.escaped = escaped;
+                return end + 1;
+            }
+
+            if (c == '{' || c == '[') {
+                size_t end = SkipContainer(json, pos);
+                if (end == std::string_view::npos) {
+                    return end;
+                }
+                out.type = c == '{' ? Type::Object : Type::Array;
+                out.raw = json.substr(start, end - start);
+                out.escaped = false;
+                return end;
+            }
+
+            // Number or literal: runs until the next delimiter
+            while (pos < json.size() && json[pos] != ',' && json[pos] != '}' && json[pos] != ']' &&
+                   json[pos] != ' ' && json[pos] != '\n' && json[pos] != '\r' && json[pos] != '\t') {
+                ++pos;
+            }
+            // Nothing before the delimiter, e.g. a closer where a value belongs
+            if (pos == start) {
+                return std::string_view::npos;
+            }
+            out.raw = json.substr(start, pos - start);
+            out.escaped = false;
+            if (c == 't' || c == 'f') {
+                out.type = Type::Bool;
+            } else if (c == 'n') {
+                out.type = Type::Null;
+            } else {
+                out.type = Type::Number;
+            }
+            return pos;
+        }
+
+    } // namespace Detail
+
+    Value Parse(std::string_view json) {
+        Value value;
+        if (Detail::ReadValue(json, 0, value) == std::string_view::npos) {
+            return {};
+        }
+        return value;
+    }
+
+    Value Find(const Value& object, std::string_view key) {
+        Value found;
+        ForEachMember(object, [&](const Value& k, const Value& v) {
+            if (k.raw == key) {
+                found = v;
+                return false;
+            }
+            return true;
+        });
+        return found;
+    }
+
+    Value FindPath(const Value& object, std::initializer_list<std::string_view> path) {
+        Value current = object;
+        for (std::string_view key : path) {
+            current = Find(current, key);
+            if (!current) {
+                break;
+            }
+        }
+        return current;
+    }
+
+    std::string Value::ToString() const {
+        if (type == Type::String && escaped) {
+            return Unescape(raw);
+        }
+        return std::string(raw);
+    }
+
+    int64_t Value::ToInt(int64_t fallback) const {
+        std::string_view digits = raw;
+        if (type != Type::Number && type != Type::String) {
+            return fallback;
+        }
+
+        bool negative = !digits.empty() && digits[0] == '-';
+        if (negative) {
+            digits.remove_prefix(1);
+        }
+        if (digits.empty()) {
+            return fallback;
+        }
+
+        int64_t result = 0;
+        for (char c : digits) {
+            if (c < '0' || c > '9') {
+                break;
+            }
+            result = result * 10 + (c - '0');
+        }
+        return negative ? -result : result;
+    }
+
+    namespace {
+        void AppendUtf8(std::string& out, uint32_t cp) {
+            if (cp < 0x80) {
+                out.push_back(static_cast<char>(cp));
+            } else if (cp < 0x800) {
+                out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+                out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            } else if (cp < 0x10000) {
+                out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            } else {
+                out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+        }
+
+        bool ReadHex4(std::string_view s, size_t pos, uint32_t& value) {
+            if (pos + 4 > s.size()) {
+                return false;
+            }
+            value = 0;
+            for (size_t i = pos; i < pos + 4; ++i) {
+                char c = s[i];
+                value <<= 4;
+                if (c >= '0' && c <= '9') value |= c - '0';
+                else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+                else return false;
+            }
+            return true;
+        }
+    }
+
+    std::string Unescape(std::string_view raw) {
+        std::string out;
+        out.reserve(raw.size());
+
+        for (size_t i = 0; i < raw.size(); ++i) {
+            char c = raw[i];
+            if (c != '\\' || i + 1 >= raw.size()) {
+                out.push_back(c);
+                continue;
+            }
+
+            char e = raw[++i];
+            switch (e) {
+            case 'n': out.push_back('\n'); break;
+            case 't': out.push_back('\t'); break;
+            case 'r': out.push_back('\r'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'u': {
+                uint32_t cp;
+                if (!ReadHex4(raw, i + 1, cp)) {
+                    break;
+                }
+                i += 4;
+                // Surrogate pair for characters outside the BMP (most emoji)
+                if (cp >= 0xD800 && cp <= 0xDBFF && i + 2 < raw.size() &&
+                    raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+                    uint32_t low;
+                    if (ReadHex4(raw, i + 3, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                AppendUtf8(out, cp);
+                break;
+            }
+            default:
+                // \" \\ \/ map to themselves
+                out.push_back(e);
+                break;
+            }
+        }
+        return out;
+    }
+
+} // namespace Json
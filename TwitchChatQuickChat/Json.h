@@ -0,0 +1,123 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <initializer_list>
+#include <cstdint>
+
+// Minimal read-only JSON access without building a DOM.
+//
+// Values are views into the original text. Strings keep their escape sequences
+// until ToString() is called, so looking at a field costs a scan and nothing more.
+namespace Json {
+
+    enum class Type : uint8_t { None, Object, Array, String, Number, Bool, Null };
+
+    struct Value {
+        Type type = Type::None;
+        // Strings: the characters between the quotes, still escaped.
+        // Everything else: the full token, including brackets for objects/arrays.
+        std::string_view raw;
+        bool escaped = false;
+
+        explicit operator bool() const { return type != Type::None; }
+        bool IsObject() const { return type == Type::Object; }
+        bool IsString() const { return type == Type::String; }
+
+        // Unescaped copy of a string value; the raw token for anything else
+        std::string ToString() const;
+        // Compares a string value with plain text without unescaping
+        bool Equals(std::string_view text) const { return type == Type::String && !escaped && raw == text; }
+        int64_t ToInt(int64_t fallback = 0) const;
+    };
+
+    // Parses the value at the start of json (after whitespace)
+    Value Parse(std::string_view json);
+
+    // Looks up a member of an object value
+    Value Find(const Value& object, std::string_view key);
+    // Follows nested object members, e.g. {"message", "text"}
+    Value FindPath(const Value& object, std::initializer_list<std::string_view> path);
+
+    // Calls fn(key, value) for each member of an object until fn returns false.
+    // Returns false if the walk stopped at malformed input.
+    template <typename Fn>
+    bool ForEachMember(const Value& object, Fn&& fn);
+    // Calls fn(value) for each element of an array until fn returns false.
+    // Returns false if the walk stopped at malformed input.
+    template <typename Fn>
+    bool ForEachElement(const Value& array, Fn&& fn);
+
+    std::string Unescape(std::string_view raw);
+
+    namespace Detail {
+        // Reads one value at pos; returns the position just past it, or npos if malformed
+        size_t ReadValue(std::string_view json, size_t pos, Value& out);
+        size_t SkipWhitespace(std::string_view json, size_t pos);
+        // After a member or element: the start of the next one, the position of the
+        // closing bracket, or npos if neither follows
+        size_t NextMember(std::string_view json, size_t pos, char closer);
+    }
+
+    template <typename Fn>
+    bool ForEachMember(const Value& object, Fn&& fn) {
+        if (object.type != Type::Object) {
+            return false;
+        }
+
+        std::string_view json = object.raw;
+        size_t pos = Detail::SkipWhitespace(json, 1);
+        while (pos < json.size() && json[pos] != '}') {
+            Value key;
+            pos = Detail::ReadValue(json, pos, key);
+            if (pos == std::string_view::npos || key.type != Type::String) {
+                return false;
+            }
+            pos = Detail::SkipWhitespace(json, pos);
+            if (pos >= json.size() || json[pos] != ':') {
+                return false;
+            }
+
+            Value value;
+            pos = Detail::ReadValue(json, pos + 1, value);
+            if (pos == std::string_view::npos) {
+                return false;
+            }
+            if (!fn(key, value)) {
+                return true;
+            }
+
+            pos = Detail::NextMember(json, pos, '}');
+            if (pos == std::string_view::npos) {
+                return false;
+            }
+        }
+        return pos < json.size();
+    }
+
+    template <typename Fn>
+    bool ForEachElement(const Value& array, Fn&& fn) {
+        if (array.type != Type::Array) {
+            return false;
+        }
+
+        std::string_view json = array.raw;
+        size_t pos = Detail::SkipWhitespace(json, 1);
+        while (pos < json.size() && json[pos] != ']') {
+            Value value;
+            pos = Detail::ReadValue(json, pos, value);
+            if (pos == std::string_view::npos) {
+                return false;
+            }
+            if (!fn(value)) {
+                return true;
+            }
+
+            pos = Detail::NextMember(json, pos, ']');
+            if (pos == std::string_view::npos) {
+                return false;
+            }
+        }
+        return pos < json.size();
+    }
+
+} // namespace Json
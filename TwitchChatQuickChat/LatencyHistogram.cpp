@@ -0,0 +1,103 @@
+#include "pch.h"
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <bit>
+#include <format>
+
+void LatencyHistogram::Record(int64_t micros) {
+    uint64_t value = micros > 0 ? static_cast<uint64_t>(micros) : 0;
+    buckets_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+size_t LatencyHistogram::BucketOf(uint64_t micros) {
+    if (micros < kSubBuckets) {
+        return static_cast<size_t>(micros);
+    }
+    int exponent = (std::min)(static_cast<int>(std::bit_width(micros)) - 1, kMaxExponent);
+    int shift = exponent - kSubBucketBits;
+    uint64_t sub = (std::min)(micros >> shift, 2 * kSubBuckets - 1) - kSubBuckets;
+    return static_cast<size_t>(kSubBuckets + shift * kSubBuckets + sub);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    size_t shift = (index - kSubBuckets) / kSubBuckets;
+    uint64_t sub = (index - kSubBuckets) % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::CopyCounts(uint64_t (&counts)[kBucketCount]) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    return total;
+}
+
+int64_t LatencyHistogram::ValueAt(const uint64_t (&counts)[kBucketCount], uint64_t total, double fraction) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (std::max)(uint64_t(1), static_cast<uint64_t>(fraction * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // The bucket's top can overshoot the largest value actually recorded
+            return static_cast<int64_t>((std::min)(BucketUpperBound(i), max_.load(std::memory_order_relaxed)));
+        }
+    }
+    return static_cast<int64_t>(max_.load(std::memory_order_relaxed));
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const {
+    uint64_t counts[kBucketCount];
+    Snapshot snapshot;
+    snapshot.count = CopyCounts(counts);
+    if (snapshot.count == 0) {
+        return snapshot;
+    }
+    snapshot.meanUs = static_cast<double>(sum_.load(std::memory_order_relaxed)) / snapshot.count;
+    snapshot.maxUs = static_cast<int64_t>(max_.load(std::memory_order_relaxed));
+    snapshot.p50Us = ValueAt(counts, snapshot.count, 0.50);
+    snapshot.p99Us = ValueAt(counts, snapshot.count, 0.99);
+    snapshot.p999Us = ValueAt(counts, snapshot.count, 0.999);
+    return snapshot;
+}
+
+std::string LatencyHistogram::ToJson() const {
+    uint64_t counts[kBucketCount];
+    uint64_t total = CopyCounts(counts);
+    double mean = total ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / total : 0.0;
+
+    std::string json = std::format(R"({{"count":{},"mean_us":{:.1f},"max_us":{},"p50_us":{},"p99_us":{},"p999_us":{},"buckets":[)",
+        total, mean, total ? max_.load(std::memory_order_relaxed) : 0,
+        ValueAt(counts, total, 0.50), ValueAt(counts, total, 0.99), ValueAt(counts, total, 0.999));
+
+    bool first = true;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        json += std::format("{}[{},{}]", first ? "" : ",", BucketUpperBound(i), counts[i]);
+        first = false;
+    }
+    json += "]}";
+    return json;
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Lock-free latency histogram in the style of HdrHistogram, in microseconds.
+//
+// Buckets are log-linear: exact below kSubBuckets, then kSubBuckets per power of
+// two, so any recorded value is reported within about 6% over a range of
+// microseconds to hours. Recording is one relaxed increment (plus a CAS when a new
+// maximum is seen) from any thread; readers take a snapshot whenever they like.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr uint64_t kSubBuckets = uint64_t(1) << kSubBucketBits;
+    static constexpr int kMaxExponent = 36;                 // values are capped at about 38 hours
+    static constexpr size_t kBucketCount = kSubBuckets * (kMaxExponent - kSubBucketBits + 2);
+
+    struct Snapshot {
+        uint64_t count = 0;
+        double meanUs = 0.0;
+        int64_t maxUs = 0;
+        int64_t p50Us = 0;
+        int64_t p99Us = 0;
+        int64_t p999Us = 0;
+    };
+
+    // Negative durations (clock skew) count as 0
+    void Record(int64_t micros);
+    template <typename Rep, typename Period>
+    void Record(std::chrono::duration<Rep, Period> duration) {
+        Record(static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+    }
+
+    Snapshot GetSnapshot() const;
+    // {"count":..,"mean_us":..,"max_us":..,"p50_us":..,"p99_us":..,"p999_us":..,
+    //  "buckets":[[upper_us,count],...]} with only the non-empty buckets
+    std::string ToJson() const;
+    void Reset();
+
+private:
+    static size_t BucketOf(uint64_t micros);
+    // Largest value that lands in the bucket
+    static uint64_t BucketUpperBound(size_t index);
+    // Smallest recorded value at or above fraction of all samples
+    int64_t ValueAt(const uint64_t (&counts)[kBucketCount], uint64_t total, double fraction) const;
+    uint64_t CopyCounts(uint64_t (&counts)[kBucketCount]) const;
+
+    std::atomic<uint64_t> buckets_[kBucketCount] = {};
+    std::atomic<uint64_t> sum_{ 0 };
+    std::atomic<uint64_t> max_{ 0 };
+};
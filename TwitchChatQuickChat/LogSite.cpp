@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "LogSite.h"
+#include <format>
+
+namespace {
+    // MSVC's function_name() is the whole signature; keep the qualified name
+    std::string ShortFunctionName(std::string_view signature) {
+        std::string_view name = signature.substr(0, signature.find('('));
+        size_t space = name.rfind(' ');
+        if (space != std::string_view::npos) {
+            name.remove_prefix(space + 1);
+        }
+        return std::string(name.empty() ? signature : name);
+    }
+}
+
+LogSites& LogSites::Get() {
+    static LogSites instance;
+    return instance;
+}
+
+uint32_t LogSites::Register(LogSite& site) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Another thread may have numbered it while we waited
+    uint32_t id = site.id.load(std::memory_order_relaxed);
+    if (id != 0) {
+        return id;
+    }
+
+    if (count_ == kMaxSites) {
+        if (entries_[kOverflow].location.empty()) {
+            entries_[kOverflow].location = "[unknown site]";
+            SetBit(kOverflow, true);
+        }
+        site.id.store(kOverflow, std::memory_order_release);
+        return kOverflow;
+    }
+
+    id = ++count_;
+    Entry& entry = entries_[id];
+    entry.site = &site;
+    entry.location = std::format("[{} ({}:{})]", ShortFunctionName(site.function), site.file, site.line);
+
+    bool enabled = true;
+    for (const Rule& rule : rules_) {
+        if (Matches(site, rule.pattern)) {
+            enabled = rule.enabled;
+        }
+    }
+    SetBit(id, enabled);
+
+    site.id.store(id, std::memory_order_release);
+    return id;
+}
+
+size_t LogSites::SetEnabled(std::string_view pattern, bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pattern == "all") {
+        rules_.clear();
+    }
+    rules_.push_back({ std::string(pattern), enabled });
+
+    size_t matched = 0;
+    for (uint32_t id = 1; id <= count_; ++id) {
+        if (Matches(*entries_[id].site, pattern)) {
+            SetBit(id, enabled);
+            ++matched;
+        }
+    }
+    return matched;
+}
+
+const std::string& LogSites::Location(const LogSite& site) const {
+    // Entries are written before the id is published and never change after
+    uint32_t id = site.id.load(std::memory_order_acquire);
+    return entries_[id].location;
+}
+
+std::vector<std::string> LogSites::Describe() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> lines;
+    lines.reserve(count_);
+    for (uint32_t id = 1; id <= count_; ++id) {
+        bool enabled = (enabled_[id / 64].load(std::memory_order_relaxed) >> (id % 64)) & 1;
+        lines.push_back(std::format("{} {}", enabled ? "on " : "off", entries_[id].location));
+    }
+    return lines;
+}
+
+bool LogSites::Matches(const LogSite& site, std::string_view pattern) {
+    if (pattern == "all") {
+        return true;
+    }
+    size_t colon = pattern.rfind(':');
+    if (colon == std::string_view::npos) {
+        return pattern == site.file;
+    }
+    return pattern.substr(0, colon) == site.file && pattern.substr(colon + 1) == std::to_string(site.line);
+}
+
+void LogSites::SetBit(uint32_t id, bool enabled) {
+    uint64_t bit = uint64_t(1) << (id % 64);
+    if (enabled) {
+        enabled_[id / 64].fetch_or(bit, std::memory_order_relaxed);
+    } else {
+        enabled_[id / 64].fetch_and(~bit, std::memory_order_relaxed);
+    }
+}
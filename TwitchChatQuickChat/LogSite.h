@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One LOG/DEBUGLOG call site. The LOG macros declare one of these as a constinit
+// static, so the location costs nothing at runtime; the site is numbered the first
+// time it runs.
+struct LogSite {
+    const char* function;
+    const char* file;           // file name only, no directory
+    uint32_t line;
+    std::atomic<uint32_t> id{ 0 };      // slot in LogSites, 0 until first use
+
+    constexpr explicit LogSite(const std::source_location& location)
+        : function(location.function_name()), file(BaseName(location.file_name())), line(location.line()) {
+    }
+
+    static constexpr const char* BaseName(const char* path) {
+        const char* base = path;
+        for (const char* c = path; *c; ++c) {
+            if (*c == '/' || *c == '\\') {
+                base = c + 1;
+            }
+        }
+        return base;
+    }
+};
+
+// Every log call site that has run, with a bit each saying whether it prints.
+//
+// Sites are switched on and off from the console by file or file:line; a rule also
+// applies to matching sites that haven't run yet. The check on the logging path is
+// two relaxed loads once the site has its number.
+class LogSites {
+public:
+    static constexpr size_t kMaxSites = 512;
+
+    static LogSites& Get();
+
+    bool IsEnabled(LogSite& site) {
+        uint32_t id = site.id.load(std::memory_order_acquire);
+        if (id == 0) {
+            id = Register(site);
+        }
+        return (enabled_[id / 64].load(std::memory_order_relaxed) >> (id % 64)) & 1;
+    }
+
+    // pattern is "all", "File.cpp" or "File.cpp:123"; returns how many known sites matched
+    size_t SetEnabled(std::string_view pattern, bool enabled);
+
+    // "[Function (File.cpp:123)]", built once when the site registered
+    const std::string& Location(const LogSite& site) const;
+
+    // One line per known site, for the console
+    std::vector<std::string> Describe() const;
+
+private:
+    struct Rule {
+        std::string pattern;
+        bool enabled;
+    };
+    struct Entry {
+        const LogSite* site = nullptr;
+        std::string location;
+    };
+
+    LogSites() = default;
+    uint32_t Register(LogSite& site);
+    static bool Matches(const LogSite& site, std::string_view pattern);
+    void SetBit(uint32_t id, bool enabled);
+
+    // Slots 1..kMaxSites; every site past that shares kOverflow, which is always on
+    static constexpr uint32_t kOverflow = kMaxSites + 1;
+    static constexpr size_t kWords = (kOverflow + 64) / 64;
+    std::atomic<uint64_t> enabled_[kWords] = {};
+
+    mutable std::mutex mutex_;
+    Entry entries_[kOverflow + 1];
+    uint32_t count_ = 0;
+    std::vector<Rule> rules_;       // applied in order to sites as they register
+};
@@ -2,13 +2,19 @@
 #include "Login.h"
 #include "Server.h"
 #include "Config.h"
+#include "AsyncExecutor.h"
+#include "Json.h"
+#include "StartupTimeline.h"
+#include "URL.h"
 #include <thread>
 #include <Windows.h>
 #include <shellapi.h>
-#include <httplib.h>
 
-Login::Login(std::shared_ptr<GameWrapper> gameWrapper)
+Login::Login(std::shared_ptr<GameWrapper> gameWrapper, std::shared_ptr<HelixClient> helix)
     : gameWrapper_(gameWrapper)
+    , helix_(helix)
+    , tokenStore_(gameWrapper->GetDataFolder() / "TwitchChatQuickChat" / "token.bin")
+    , userIds_(gameWrapper->GetDataFolder() / "TwitchChatQuickChat" / "user_ids.txt")
 {
 }
 
@@ -40,47 +46,100 @@ void Login::StartOAuthFlow(std::function<void(bool success)> onComplete) {
     ShellExecuteA(nullptr, "open", authUrl.c_str(), nullptr, nullptr, SW_SHOWNORMAL);
 }
 
+void Login::RestoreSession(std::function<void(bool success)> onComplete) {
+    isRestoring_ = true;
+
+    AsyncExecutor::Get().Submit([this, onComplete]() {
+        std::string token = tokenStore_.Load();
+        if (!token.empty()) {
+            StartupTimeline::Get().Mark(StartupTimeline::TokenReady);
+        }
+
+        // Besides confirming the token, validate returns the login and user id,
+        // so there's no /helix/users call afterwards
+        std::string login;
+        std::string userId;
+        bool valid = false;
+        if (!token.empty()) {
+            httplib::SSLClient client("id.twitch.tv");
+            client.set_connection_timeout(10);
+            client.set_read_timeout(10);
+            httplib::Result result(nullptr, httplib::Error::Canceled);
+            {
+                AsyncExecutor::CancelScope cancel([&client]() { client.stop(); });
+                if (!AsyncExecutor::IsCancellationRequested()) {
+                    result = client.Get("/oauth2/validate", { {"Authorization", "OAuth " + token} });
+                }
+            }
+
+            if (result && result->status == 200) {
+                Json::Value body = Json::Parse(result->body);
+                // A token issued to another client id would be refused by Helix
+                valid = Json::Find(body, "client_id").Equals(Config::TWITCH_CLIENT_ID);
+                login = Json::Find(body, "login").ToString();
+                userId = Json::Find(body, "user_id").ToString();
+            } else if (result && result->status == 401) {
+                // Expired or revoked; don't try it again next launch
+                tokenStore_.Clear();
+            }
+        }
+        valid = valid && !login.empty() && !userId.empty();
+
+        if (AsyncExecutor::IsCancellationRequested()) {
+            return;
+        }
+
+        gameWrapper_->Execute([this, valid, token, login, userId, onComplete](GameWrapper* gw) {
+            isRestoring_ = false;
+            // The user logged in by hand while this was running
+            if (isLoggedIn_ || isAuthenticating_) {
+                return;
+            }
+
+            if (valid) {
+                accessToken_ = token;
+                helix_->SetAccessToken(token);
+                username_ = login;
+                userId_ = userId;
+                isLoggedIn_ = true;
+                StartupTimeline::Get().Mark(StartupTimeline::IdentityResolved);
+            }
+
+            if (onComplete) onComplete(valid);
+        });
+    });
+}
+
 void Login::OnTokenReceived(const std::string& accessToken, std::function<void(bool success)> onComplete) {
     accessToken_ = accessToken;
+    helix_->SetAccessToken(accessToken);
+    StartupTimeline::Get().Mark(StartupTimeline::TokenReady);
 
     // Fetch username and user ID from Twitch API
-    std::thread([this, onComplete]() {
-        httplib::SSLClient client("api.twitch.tv");
-        client.set_connection_timeout(10);
-        client.set_read_timeout(10);
-
-        httplib::Headers headers = {
-            {"Authorization", "Bearer " + accessToken_},
-            {"Client-Id", Config::TWITCH_CLIENT_ID}
-        };
+    AsyncExecutor::Get().Submit([this, accessToken, onComplete]() {
+        // Next launch can skip the browser (see RestoreSession)
+        tokenStore_.Save(accessToken);
 
-        auto result = client.Get("/helix/users", headers);
+        auto result = helix_->Get("/helix/users");
 
         std::string fetchedUsername = "unknown";
         std::string fetchedId;
 
         if (result && result->status == 200) {
-            std::string body = result->body;
-
-            // Parse login
-            size_t loginPos = body.find("\"login\":\"");
-            if (loginPos != std::string::npos) {
-                size_t start = loginPos + 9;
-                size_t end = body.find('"', start);
-                if (end != std::string::npos) {
-                    fetchedUsername = body.substr(start, end - start);
+            // {"data":[{"id":"...","login":"...",...}]} for the token's own user
+            Json::ForEachElement(Json::Find(Json::Parse(result->body), "data"), [&](const Json::Value& user) {
+                std::string login = Json::Find(user, "login").ToString();
+                if (!login.empty()) {
+                    fetchedUsername = login;
                 }
-            }
+                fetchedId = Json::Find(user, "id").ToString();
+                return false;
+            });
+        }
 
-            // Parse user ID
-            size_t idPos = body.find("\"id\":\"");
-            if (idPos != std::string::npos) {
-                size_t start = idPos + 6;
-                size_t end = body.find('"', start);
-                if (end != std::string::npos) {
-                    fetchedId = body.substr(start, end - start);
-                }
-            }
+        // The plugin may be unloading; don't post back into it
+        if (AsyncExecutor::IsCancellationRequested()) {
+            return;
         }
 
         gameWrapper_->Execute([this, fetchedUsername, fetchedId, onComplete](GameWrapper* gw) {
@@ -88,40 +147,86 @@ void Login::OnTokenReceived(const std::string& accessToken, std::function<void(b
             userId_ = fetchedId;
             isLoggedIn_ = true;
             isAuthenticating_ = false;
+            StartupTimeline::Get().Mark(StartupTimeline::IdentityResolved);
 
             if (onComplete) onComplete(true);
         });
-    }).detach();
+    });
 }
 
-void Login::FetchBroadcasterId(const std::string& channel, std::function<void(const std::string&)> callback) {
-    std::thread([this, channel, callback]() {
-        httplib::SSLClient client("api.twitch.tv");
-        client.set_connection_timeout(10);
-        client.set_read_timeout(10);
+void Login::FetchUserIds(const std::vector<std::string>& logins, std::function<void(const UserIds&)> callback) {
+    UserIds ids;
+    std::vector<std::string> missing;
+    std::vector<std::string> stale;
+    for (const std::string& login : logins) {
+        UserIdCache::Lookup cached = userIds_.Find(login);
+        if (cached.id.empty()) {
+            missing.push_back(login);
+        } else {
+            ids[login] = cached.id;
+            if (cached.stale) {
+                stale.push_back(login);
+            }
+        }
+    }
+
+    // Everything known: answer right away and refresh old entries in the background
+    if (missing.empty()) {
+        callback(ids);
+        if (!stale.empty()) {
+            AsyncExecutor::Get().Submit([this, stale]() {
+                LookupUserIds(stale, HelixPriority::Background);
+            });
+        }
+        return;
+    }
 
-        httplib::Headers headers = {
-            {"Authorization", "Bearer " + accessToken_},
-            {"Client-Id", Config::TWITCH_CLIENT_ID}
-        };
+    // Refresh stale entries in the same request
+    missing.insert(missing.end(), stale.begin(), stale.end());
 
-        auto result = client.Get(("/helix/users?login=" + channel).c_str(), headers);
+    AsyncExecutor::Get().Submit([this, ids, missing, callback]() mutable {
+        for (auto& [login, id] : LookupUserIds(missing, HelixPriority::Normal)) {
+            ids[login] = id;
+        }
 
-        std::string odId;
-        if (result && result->status == 200) {
-            std::string body = result->body;
-            size_t idPos = body.find("\"id\":\"");
-            if (idPos != std::string::npos) {
-                size_t start = idPos + 6;
-                size_t end = body.find('"', start);
-                if (end != std::string::npos) {
-                    odId = body.substr(start, end - start);
-                }
-            }
+        if (AsyncExecutor::IsCancellationRequested()) {
+            return;
         }
 
-        gameWrapper_->Execute([callback, odId](GameWrapper* gw) {
-            callback(odId);
+        gameWrapper_->Execute([callback, ids](GameWrapper* gw) {
+            callback(ids);
+        });
+    });
+}
+
+Login::UserIds Login::LookupUserIds(const std::vector<std::string>& logins, HelixPriority priority) {
+    UserIds ids;
+
+    // /helix/users takes repeated login= parameters
+    std::string path = "/helix/users";
+    for (size_t i = 0; i < logins.size() && i < kMaxLoginsPerLookup; ++i) {
+        path += (i == 0 ? "?login=" : "&login=") + URL::encode(logins[i]);
+    }
+
+    auto result = helix_->Get(path, priority);
+    if (result && result->status == 200) {
+        Json::Value data = Json::Find(Json::Parse(result->body), "data");
+        bool complete = Json::ForEachElement(data, [&ids](const Json::Value& user) {
+            std::string login = Json::Find(user, "login").ToString();
+            std::string id = Json::Find(user, "id").ToString();
+            if (!login.empty() && !id.empty()) {
+                ids[login] = id;
+            }
+            return true;
         });
-    }).detach();
-}
\ No newline at end of file
+        if (!complete) {
+            LOG("Malformed user lookup response; using the {} ids read before the error", ids.size());
+        }
+    }
+
+    for (const auto& [login, id] : ids) {
+        userIds_.Store(login, id);
+    }
+    userIds_.Save();
+    return ids;
+}
@@ -1,33 +1,55 @@
 #pragma once
 
 #include "bakkesmod/plugin/bakkesmodplugin.h"
+#include "HelixClient.h"
+#include "TokenStore.h"
+#include "UserIdCache.h"
 #include <string>
 #include <memory>
 #include <functional>
+#include <vector>
+#include <unordered_map>
 
 class Login
 {
 public:
-    Login(std::shared_ptr<GameWrapper> gameWrapper);
+    Login(std::shared_ptr<GameWrapper> gameWrapper, std::shared_ptr<HelixClient> helix);
 
     void StartOAuthFlow(std::function<void(bool success)> onComplete);
-    void FetchBroadcasterId(const std::string& channel, std::function<void(const std::string&)> callback);
+    // Logs in with the token saved by an earlier session, if Twitch still accepts it.
+    // Costs one request to id.twitch.tv instead of the browser flow.
+    void RestoreSession(std::function<void(bool success)> onComplete);
+    // Resolves lowercase logins to user ids. Cached ids are returned without a request
+    // (and refreshed in the background when old); the rest are looked up in one
+    // /helix/users call of up to kMaxLoginsPerLookup logins. The callback runs on the
+    // game thread, inline when everything was cached; unknown logins are missing.
+    using UserIds = std::unordered_map<std::string, std::string>;
+    static constexpr size_t kMaxLoginsPerLookup = 100;
+    void FetchUserIds(const std::vector<std::string>& logins, std::function<void(const UserIds&)> callback);
 
     // Getters for auth state
     bool IsLoggedIn() const { return isLoggedIn_; }
     bool IsAuthenticating() const { return isAuthenticating_; }
+    bool IsRestoring() const { return isRestoring_; }
+    bool HasSavedSession() const { return tokenStore_.Exists(); }
     const std::string& GetAccessToken() const { return accessToken_; }
     const std::string& GetUsername() const { return username_; }
     const std::string& GetUserId() const { return userId_; }
 
 private:
+    // Worker thread: one /helix/users request, results go into the cache
+    UserIds LookupUserIds(const std::vector<std::string>& logins, HelixPriority priority);
     void OnTokenReceived(const std::string& accessToken, std::function<void(bool success)> onComplete);
 
     std::shared_ptr<GameWrapper> gameWrapper_;
+    std::shared_ptr<HelixClient> helix_;
+    TokenStore tokenStore_;
+    UserIdCache userIds_;
 
     std::string accessToken_;
     std::string username_;
     std::string userId_;
     bool isLoggedIn_ = false;
     bool isAuthenticating_ = false;
+    bool isRestoring_ = false;
 };
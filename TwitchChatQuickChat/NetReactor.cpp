@@ -0,0 +1,362 @@
+#include "pch.h"
+#include "NetReactor.h"
+#include "Trace.h"
+#include <algorithm>
+
+#ifdef NET_REACTOR_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#define closesocket close
+#endif
+
+NetReactor& NetReactor::Get() {
+    static NetReactor instance;
+    return instance;
+}
+
+NetReactor::~NetReactor() {
+    Stop();
+}
+
+bool NetReactor::IsReactorThread() const {
+    return std::this_thread::get_id() == thread_.get_id();
+}
+
+void NetReactor::EnsureRunning() {
+    if (running_) {
+        return;
+    }
+
+#ifdef NET_REACTOR_EPOLL
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+#else
+#ifdef _WIN32
+    // Posts can start the reactor before any connection has initialized Winsock
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+    // A datagram socket talking to itself, so Wake() can interrupt poll/WSAPoll
+    wakeSocket_ = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (wakeSocket_ == INVALID_SOCKET ||
+        bind(wakeSocket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        getsockname(wakeSocket_, reinterpret_cast<sockaddr*>(&address), &length) != 0 ||
+        connect(wakeSocket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        // Without it posts wait for the poll timeout, as they used to
+        if (wakeSocket_ != INVALID_SOCKET) {
+            closesocket(wakeSocket_);
+        }
+        wakeSocket_ = INVALID_SOCKET;
+    } else {
+#ifdef _WIN32
+        u_long nonBlocking = 1;
+        ioctlsocket(wakeSocket_, FIONBIO, &nonBlocking);
+#else
+        fcntl(wakeSocket_, F_SETFL, fcntl(wakeSocket_, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    }
+#endif
+
+    running_ = true;
+    thread_ = std::thread(&NetReactor::Run, this);
+}
+
+void NetReactor::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    Wake();
+
+    if (thread_.joinable()) {
+        if (IsReactorThread()) {
+            thread_.detach();
+        } else {
+            thread_.join();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    tasks_.clear();
+    timers_.clear();
+
+#ifdef NET_REACTOR_EPOLL
+    close(wakeFd_);
+    close(epollFd_);
+    wakeFd_ = -1;
+    epollFd_ = -1;
+#else
+    if (wakeSocket_ != INVALID_SOCKET) {
+        closesocket(wakeSocket_);
+        wakeSocket_ = INVALID_SOCKET;
+    }
+#ifdef _WIN32
+    WSACleanup();
+#endif
+#endif
+}
+
+void NetReactor::Add(SOCKET socket, Handler* handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    EnsureRunning();
+
+    entries_.push_back({ socket, handler, true, false });
+
+#ifdef NET_REACTOR_EPOLL
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.fd = socket;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, socket, &ev);
+#endif
+
+    Wake();
+}
+
+void NetReactor::Remove(Handler* handler) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto it = std::find_if(entries_.begin(), entries_.end(),
+        [handler](const Entry& e) { return e.handler == handler; });
+    if (it != entries_.end()) {
+#ifdef NET_REACTOR_EPOLL
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, it->socket, nullptr);
+#endif
+        entries_.erase(it);
+    }
+
+    // Callbacks run unlocked; wait for one in progress so the handler can be destroyed.
+    // On the reactor thread that callback is our caller, and it isn't called again.
+    if (!IsReactorThread()) {
+        callbackDone_.wait(lock, [this, handler]() { return dispatching_ != handler; });
+    }
+}
+
+void NetReactor::Post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        EnsureRunning();
+        tasks_.push_back(std::move(task));
+    }
+    Wake();
+}
+
+void NetReactor::PostAfter(std::chrono::milliseconds delay, std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        EnsureRunning();
+        timers_.push_back({ Clock::now() + delay, std::move(task) });
+    }
+    // The wait may be longer than the delay
+    Wake();
+}
+
+void NetReactor::Wake() {
+#ifdef NET_REACTOR_EPOLL
+    if (wakeFd_ >= 0) {
+        uint64_t one = 1;
+        [[maybe_unused]] auto written = write(wakeFd_, &one, sizeof(one));
+    }
+#else
+    if (wakeSocket_ != INVALID_SOCKET) {
+        char byte = 0;
+        send(wakeSocket_, &byte, 1, 0);
+    }
+#endif
+}
+
+void NetReactor::DrainWake() {
+#ifdef NET_REACTOR_EPOLL
+    uint64_t value;
+    [[maybe_unused]] auto consumed = read(wakeFd_, &value, sizeof(value));
+#else
+    char buffer[64];
+    while (recv(wakeSocket_, buffer, sizeof(buffer), 0) > 0) {
+    }
+#endif
+}
+
+void NetReactor::UpdateWriteInterest() {
+#ifdef NET_REACTOR_EPOLL
+    for (Entry& e : entries_) {
+        bool wants = e.handler->WantsWrite();
+        if (wants != e.writeArmed) {
+            epoll_event ev = {};
+            ev.events = EPOLLIN | EPOLLRDHUP | (wants ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+            ev.data.fd = e.socket;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, e.socket, &ev);
+            e.writeArmed = wants;
+        }
+    }
+#endif
+}
+
+void NetReactor::Invoke(std::unique_lock<std::mutex>& lock, Handler* handler, Event event, Clock::time_point now) {
+    // Look the handler up again: an earlier callback may have removed it
+    auto it = std::find_if(entries_.begin(), entries_.end(),
+        [handler](const Entry& e) { return e.handler == handler; });
+    if (it == entries_.end()) {
+        return;
+    }
+    if (event != Event::Tick) {
+        it->pendingRead = false;
+    }
+
+    dispatching_ = handler;
+    lock.unlock();
+    switch (event) {
+    case Event::Readable: handler->OnReadable(); break;
+    case Event::Writable: handler->OnWritable(); break;
+    case Event::Tick: handler->OnTick(now); break;
+    }
+    lock.lock();
+    dispatching_ = nullptr;
+    callbackDone_.notify_all();
+}
+
+void NetReactor::Run() {
+    Trace::SetThreadName("Network");
+    // Sockets with something to do; writable ones flush before they read
+    std::vector<std::pair<SOCKET, bool>> ready;
+    std::vector<std::pair<Handler*, Event>> callbacks;
+    Clock::time_point lastTick = Clock::now();
+
+#ifdef NET_REACTOR_EPOLL
+    epoll_event events[64];
+#else
+    std::vector<pollfd> fds;
+#endif
+
+    while (running_) {
+        ready.clear();
+
+#ifdef NET_REACTOR_EPOLL
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            UpdateWriteInterest();
+        }
+        int count = epoll_wait(epollFd_, events, 64, kPollIntervalMs);
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == wakeFd_) {
+                DrainWake();
+                continue;
+            }
+            ready.push_back({ static_cast<SOCKET>(events[i].data.fd), (events[i].events & EPOLLOUT) != 0 });
+        }
+#else
+        fds.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (wakeSocket_ != INVALID_SOCKET) {
+                pollfd wake = {};
+                wake.fd = wakeSocket_;
+                wake.events = POLLIN;
+                fds.push_back(wake);
+            }
+            for (const Entry& e : entries_) {
+                pollfd pfd = {};
+                pfd.fd = e.socket;
+                pfd.events = POLLIN | (e.handler->WantsWrite() ? POLLOUT : 0);
+                fds.push_back(pfd);
+            }
+        }
+
+        if (fds.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kPollIntervalMs));
+        } else {
+#ifdef _WIN32
+            int count = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), kPollIntervalMs);
+#else
+            int count = poll(fds.data(), fds.size(), kPollIntervalMs);
+#endif
+            size_t first = wakeSocket_ != INVALID_SOCKET ? 1 : 0;
+            if (count > 0 && first == 1 && fds[0].revents != 0) {
+                DrainWake();
+            }
+            for (size_t i = first; count > 0 && i < fds.size(); ++i) {
+                if (fds[i].revents != 0) {
+                    ready.push_back({ fds[i].fd, (fds[i].revents & POLLOUT) != 0 });
+                }
+            }
+        }
+#endif
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_) {
+            break;
+        }
+
+        // Sockets that already had data buffered when they were registered
+        for (const Entry& e : entries_) {
+            if (e.pendingRead && std::none_of(ready.begin(), ready.end(),
+                    [&e](const std::pair<SOCKET, bool>& r) { return r.first == e.socket; })) {
+                ready.push_back({ e.socket, false });
+            }
+        }
+
+        callbacks.clear();
+        for (const auto& [socket, writable] : ready) {
+            for (const Entry& e : entries_) {
+                if (e.socket == socket) {
+                    callbacks.push_back({ e.handler, writable ? Event::Writable : Event::Readable });
+                    break;
+                }
+            }
+        }
+        Clock::time_point now = Clock::now();
+        for (const auto& [handler, event] : callbacks) {
+            Invoke(lock, handler, event, now);
+        }
+
+        std::vector<std::function<void()>> tasks;
+        tasks.swap(tasks_);
+
+        // Timers that are due; they may schedule new ones
+        now = Clock::now();
+        std::vector<Timer> due;
+        for (auto it = timers_.begin(); it != timers_.end();) {
+            if (it->due <= now) {
+                due.push_back(std::move(*it));
+                it = timers_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        lock.unlock();
+        for (auto& task : tasks) {
+            task();
+        }
+        for (auto& timer : due) {
+            timer.task();
+        }
+        lock.lock();
+
+        if (now - lastTick >= std::chrono::milliseconds(kTickIntervalMs)) {
+            lastTick = now;
+            // Copy first; ticks may add or remove connections
+            callbacks.clear();
+            for (const Entry& e : entries_) {
+                callbacks.push_back({ e.handler, Event::Tick });
+            }
+            for (const auto& [handler, event] : callbacks) {
+                Invoke(lock, handler, event, now);
+            }
+        }
+    }
+}
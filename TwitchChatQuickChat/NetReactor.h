@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "WebSocketTransport.h"
+
+// epoll on Linux; defining NET_REACTOR_POLL there builds the portable poll() loop
+// instead, so the tests can run both
+#if defined(__linux__) && !defined(NET_REACTOR_POLL)
+#define NET_REACTOR_EPOLL
+#endif
+
+// One background thread that waits on every open Twitch socket at once and
+// dispatches readiness to the owning connection, so the plugin's thread count
+// no longer grows with the number of connections.
+//
+// Uses epoll on Linux and poll/WSAPoll everywhere else, with an eventfd or a
+// loopback UDP socket to wake the wait when work is posted. Sockets are expected
+// to be non-blocking; handlers must drain them without waiting. Callbacks, tasks
+// and timers run without the reactor's lock held.
+class NetReactor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+        // The socket has data (or an error) waiting
+        virtual void OnReadable() = 0;
+        // Checked before every wait; true asks for OnWritable() when the socket can take more
+        virtual bool WantsWrite() { return false; }
+        virtual void OnWritable() {}
+        // Called roughly every kTickIntervalMs from the reactor thread
+        virtual void OnTick(Clock::time_point) {}
+    };
+
+    static NetReactor& Get();
+
+    // Registers a socket. The handler also gets one OnReadable() right away in
+    // case data was buffered before registration (e.g. during the handshake).
+    void Add(SOCKET socket, Handler* handler);
+    // Unregisters a handler. When called off the reactor thread this waits for
+    // any callback in progress, so the handler can be destroyed afterwards.
+    void Remove(Handler* handler);
+    // Runs a task on the reactor thread
+    void Post(std::function<void()> task);
+    // Runs a task on the reactor thread once delay has passed (to tick resolution)
+    void PostAfter(std::chrono::milliseconds delay, std::function<void()> task);
+    // Stops the thread; used on plugin unload
+    void Stop();
+
+    bool IsReactorThread() const;
+
+    static constexpr int kPollIntervalMs = 50;
+    static constexpr int kTickIntervalMs = 100;
+
+private:
+    NetReactor() = default;
+    ~NetReactor();
+
+    struct Entry {
+        SOCKET socket;
+        Handler* handler;
+        bool pendingRead;
+        bool writeArmed;    // EPOLLOUT registered
+    };
+
+    void EnsureRunning();
+    void Run();
+    void Wake();
+    // Asks each handler whether it has output waiting (epoll needs the interest updated)
+    void UpdateWriteInterest();
+    void DrainWake();
+    enum class Event { Readable, Writable, Tick };
+    // Calls the handler if it is still registered, with the lock released
+    void Invoke(std::unique_lock<std::mutex>& lock, Handler* handler, Event event, Clock::time_point now);
+
+    std::mutex mutex_;
+    // The handler whose callback is running; Remove() waits on callbackDone_ for it
+    Handler* dispatching_ = nullptr;
+    std::condition_variable callbackDone_;
+    std::vector<Entry> entries_;
+    std::vector<std::function<void()>> tasks_;
+
+    struct Timer {
+        Clock::time_point due;
+        std::function<void()> task;
+    };
+    std::vector<Timer> timers_;
+
+    std::thread thread_;
+    std::atomic<bool> running_{ false };
+
+#ifdef NET_REACTOR_EPOLL
+    int epollFd_ = -1;
+    int wakeFd_ = -1;
+#else
+    // Bound to loopback and connected to itself; Wake() sends it a byte
+    SOCKET wakeSocket_ = INVALID_SOCKET;
+#endif
+};
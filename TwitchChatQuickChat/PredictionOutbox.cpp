@@ -0,0 +1,250 @@
+#include "pch.h"
+#include "PredictionOutbox.h"
+#include "FilePath.h"
+#include <fstream>
+#include <sstream>
+#include <iterator>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+PredictionOutbox::PredictionOutbox(std::filesystem::path file)
+    : file_(std::move(file))
+{
+    writer_ = std::thread(&PredictionOutbox::WriterLoop, this);
+}
+
+PredictionOutbox::~PredictionOutbox()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void PredictionOutbox::Created(const std::string& broadcasterId, const std::string& predictionId) {
+    Record({ Action::Created, broadcasterId, predictionId, "" });
+}
+
+void PredictionOutbox::Resolving(const std::string& broadcasterId, const std::string& predictionId, const std::string& outcomeId) {
+    Record({ Action::Resolve, broadcasterId, predictionId, outcomeId });
+}
+
+void PredictionOutbox::Cancelling(const std::string& broadcasterId, const std::string& predictionId) {
+    Record({ Action::Cancel, broadcasterId, predictionId, "" });
+}
+
+void PredictionOutbox::Finished(const std::string& predictionId) {
+    Record({ Action::Done, "", predictionId, "" });
+}
+
+void PredictionOutbox::Record(Entry entry) {
+    if (entry.predictionId.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(entry));
+        recorded_++;
+    }
+    cv_.notify_all();
+}
+
+std::vector<PredictionOutbox::Entry> PredictionOutbox::TakeUnfinished(const std::string& broadcasterId) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return loaded_; });
+    if (replayed_) {
+        return {};
+    }
+    replayed_ = true;
+
+    // Other accounts' entries stay in the journal until they log in again
+    std::vector<Entry> entries;
+    for (const Entry& entry : unfinished_) {
+        if (entry.broadcasterId == broadcasterId) {
+            entries.push_back(entry);
+        }
+    }
+    return entries;
+}
+
+void PredictionOutbox::Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = recorded_;
+    cv_.wait(lock, [this, target]() { return written_ >= target; });
+}
+
+void PredictionOutbox::WriterLoop() {
+    Load();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    loaded_ = true;
+    for (const auto& [id, entry] : live_) {
+        unfinished_.push_back(entry);
+    }
+    cv_.notify_all();
+
+    while (true) {
+        cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (queue_.empty() && stop_) {
+            break;
+        }
+
+        // Give related records (e.g. resolve, then done) a moment to share one fsync
+        if (!stop_) {
+            cv_.wait_for(lock, kBatchWindow, [this]() { return stop_; });
+        }
+
+        std::vector<Entry> batch;
+        batch.swap(queue_);
+        lock.unlock();
+
+        std::string lines;
+        for (const Entry& entry : batch) {
+            lines += Serialize(entry);
+        }
+        if (out_ || OpenForAppend()) {
+            std::fwrite(lines.data(), 1, lines.size(), out_);
+            Sync(out_);
+            linesInFile_ += batch.size();
+        }
+
+        lock.lock();
+        for (const Entry& entry : batch) {
+            Apply(entry);
+        }
+
+        if (linesInFile_ >= kCompactAfterLines && linesInFile_ > live_.size() * 2) {
+            std::vector<Entry> live;
+            for (const auto& [id, entry] : live_) {
+                live.push_back(entry);
+            }
+            // Records arriving meanwhile queue up and land in the new file
+            lock.unlock();
+            Compact(live);
+            lock.lock();
+        }
+
+        written_ += batch.size();
+        cv_.notify_all();
+    }
+
+    if (out_) {
+        std::fclose(out_);
+        out_ = nullptr;
+    }
+}
+
+void PredictionOutbox::Load() {
+    std::ifstream in(file_, std::ios::binary);
+    std::string journal((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    size_t start = 0;
+    for (size_t end = journal.find('\n'); end != std::string::npos; start = end + 1, end = journal.find('\n', start)) {
+        // "<action> <prediction> [<broadcaster> [<outcome>]]"
+        std::istringstream fields(journal.substr(start, end - start));
+        std::string action;
+        Entry entry;
+        if (!(fields >> action >> entry.predictionId) || action.size() != 1) {
+            continue;
+        }
+        entry.action = static_cast<Action>(action[0]);
+        fields >> entry.broadcasterId >> entry.outcomeId;
+
+        bool valid = entry.action == Action::Done ||
+            (!entry.broadcasterId.empty() &&
+             (entry.action == Action::Created || entry.action == Action::Cancel ||
+              (entry.action == Action::Resolve && !entry.outcomeId.empty())));
+        if (valid) {
+            Apply(entry);
+            linesInFile_++;
+        }
+    }
+
+    // A torn last line (the write was cut short) is dropped. Cut it off the file too,
+    // or the next appended record would run on from it and read back as garbage.
+    if (start < journal.size()) {
+        std::error_code error;
+        std::filesystem::resize_file(file_, start, error);
+    }
+}
+
+bool PredictionOutbox::OpenForAppend() {
+    std::error_code error;
+    std::filesystem::create_directories(file_.parent_path(), error);
+    out_ = FilePath::Open(file_, "ab");
+    return out_ != nullptr;
+}
+
+void PredictionOutbox::Apply(const Entry& entry) {
+    if (entry.action == Action::Done) {
+        live_.erase(entry.predictionId);
+    } else {
+        live_[entry.predictionId] = entry;
+    }
+}
+
+void PredictionOutbox::Compact(const std::vector<Entry>& live) {
+    // Write the live records to a new file, make it durable, then swap it in
+    std::filesystem::path temp = file_;
+    temp += ".tmp";
+    FILE* compacted = FilePath::Open(temp, "wb");
+    if (!compacted) {
+        return;
+    }
+
+    std::string lines;
+    for (const Entry& entry : live) {
+        lines += Serialize(entry);
+    }
+    bool ok = std::fwrite(lines.data(), 1, lines.size(), compacted) == lines.size() && Sync(compacted);
+    std::fclose(compacted);
+
+    std::error_code error;
+    if (!ok) {
+        std::filesystem::remove(temp, error);
+        return;
+    }
+
+    if (out_) {
+        std::fclose(out_);
+        out_ = nullptr;
+    }
+    std::filesystem::rename(temp, file_, error);
+    if (!error) {
+        linesInFile_ = live.size();
+    }
+    OpenForAppend();
+}
+
+std::string PredictionOutbox::Serialize(const Entry& entry) {
+    std::string line(1, static_cast<char>(entry.action));
+    line += ' ' + entry.predictionId;
+    if (entry.action != Action::Done) {
+        line += ' ' + entry.broadcasterId;
+        if (entry.action == Action::Resolve) {
+            line += ' ' + entry.outcomeId;
+        }
+    }
+    line += '\n';
+    return line;
+}
+
+bool PredictionOutbox::Sync(FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+// Journal of the prediction actions that still have to reach Twitch, so a crash or
+// unload between creating a prediction and resolving it doesn't leave it open on
+// stream.
+//
+// Each record is one appended line, written by a background thread in batches and
+// fsync'd, so callers (including the game thread) never wait for the disk. Finished
+// predictions are dropped by rewriting the file once it's mostly dead records. On the
+// next start TakeUnfinished() hands back what never completed: pending resolves and
+// cancels are sent again, and predictions that were still open get cancelled.
+class PredictionOutbox
+{
+public:
+    enum class Action : char {
+        Created = 'C',      // open on Twitch, nothing sent yet
+        Resolve = 'R',
+        Cancel = 'X',
+        Done = 'D',         // Twitch accepted it, or it can never succeed
+    };
+
+    struct Entry {
+        Action action = Action::Done;
+        std::string broadcasterId;
+        std::string predictionId;
+        std::string outcomeId;      // Resolve only
+    };
+
+    static constexpr auto kBatchWindow = std::chrono::milliseconds(20);
+    static constexpr size_t kCompactAfterLines = 64;
+
+    explicit PredictionOutbox(std::filesystem::path file);
+    // Writes out anything still queued
+    ~PredictionOutbox();
+
+    PredictionOutbox(const PredictionOutbox&) = delete;
+    PredictionOutbox& operator=(const PredictionOutbox&) = delete;
+
+    // Any thread; returns right away
+    void Created(const std::string& broadcasterId, const std::string& predictionId);
+    void Resolving(const std::string& broadcasterId, const std::string& predictionId, const std::string& outcomeId);
+    void Cancelling(const std::string& broadcasterId, const std::string& predictionId);
+    void Finished(const std::string& predictionId);
+
+    // What a previous session left unfinished for this broadcaster. Only returns
+    // entries once per outbox, and waits for the journal to be read; call off the
+    // game thread.
+    std::vector<Entry> TakeUnfinished(const std::string& broadcasterId);
+
+    // Blocks until everything recorded so far is on disk
+    void Flush();
+
+private:
+    void Record(Entry entry);
+    void WriterLoop();
+    void Load();
+    bool OpenForAppend();
+    void Apply(const Entry& entry);
+    void Compact(const std::vector<Entry>& live);
+    static std::string Serialize(const Entry& entry);
+    static bool Sync(FILE* file);
+
+    std::filesystem::path file_;
+    FILE* out_ = nullptr;               // writer thread only
+    size_t linesInFile_ = 0;            // writer thread only, records in the file now
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Entry> queue_;
+    uint64_t recorded_ = 0;
+    uint64_t written_ = 0;
+    bool loaded_ = false;
+    bool stop_ = false;
+    bool replayed_ = false;
+    // Latest unfinished action per prediction id
+    std::unordered_map<std::string, Entry> live_;
+    // Snapshot of live_ right after loading, for TakeUnfinished()
+    std::vector<Entry> unfinished_;
+
+    std::thread writer_;
+};
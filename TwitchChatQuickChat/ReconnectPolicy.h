@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <algorithm>
+
+// Exponential backoff with jitter for reconnect attempts.
+//
+// Each delay is half the current step plus a random share of the other half, so
+// clients that dropped together don't all come back in the same instant.
+class ReconnectBackoff {
+public:
+    explicit ReconnectBackoff(std::chrono::milliseconds base = std::chrono::milliseconds(1000),
+                              std::chrono::milliseconds cap = std::chrono::milliseconds(60000))
+        : base_(base), cap_(cap), rng_(std::random_device{}()) {
+    }
+
+    std::chrono::milliseconds Next() {
+        int64_t step = base_.count() << (std::min)(attempts_, 16);
+        step = (std::min)(step, static_cast<int64_t>(cap_.count()));
+        ++attempts_;
+
+        std::uniform_int_distribution<int64_t> jitter(0, step / 2);
+        return std::chrono::milliseconds(step / 2 + jitter(rng_));
+    }
+
+    void Reset() { attempts_ = 0; }
+    int Attempts() const { return attempts_; }
+
+private:
+    std::chrono::milliseconds base_;
+    std::chrono::milliseconds cap_;
+    int attempts_ = 0;
+    std::mt19937 rng_;
+};
+
+// Counters for a connection that reconnects on its own, readable from any thread
+class ReconnectStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot {
+        uint64_t drops = 0;             // connections lost or found stalled
+        uint64_t stalls = 0;            // of which detected by the watchdog
+        uint64_t reconnects = 0;        // successful recoveries
+        int64_t lastRecoveryMs = -1;    // drop to usable again, -1 if never recovered
+        int64_t maxRecoveryMs = -1;
+        bool down = false;
+    };
+
+    void OnDropped(bool stalled) {
+        drops_.fetch_add(1, std::memory_order_relaxed);
+        if (stalled) {
+            stalls_.fetch_add(1, std::memory_order_relaxed);
+        }
+        // Keep the first drop time if several happen before recovery
+        int64_t expected = 0;
+        droppedAt_.compare_exchange_strong(expected, Now(), std::memory_order_relaxed);
+    }
+
+    void OnRecovered() {
+        int64_t droppedAt = droppedAt_.exchange(0, std::memory_order_relaxed);
+        if (droppedAt == 0) {
+            return;
+        }
+
+        int64_t recoveryMs = (Now() - droppedAt) / 1000;
+        reconnects_.fetch_add(1, std::memory_order_relaxed);
+        lastRecoveryMs_.store(recoveryMs, std::memory_order_relaxed);
+        int64_t max = maxRecoveryMs_.load(std::memory_order_relaxed);
+        while (recoveryMs > max && !maxRecoveryMs_.compare_exchange_weak(max, recoveryMs, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Stop counting an outage that ended because the connection was closed on purpose
+    void Clear() { droppedAt_.store(0, std::memory_order_relaxed); }
+
+    Snapshot Get() const {
+        Snapshot snapshot;
+        snapshot.drops = drops_.load(std::memory_order_relaxed);
+        snapshot.stalls = stalls_.load(std::memory_order_relaxed);
+        snapshot.reconnects = reconnects_.load(std::memory_order_relaxed);
+        snapshot.lastRecoveryMs = lastRecoveryMs_.load(std::memory_order_relaxed);
+        snapshot.maxRecoveryMs = maxRecoveryMs_.load(std::memory_order_relaxed);
+        snapshot.down = droppedAt_.load(std::memory_order_relaxed) != 0;
+        return snapshot;
+    }
+
+private:
+    // Microseconds since the clock's epoch; 0 means "not down"
+    static int64_t Now() {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+        return us == 0 ? 1 : us;
+    }
+
+    std::atomic<uint64_t> drops_{ 0 };
+    std::atomic<uint64_t> stalls_{ 0 };
+    std::atomic<uint64_t> reconnects_{ 0 };
+    std::atomic<int64_t> lastRecoveryMs_{ -1 };
+    std::atomic<int64_t> maxRecoveryMs_{ -1 };
+    std::atomic<int64_t> droppedAt_{ 0 };
+};
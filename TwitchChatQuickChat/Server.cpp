@@ -1,11 +1,13 @@
 #include "pch.h"
 #include "Server.h"
+#include "Trace.h"
 #include <thread>
 #include <mutex>
 #include <httplib.h>
 
 void startAuthServerAsync(int port, TokenResultCallback callback) {
     std::thread([port, callback = std::move(callback)]() {
+        Trace::SetThreadName("Auth server");
         httplib::Server svr;
         bool callbackFired = false;
         std::mutex mtx;
@@ -0,0 +1,133 @@
+#include "pch.h"
+#include "SessionCapture.h"
+#include "FilePath.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    size_t PutVarint(unsigned char* out, uint64_t value) {
+        size_t length = 0;
+        while (value >= 0x80) {
+            out[length++] = static_cast<unsigned char>(value | 0x80);
+            value >>= 7;
+        }
+        out[length++] = static_cast<unsigned char>(value);
+        return length;
+    }
+
+    bool GetVarint(std::string_view data, size_t& pos, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+            unsigned char byte = static_cast<unsigned char>(data[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+SessionCapture& SessionCapture::Get() {
+    static SessionCapture instance;
+    return instance;
+}
+
+bool SessionCapture::Start(const std::filesystem::path& path) {
+    Stop();
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_ = FilePath::Open(path, "wb");
+    if (!file_) {
+        return false;
+    }
+    std::setvbuf(file_, nullptr, _IOFBF, kFileBufferSize);
+
+    int64_t startedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    unsigned char header[16];
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    for (int i = 0; i < 8; ++i) {
+        header[8 + i] = static_cast<unsigned char>(static_cast<uint64_t>(startedUs) >> (8 * i));
+    }
+    std::fwrite(header, 1, sizeof(header), file_);
+
+    last_ = Clock::now();
+    written_ = 0;
+    capturing_.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+uint64_t SessionCapture::Stop() {
+    capturing_.store(false, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    return written_;
+}
+
+void SessionCapture::Append(Source source, Clock::time_point received, std::string_view payload) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) {
+        return;
+    }
+
+    // EventSub and IRC stamp their messages separately, so never go backwards
+    int64_t deltaUs = std::chrono::duration_cast<std::chrono::microseconds>(received - last_).count();
+    if (deltaUs > 0) {
+        last_ += std::chrono::microseconds(deltaUs);
+    } else {
+        deltaUs = 0;
+    }
+
+    unsigned char header[1 + 10 + 10];
+    size_t length = 0;
+    header[length++] = source;
+    length += PutVarint(header + length, static_cast<uint64_t>(deltaUs));
+    length += PutVarint(header + length, payload.size());
+
+    std::fwrite(header, 1, length, file_);
+    std::fwrite(payload.data(), 1, payload.size(), file_);
+    ++written_;
+}
+
+bool SessionCapture::Load(const std::filesystem::path& path, Capture& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    out.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    out.records.clear();
+
+    std::string_view data = out.data;
+    if (data.size() < 16 || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+        return false;
+    }
+    uint64_t started = 0;
+    for (int i = 0; i < 8; ++i) {
+        started |= static_cast<uint64_t>(static_cast<unsigned char>(data[8 + i])) << (8 * i);
+    }
+    out.startedUs = static_cast<int64_t>(started);
+
+    size_t pos = 16;
+    int64_t offsetUs = 0;
+    while (pos < data.size()) {
+        Source source = static_cast<Source>(data[pos++]);
+        uint64_t deltaUs = 0;
+        uint64_t length = 0;
+        if (!GetVarint(data, pos, deltaUs) || !GetVarint(data, pos, length) || length > data.size() - pos) {
+            break;
+        }
+        offsetUs += static_cast<int64_t>(deltaUs);
+        out.records.push_back({ source, offsetUs, data.substr(pos, static_cast<size_t>(length)) });
+        pos += static_cast<size_t>(length);
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Writes every WebSocket message the plugin receives, after TLS and framing, to a
+// file so a busy session can be replayed offline (see SessionReplay).
+//
+// File layout: an 8 byte magic, then the wall clock time capture started as
+// microseconds since the Unix epoch (8 bytes, little endian), then one record per
+// message:
+//   source      1 byte (Source)
+//   delta       varint, microseconds since the previous record (or since start)
+//   length      varint
+//   payload     length bytes
+// Chat messages are a few hundred bytes of JSON, so the record overhead is 3-6 bytes.
+class SessionCapture {
+public:
+    enum Source : uint8_t {
+        EventSub = 1,
+        Irc = 2,
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Record {
+        Source source;
+        int64_t offsetUs;           // since the capture started
+        std::string_view payload;   // points into Capture::data
+    };
+
+    // A capture file read back whole
+    struct Capture {
+        int64_t startedUs = 0;      // wall clock, microseconds since the Unix epoch
+        std::string data;
+        std::vector<Record> records;
+    };
+
+    static SessionCapture& Get();
+
+    bool Start(const std::filesystem::path& path);
+    // Returns how many messages were written
+    uint64_t Stop();
+    bool IsCapturing() const { return capturing_.load(std::memory_order_relaxed); }
+
+    // Called from the read paths with the time the message came off the socket
+    void Write(Source source, Clock::time_point received, std::string_view payload) {
+        if (IsCapturing()) {
+            Append(source, received, payload);
+        }
+    }
+
+    // False if the file is missing or not a capture; a truncated last record is dropped
+    static bool Load(const std::filesystem::path& path, Capture& out);
+
+private:
+    SessionCapture() = default;
+    void Append(Source source, Clock::time_point received, std::string_view payload);
+
+    static constexpr char kMagic[8] = { 'T', 'Q', 'C', 'C', 'A', 'P', '1', '\n' };
+    static constexpr size_t kFileBufferSize = 64 * 1024;
+
+    std::atomic<bool> capturing_{ false };
+    std::mutex mutex_;
+    std::FILE* file_ = nullptr;
+    Clock::time_point last_;
+    uint64_t written_ = 0;
+};
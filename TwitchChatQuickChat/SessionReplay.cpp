@@ -0,0 +1,138 @@
+#include "pch.h"
+#include "SessionReplay.h"
+#include "NetReactor.h"
+#include "FilePath.h"
+#include "logging.h"
+#include <algorithm>
+
+SessionReplay& SessionReplay::Get() {
+    static SessionReplay instance;
+    return instance;
+}
+
+std::string SessionReplay::Start(const std::filesystem::path& path, double speed, std::shared_ptr<TwitchEventSub> eventSub,
+                                 std::shared_ptr<TwitchWebSocket> irc) {
+    if (!eventSub) {
+        return "EventSub isn't set up yet";
+    }
+    if (!(speed >= 0.0)) {
+        return "Speed must be 0 (as fast as possible) or more";
+    }
+
+    // Records point into the capture's data, so load it where it will stay
+    auto run = std::make_shared<Run>();
+    if (!SessionCapture::Load(path, run->capture)) {
+        return "Couldn't read a capture from " + FilePath::ToString(path);
+    }
+    if (run->capture.records.empty()) {
+        return FilePath::ToString(path) + " has no messages";
+    }
+    run->speed = speed;
+    run->eventSub = std::move(eventSub);
+    run->irc = irc ? std::move(irc) : std::make_shared<TwitchWebSocket>();
+    run->generation = ++generation_;
+    running_ = true;
+
+    NetReactor::Get().Post([this, run]() {
+        run->started = NetReactor::Clock::now();
+        Step(run);
+    });
+    return {};
+}
+
+void SessionReplay::Stop() {
+    ++generation_;
+    running_ = false;
+}
+
+void SessionReplay::Step(std::shared_ptr<Run> run) {
+    if (run->generation != generation_) {
+        return;
+    }
+
+    const auto& records = run->capture.records;
+    int64_t firstOffsetUs = records.front().offsetUs;
+    bool paced = run->speed > 0.0;
+    auto dueAt = [&](const SessionCapture::Record& record) {
+        return run->started + std::chrono::duration_cast<NetReactor::Clock::duration>(
+            std::chrono::duration<double, std::micro>((record.offsetUs - firstOffsetUs) / run->speed));
+    };
+
+    NetReactor::Clock::time_point now = NetReactor::Clock::now();
+    size_t fed = 0;
+    while (run->next < records.size()) {
+        const SessionCapture::Record& record = records[run->next];
+        NetReactor::Clock::time_point due;
+        if (paced) {
+            due = dueAt(record);
+            if (due > now) {
+                break;
+            }
+        } else if (fed == kBatchSize) {
+            break;
+        }
+        ++run->next;
+        ++fed;
+
+        if (record.source != SessionCapture::EventSub && record.source != SessionCapture::Irc) {
+            ++run->skipped;
+            continue;
+        }
+
+        // Stamped as just received, so Chat's latency stages measure this machine
+        NetReactor::Clock::time_point received = NetReactor::Clock::now();
+        if (paced) {
+            run->lateness.Record(received - due);
+        }
+        size_t delivered = 0;
+        if (record.source == SessionCapture::EventSub) {
+            delivered = run->eventSub->Replay(record.payload, received);
+            ++run->eventSubMessages;
+        } else {
+            delivered = run->irc->Replay(record.payload);
+            ++run->ircFrames;
+        }
+        if (delivered == 0) {
+            ++run->undelivered;
+        }
+        run->handleTime.Record(NetReactor::Clock::now() - received);
+        run->bytes += record.payload.size();
+    }
+
+    if (run->next == records.size()) {
+        Finish(*run);
+        return;
+    }
+
+    if (paced) {
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(dueAt(records[run->next]) - NetReactor::Clock::now());
+        NetReactor::Get().PostAfter((std::max)(wait, std::chrono::milliseconds(0)), [this, run]() { Step(run); });
+    } else {
+        NetReactor::Get().Post([this, run]() { Step(run); });
+    }
+}
+
+void SessionReplay::Finish(Run& run) {
+    double seconds = std::chrono::duration<double>(NetReactor::Clock::now() - run.started).count();
+    seconds = (std::max)(seconds, 1e-6);
+    LatencyHistogram::Snapshot handling = run.handleTime.GetSnapshot();
+
+    uint64_t messages = run.eventSubMessages + run.ircFrames;
+    LOG("Replay finished: {} EventSub messages and {} IRC frames in {:.3f} s ({:.0f} msg/s, {:.2f} MB/s), {} unknown records skipped",
+        run.eventSubMessages, run.ircFrames, seconds, messages / seconds, run.bytes / seconds / 1e6, run.skipped);
+    LOG("Replay handling time: p50 {} us, p99 {} us, p99.9 {} us, max {} us",
+        handling.p50Us, handling.p99Us, handling.p999Us, handling.maxUs);
+    if (run.speed > 0.0) {
+        // Paced steps run on reactor timers, so this includes their resolution
+        LatencyHistogram::Snapshot lateness = run.lateness.GetSnapshot();
+        LOG("Replay behind schedule: p50 {} us, p99 {} us, max {} us", lateness.p50Us, lateness.p99Us, lateness.maxUs);
+    }
+    if (run.undelivered > 0) {
+        LOG("Replay: {} messages reached no handler: session messages, no subscriber (chat must be on to reach the chatbox) or IRC without a message callback", run.undelivered);
+    }
+
+    // Start() may already have begun another replay
+    if (run.generation == generation_) {
+        running_ = false;
+    }
+}
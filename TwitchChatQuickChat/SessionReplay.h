@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "SessionCapture.h"
+#include "TwitchEventSub.h"
+#include "TwitchWebSocket.h"
+#include "LatencyHistogram.h"
+
+// Feeds a SessionCapture back through TwitchEventSub and TwitchWebSocket on the reactor
+// thread, so the messages take the same parse -> subscriber -> Chat path as live ones
+// and the chat latency histograms cover them.
+//
+// speed 1 keeps the captured timing, N plays N times faster, and 0 feeds messages as
+// fast as they are handled (in batches, so live sockets are still served). When the
+// capture runs out, throughput and the per-message handling time are logged.
+class SessionReplay {
+public:
+    static SessionReplay& Get();
+
+    // Returns an error message, or an empty string once the replay is under way. IRC
+    // records go to irc's message callback; without one they go through a detached
+    // TwitchWebSocket, so they are still parsed and timed.
+    std::string Start(const std::filesystem::path& path, double speed, std::shared_ptr<TwitchEventSub> eventSub,
+                      std::shared_ptr<TwitchWebSocket> irc = nullptr);
+    void Stop();
+    bool IsRunning() const { return running_.load(std::memory_order_relaxed); }
+
+private:
+    struct Run {
+        uint64_t generation = 0;
+        double speed = 1.0;
+        std::shared_ptr<TwitchEventSub> eventSub;
+        std::shared_ptr<TwitchWebSocket> irc;
+        SessionCapture::Capture capture;
+        size_t next = 0;
+
+        NetReactor::Clock::time_point started;
+        uint64_t eventSubMessages = 0;
+        uint64_t ircFrames = 0;
+        uint64_t undelivered = 0;       // session messages, no subscriber, or no PRIVMSG callback
+        uint64_t skipped = 0;           // unknown sources
+        uint64_t bytes = 0;
+        LatencyHistogram handleTime;    // parse and dispatch, per message
+        LatencyHistogram lateness;      // behind the captured schedule (paced replays only)
+    };
+
+    SessionReplay() = default;
+    // Reactor thread: feeds what is due, then schedules itself again
+    void Step(std::shared_ptr<Run> run);
+    void Finish(Run& run);
+
+    // Messages per Step when not paced, so sockets and timers still get a turn
+    static constexpr size_t kBatchSize = 256;
+
+    std::atomic<bool> running_{ false };
+    // Bumped by Start() and Stop() so steps of an older replay end quietly
+    std::atomic<uint64_t> generation_{ 0 };
+};
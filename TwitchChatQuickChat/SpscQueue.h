@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+//
+// head_ is only written by the consumer and tail_ only by the producer, so each side
+// needs a single acquire load of the other's index and a release store of its own.
+// Capacity must be a power of two; one slot is never used to tell full from empty.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer side. Returns false (and leaves value untouched) when the queue is full.
+    bool TryPush(T&& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t next = (tail + 1) & kMask;
+        if (next == cachedHead_) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (next == cachedHead_) {
+                return false;
+            }
+        }
+        slots_[tail] = std::move(value);
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when the queue is empty.
+    bool TryPop(T& out) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) {
+                return false;
+            }
+        }
+        out = std::move(slots_[head]);
+        head_.store((head + 1) & kMask, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate from any thread; exact from the consumer when the producer is idle
+    bool Empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t Size() const {
+        return (tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire)) & kMask;
+    }
+
+    static constexpr size_t MaxSize() { return Capacity - 1; }
+
+private:
+    static constexpr size_t kMask = Capacity - 1;
+    static constexpr size_t kCacheLine = 64;
+
+    // Each index lives on its own cache line next to the copy of the other index
+    // its owner reads, so the two threads don't bounce lines on every operation.
+    alignas(kCacheLine) std::atomic<size_t> head_{ 0 };
+    size_t cachedTail_ = 0;     // consumer's last view of tail_
+    alignas(kCacheLine) std::atomic<size_t> tail_{ 0 };
+    size_t cachedHead_ = 0;     // producer's last view of head_
+    alignas(kCacheLine) std::array<T, Capacity> slots_;
+};
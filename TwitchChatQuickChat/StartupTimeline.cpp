@@ -0,0 +1,43 @@
+#include "pch.h"
+#include "StartupTimeline.h"
+#include "logging.h"
+
+StartupTimeline& StartupTimeline::Get() {
+    static StartupTimeline instance;
+    return instance;
+}
+
+void StartupTimeline::Reset() {
+    for (auto& mark : marks_) {
+        mark.store(0, std::memory_order_relaxed);
+    }
+    reported_ = false;
+    Mark(PluginLoaded);
+}
+
+void StartupTimeline::Mark(Stage stage) {
+    int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+    int64_t expected = 0;
+    if (!marks_[stage].compare_exchange_strong(expected, now == 0 ? 1 : now, std::memory_order_relaxed)) {
+        return;
+    }
+
+    if (stage == SubscriptionsActive && !reported_.exchange(true)) {
+        Report();
+    }
+}
+
+int64_t StartupTimeline::ElapsedMs(Stage stage) const {
+    int64_t start = marks_[PluginLoaded].load(std::memory_order_relaxed);
+    int64_t at = marks_[stage].load(std::memory_order_relaxed);
+    if (start == 0 || at == 0) {
+        return -1;
+    }
+    return (at - start) / 1000;
+}
+
+void StartupTimeline::Report() const {
+    LOG("TwitchChatQuickChat: startup (ms after load) token={} identity={} broadcaster={} connected={} welcomed={} subscribed={}",
+        ElapsedMs(TokenReady), ElapsedMs(IdentityResolved), ElapsedMs(BroadcasterResolved),
+        ElapsedMs(EventSubConnected), ElapsedMs(EventSubWelcomed), ElapsedMs(SubscriptionsActive));
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// When each step between plugin load and live chat happened, to see where startup
+// time goes. Stages are marked from whichever thread reaches them, first mark wins,
+// and the whole timeline is logged once the subscriptions are live.
+class StartupTimeline {
+public:
+    enum Stage {
+        PluginLoaded,
+        TokenReady,             // restored from disk or received from the browser
+        IdentityResolved,       // own login and user id known
+        BroadcasterResolved,    // channel's user id known
+        EventSubConnected,      // TCP + TLS + WebSocket handshake done
+        EventSubWelcomed,
+        SubscriptionsActive,    // every pending subscription accepted by Helix
+        Count
+    };
+
+    static StartupTimeline& Get();
+
+    // Starts a new timeline and marks PluginLoaded
+    void Reset();
+    void Mark(Stage stage);
+    // Milliseconds after PluginLoaded, or -1 if not reached
+    int64_t ElapsedMs(Stage stage) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    StartupTimeline() = default;
+    void Report() const;
+
+    // Microseconds since the clock's epoch; 0 means not reached
+    std::atomic<int64_t> marks_[Count] = {};
+    std::atomic<bool> reported_{ false };
+};
@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "TlsContext.h"
+#include "logging.h"
+
+TlsContext& TlsContext::Get() {
+    static TlsContext instance;
+    return instance;
+}
+
+TlsContext::TlsContext() {
+    OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, nullptr);
+
+    ctx_ = SSL_CTX_new(TLS_client_method());
+    if (!ctx_) {
+        LOG("Failed to create SSL context");
+        return;
+    }
+
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+
+    // Clients don't look sessions up by id, so OpenSSL's internal store is no use;
+    // sessions are handed to OnNewSession and offered again by host. For TLS 1.3
+    // this fires when the server's NewSessionTicket arrives, after the handshake.
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx_, &TlsContext::OnNewSession);
+}
+
+TlsContext::~TlsContext() {
+    ClearSessions();
+    if (ctx_) {
+        SSL_CTX_free(ctx_);
+    }
+}
+
+SSL* TlsContext::NewConnection(const std::string& host) {
+    if (!ctx_) {
+        return nullptr;
+    }
+
+    SSL* ssl = SSL_new(ctx_);
+    if (!ssl) {
+        return nullptr;
+    }
+    SSL_set_tlsext_host_name(ssl, host.c_str());
+
+    SSL_SESSION* session = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(host);
+        if (it != sessions_.end()) {
+            session = it->second;
+            // TLS 1.3 tickets are meant to be used once; the server sends fresh ones
+            // on the new connection, so take this one out of the cache
+            if (SSL_SESSION_get_protocol_version(session) >= TLS1_3_VERSION) {
+                sessions_.erase(it);
+            } else {
+                SSL_SESSION_up_ref(session);
+            }
+        }
+    }
+
+    if (session) {
+        if (SSL_SESSION_is_resumable(session)) {
+            SSL_set_session(ssl, session);
+        }
+        SSL_SESSION_free(session);
+    }
+
+    // No early data: the first bytes on every connection are the WebSocket upgrade
+    // followed by credentials (IRC PASS), and 0-RTT data can be replayed by anyone
+    // who captured it. Resumption alone already saves the certificate exchange.
+    return ssl;
+}
+
+void TlsContext::OnHandshakeComplete(SSL* ssl) {
+    handshakes_.fetch_add(1, std::memory_order_relaxed);
+    if (SSL_session_reused(ssl)) {
+        resumed_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+TlsContext::Stats TlsContext::GetStats() const {
+    Stats stats;
+    stats.handshakes = handshakes_.load(std::memory_order_relaxed);
+    stats.resumed = resumed_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void TlsContext::ClearSessions() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [host, session] : sessions_) {
+        SSL_SESSION_free(session);
+    }
+    sessions_.clear();
+}
+
+int TlsContext::OnNewSession(SSL* ssl, SSL_SESSION* session) {
+    const char* host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if (!host) {
+        return 0;
+    }
+
+    // Returning 1 keeps the reference OpenSSL passed in
+    Get().StoreSession(host, session);
+    return 1;
+}
+
+void TlsContext::StoreSession(const std::string& host, SSL_SESSION* session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SSL_SESSION*& slot = sessions_[host];
+    if (slot) {
+        SSL_SESSION_free(slot);
+    }
+    slot = session;
+}
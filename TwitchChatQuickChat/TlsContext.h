@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include <openssl/ssl.h>
+
+// Process-wide client TLS context for the plugin's own sockets (EventSub and IRC).
+//
+// OpenSSL is initialised once, and the sessions servers hand out are kept per host
+// so the next connection to the same host resumes instead of doing a full
+// handshake. Helix requests go through httplib, which owns its own context.
+class TlsContext {
+public:
+    struct Stats {
+        uint64_t handshakes = 0;    // sessions offered to a server or not
+        uint64_t resumed = 0;       // of which the server accepted
+    };
+
+    static TlsContext& Get();
+
+    // New connection object for host with SNI set and a cached session offered
+    // if there is one. nullptr if the context couldn't be created.
+    SSL* NewConnection(const std::string& host);
+    // Call once SSL_connect succeeded
+    void OnHandshakeComplete(SSL* ssl);
+
+    Stats GetStats() const;
+    // Drops every cached session, e.g. after logging out
+    void ClearSessions();
+
+private:
+    TlsContext();
+    ~TlsContext();
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    static int OnNewSession(SSL* ssl, SSL_SESSION* session);
+    void StoreSession(const std::string& host, SSL_SESSION* session);
+
+    SSL_CTX* ctx_ = nullptr;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, SSL_SESSION*> sessions_;   // owned, keyed by SNI host
+
+    std::atomic<uint64_t> handshakes_{ 0 };
+    std::atomic<uint64_t> resumed_{ 0 };
+};
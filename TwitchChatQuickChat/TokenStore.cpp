@@ -0,0 +1,86 @@
+#include "pch.h"
+#include "TokenStore.h"
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <Windows.h>
+#include <wincrypt.h>
+
+#pragma comment(lib, "crypt32.lib")
+
+TokenStore::TokenStore(std::filesystem::path file)
+    : file_(std::move(file))
+{
+}
+
+bool TokenStore::Save(const std::string& accessToken) {
+    DATA_BLOB plain;
+    plain.pbData = reinterpret_cast<BYTE*>(const_cast<char*>(accessToken.data()));
+    plain.cbData = static_cast<DWORD>(accessToken.size());
+
+    DATA_BLOB encrypted = {};
+    if (!CryptProtectData(&plain, L"TwitchChatQuickChat token", nullptr, nullptr, nullptr,
+                          CRYPTPROTECT_UI_FORBIDDEN, &encrypted)) {
+        LOG("Failed to encrypt token: {}", GetLastError());
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(file_.parent_path(), error);
+
+    // Write next to the target and swap, so a crash never leaves half a token behind
+    std::filesystem::path temp = file_;
+    temp += ".tmp";
+    bool written = false;
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(encrypted.pbData), encrypted.cbData);
+        written = static_cast<bool>(out);
+    }
+    LocalFree(encrypted.pbData);
+
+    if (!written) {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+
+    std::filesystem::rename(temp, file_, error);
+    return !error;
+}
+
+std::string TokenStore::Load() const {
+    std::ifstream in(file_, std::ios::binary);
+    if (!in) {
+        return {};
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.empty()) {
+        return {};
+    }
+
+    DATA_BLOB encrypted;
+    encrypted.pbData = reinterpret_cast<BYTE*>(data.data());
+    encrypted.cbData = static_cast<DWORD>(data.size());
+
+    DATA_BLOB plain = {};
+    if (!CryptUnprotectData(&encrypted, nullptr, nullptr, nullptr, nullptr,
+                            CRYPTPROTECT_UI_FORBIDDEN, &plain)) {
+        LOG("Failed to decrypt stored token: {}", GetLastError());
+        return {};
+    }
+
+    std::string accessToken(reinterpret_cast<const char*>(plain.pbData), plain.cbData);
+    SecureZeroMemory(plain.pbData, plain.cbData);
+    LocalFree(plain.pbData);
+    return accessToken;
+}
+
+bool TokenStore::Exists() const {
+    std::error_code error;
+    return std::filesystem::exists(file_, error);
+}
+
+void TokenStore::Clear() {
+    std::error_code error;
+    std::filesystem::remove(file_, error);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <filesystem>
+
+// Keeps the OAuth access token between game sessions.
+//
+// The token is encrypted with DPAPI for the current Windows user before it touches
+// disk, so the file is useless when copied to another account or machine.
+class TokenStore
+{
+public:
+    explicit TokenStore(std::filesystem::path file);
+
+    bool Save(const std::string& accessToken);
+    // Empty if nothing is stored or it can't be decrypted
+    std::string Load() const;
+    void Clear();
+    bool Exists() const;
+
+private:
+    std::filesystem::path file_;
+};
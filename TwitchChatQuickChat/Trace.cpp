@@ -0,0 +1,158 @@
+#include "pch.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+
+namespace {
+    // Plain pointers and arrays only: the game thread outlives the plugin DLL, so
+    // nothing thread_local here may need a destructor
+    thread_local void* t_buffer = nullptr;
+    thread_local char t_threadName[Trace::kThreadNameSize] = {};
+
+    void CopyTruncated(char* out, size_t size, std::string_view text) {
+        size_t length = (std::min)(text.size(), size - 1);
+        std::memcpy(out, text.data(), length);
+        out[length] = '\0';
+    }
+
+    void AppendJsonString(std::string& json, std::string_view text) {
+        json += '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                json += '\\';
+                json += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                json += std::format("\\u{:04x}", static_cast<int>(c));
+            } else {
+                json += c;
+            }
+        }
+        json += '"';
+    }
+}
+
+Trace& Trace::Get() {
+    static Trace instance;
+    return instance;
+}
+
+void Trace::SetEnabled(bool enabled) {
+    if (enabled && anchorTicks_.load(std::memory_order_relaxed) == 0) {
+        anchorNs_.store(SteadyNs(), std::memory_order_relaxed);
+        anchorTicks_.store(Now(), std::memory_order_relaxed);
+    }
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void Trace::SetThreadName(const char* name) {
+    CopyTruncated(t_threadName, kThreadNameSize, name);
+}
+
+Trace::ThreadBuffer& Trace::CurrentBuffer() {
+    if (t_buffer) {
+        return *static_cast<ThreadBuffer*>(t_buffer);
+    }
+
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->events.resize(kEventsPerThread);
+    std::memcpy(buffer->name, t_threadName, kThreadNameSize);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer->tid = static_cast<uint32_t>(buffers_.size() + 1);
+    if (buffer->name[0] == '\0') {
+        CopyTruncated(buffer->name, kThreadNameSize, std::format("Thread {}", buffer->tid));
+    }
+    t_buffer = buffer.get();
+    buffers_.push_back(std::move(buffer));
+    return *static_cast<ThreadBuffer*>(t_buffer);
+}
+
+void Trace::Record(const char* category, const char* name, int64_t start, int64_t end, std::string_view detail) {
+    ThreadBuffer& buffer = CurrentBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    Event& event = buffer.events[buffer.written % kEventsPerThread];
+    event.category = category;
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    CopyTruncated(event.detail, kDetailSize, detail);
+    ++buffer.written;
+}
+
+int64_t Trace::Export(const std::filesystem::path& path) {
+    // Copy out first so recording threads only wait for a memcpy
+    struct ThreadCopy {
+        uint32_t tid;
+        std::string name;
+        std::vector<Event> events;
+    };
+    std::vector<ThreadCopy> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& buffer : buffers_) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            ThreadCopy copy{ buffer->tid, buffer->name, {} };
+            uint64_t count = (std::min)(buffer->written, static_cast<uint64_t>(kEventsPerThread));
+            for (uint64_t i = buffer->written - count; i < buffer->written; ++i) {
+                copy.events.push_back(buffer->events[i % kEventsPerThread]);
+            }
+            threads.push_back(std::move(copy));
+        }
+    }
+
+    // Ticks per microsecond over everything since tracing was first enabled
+    int64_t anchorTicks = anchorTicks_.load(std::memory_order_relaxed);
+    int64_t elapsedNs = SteadyNs() - anchorNs_.load(std::memory_order_relaxed);
+    int64_t elapsedTicks = Now() - anchorTicks;
+    double ticksPerUs = elapsedNs > 0 && elapsedTicks > 0 ? elapsedTicks * 1000.0 / elapsedNs : 1000.0;
+
+    // Timestamps are microseconds from the oldest span
+    int64_t origin = INT64_MAX;
+    for (const ThreadCopy& thread : threads) {
+        for (const Event& event : thread.events) {
+            origin = (std::min)(origin, event.start);
+        }
+    }
+
+    std::string json = R"({"displayTimeUnit":"ms","traceEvents":[)";
+    int64_t count = 0;
+    bool first = true;
+    for (const ThreadCopy& thread : threads) {
+        json += std::format(R"({}{{"ph":"M","name":"thread_name","pid":1,"tid":{},"args":{{"name":)", first ? "" : ",", thread.tid);
+        AppendJsonString(json, thread.name);
+        json += "}}";
+        first = false;
+
+        for (const Event& event : thread.events) {
+            json += std::format(R"(,{{"ph":"X","cat":"{}","name":"{}","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f})",
+                event.category, event.name, thread.tid,
+                (event.start - origin) / ticksPerUs, (event.end - event.start) / ticksPerUs);
+            if (event.detail[0] != '\0') {
+                json += R"(,"args":{"detail":)";
+                AppendJsonString(json, event.detail);
+                json += '}';
+            }
+            json += '}';
+            ++count;
+        }
+    }
+    json += "]}\n";
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(json.data(), json.size())) {
+        return -1;
+    }
+    return count;
+}
+
+void Trace::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& buffer : buffers_) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->written = 0;
+    }
+}
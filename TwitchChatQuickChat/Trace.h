@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Records where time goes across the plugin's threads, for viewing in chrome://tracing
+// or Perfetto.
+//
+// Code marks regions with a TraceSpan. While tracing is off a span costs one relaxed
+// load; while on, it reads the timestamp counter twice and appends one event to a ring
+// owned by the calling thread, so threads never contend with each other. Each thread
+// keeps its last kEventsPerThread spans, and Export() writes them all as Chrome Trace
+// Event JSON.
+//
+// Spans are stamped with the CPU's timestamp counter, which costs a fraction of a
+// steady_clock read, and converted to time on export against steady_clock readings
+// taken when tracing was first enabled and at export.
+class Trace {
+public:
+    static constexpr size_t kEventsPerThread = 8192;
+    static constexpr size_t kDetailSize = 48;       // bytes of detail kept per span
+    static constexpr size_t kThreadNameSize = 32;
+
+    static Trace& Get();
+
+    bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+    void SetEnabled(bool enabled);
+
+    // Names the calling thread in exported traces; call once when the thread starts
+    static void SetThreadName(const char* name);
+
+    // Writes every buffered span; returns how many, or -1 if the file couldn't be written
+    int64_t Export(const std::filesystem::path& path);
+    void Clear();
+
+    // category and name must be literals; detail is copied (and cut to kDetailSize)
+    void Record(const char* category, const char* name, int64_t start, int64_t end, std::string_view detail);
+
+    // Ticks of the timestamp counter (nanoseconds where there isn't one)
+    static int64_t Now() {
+#if defined(_M_X64) || defined(__x86_64__)
+        return static_cast<int64_t>(__rdtsc());
+#else
+        return SteadyNs();
+#endif
+    }
+
+private:
+    struct Event {
+        const char* category;
+        const char* name;
+        int64_t start;              // Now() ticks
+        int64_t end;
+        char detail[kDetailSize];
+    };
+
+    // One per thread that has recorded; the lock is only ever contended by Export
+    struct ThreadBuffer {
+        std::mutex mutex;
+        uint32_t tid = 0;
+        char name[kThreadNameSize] = {};
+        std::vector<Event> events;      // ring of kEventsPerThread
+        uint64_t written = 0;
+    };
+
+    Trace() = default;
+    ThreadBuffer& CurrentBuffer();
+    static int64_t SteadyNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::atomic<bool> enabled_{ false };
+    // Now() and steady_clock read together when tracing was first enabled, to scale ticks on export
+    std::atomic<int64_t> anchorTicks_{ 0 };
+    std::atomic<int64_t> anchorNs_{ 0 };
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;    // never shrinks; threads keep raw pointers
+};
+
+// Times the enclosing scope as one span on the calling thread
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name, std::string_view detail = {})
+        : category_(category), name_(name), detail_(detail),
+          start_(Trace::Get().IsEnabled() ? Trace::Now() : 0) {
+    }
+    ~TraceSpan() {
+        if (start_ != 0) {
+            Trace::Get().Record(category_, name_, start_, Trace::Now(), detail_);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* category_;
+    const char* name_;
+    std::string_view detail_;       // must outlive the span
+    int64_t start_;
+};
@@ -1,6 +1,18 @@
 #include "pch.h"
 #include "TwitchChatQuickChat.h"
 #include "Config.h"
+#include "NetReactor.h"
+#include "AsyncExecutor.h"
+#include "StartupTimeline.h"
+#include "AsyncLog.h"
+#include "Trace.h"
+#include "SessionCapture.h"
+#include "SessionReplay.h"
+#include "FilePath.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
 
 BAKKESMOD_PLUGIN(TwitchChatQuickChat, "Twitch Chat Quick Chat", plugin_version,
     PLUGINTYPE_FREEPLAY | PLUGINTYPE_CUSTOM_TRAINING | PLUGINTYPE_SPECTATOR |
@@ -11,14 +23,31 @@ std::shared_ptr<CVarManagerWrapper> _globalCvarManager;
 void TwitchChatQuickChat::onLoad()
 {
     _globalCvarManager = cvarManager;
+    StartupTimeline::Get().Reset();
+    Trace::SetThreadName("Game");
+
+    // LOG lines are formatted and printed on the logging thread from here on
+    AsyncLog::Get().Start([cvarManager = cvarManager](const std::string& line) {
+        cvarManager->log(line);
+    });
 
     // Initialize login module
-    login_ = std::make_unique<Login>(gameWrapper);
+    helix_ = std::make_shared<HelixClient>();
+    eventSub_ = std::make_shared<TwitchEventSub>(helix_);
+    login_ = std::make_unique<Login>(gameWrapper, helix_);
 
     // Register CVars with persistence
     cvarManager->registerCvar("twitchChatQuickChat_chat_enabled", "0", "Enable Twitch Chat feature", true, true, 0, true, 1);
     cvarManager->registerCvar("twitchChatQuickChat_predictions_enabled", "0", "Enable Auto Predictions feature", true, true, 0, true, 1);
     cvarManager->registerCvar("twitchChatQuickChat_channel", "", "Twitch channel to join");
+    cvarManager->registerCvar("twitchChatQuickChat_chat_frame_budget", "10", "Max chat messages shown per game frame", true, true, 1, true, 100);
+    cvarManager->registerCvar("twitchChatQuickChat_chat_max_per_second", "0", "Max chat messages shown per second (0 = unlimited)", true, true, 0, true, 50);
+    cvarManager->registerCvar("twitchChatQuickChat_chat_overflow_policy", "0", "When chat outpaces the display rate: 0 = drop oldest, 1 = sample 1-in-N", true, true, 0, true, 1);
+    cvarManager->registerCvar("twitchChatQuickChat_chat_sample_every", "5", "Show 1 in N messages while backed up (sample policy)", true, true, 2, true, 100);
+    cvarManager->registerCvar("twitchChatQuickChat_chat_collapse_duplicates", "0", "Merge identical messages within about a second into one with a count", true, true, 0, true, 1);
+    cvarManager->registerCvar("twitchChatQuickChat_chat_user_cap", "0", "Max messages per user every 10 seconds (0 = unlimited)", true, true, 0, true, 20);
+    cvarManager->registerCvar("twitchChatQuickChat_trace", "0", "Record spans for twitchChatQuickChat_export_trace", true, true, 0, true, 1, false);
+    cvarManager->registerCvar("twitchChatQuickChat_log_to_file", "0", "Also write plugin log lines to logs/plugin.log in the data folder", true, true, 0, true, 1);
 
     // Load saved settings from cfg file
     cvarManager->loadCfg("twitchChatQuickChat.cfg");
@@ -34,6 +63,22 @@ void TwitchChatQuickChat::onLoad()
         }
     });
 
+    cvarManager->getCvar("twitchChatQuickChat_trace").addOnValueChanged([](std::string oldValue, CVarWrapper cvar) {
+        Trace::Get().SetEnabled(cvar.getBoolValue());
+    });
+
+    // The cfg was loaded before this listener existed, so apply the saved value too
+    auto applyLogFile = [this](CVarWrapper cvar) {
+        AsyncLog::Get().SetFile(cvar.getBoolValue()
+            ? gameWrapper->GetDataFolder() / "TwitchChatQuickChat" / "logs" / "plugin.log"
+            : std::filesystem::path());
+    };
+    CVarWrapper logToFileCvar = cvarManager->getCvar("twitchChatQuickChat_log_to_file");
+    logToFileCvar.addOnValueChanged([applyLogFile](std::string oldValue, CVarWrapper cvar) {
+        applyLogFile(cvar);
+    });
+    applyLogFile(logToFileCvar);
+
     cvarManager->getCvar("twitchChatQuickChat_predictions_enabled").addOnValueChanged([this](std::string oldValue, CVarWrapper cvar) {
         if (login_ && login_->IsLoggedIn()) {
             if (cvar.getBoolValue()) {
@@ -44,6 +89,98 @@ void TwitchChatQuickChat::onLoad()
         }
     });
 
+    // twitchChatQuickChat_log_sites [list]            every site that has logged, on or off
+    // twitchChatQuickChat_log_sites on|off <pattern>  pattern is all, File.cpp or File.cpp:123
+    cvarManager->registerNotifier("twitchChatQuickChat_log_sites", [this](std::vector<std::string> args) {
+        if (args.size() >= 3 && (args[1] == "on" || args[1] == "off")) {
+            size_t matched = LogSites::Get().SetEnabled(args[2], args[1] == "on");
+            cvarManager->log(std::format("Log sites matching {} turned {} ({} seen so far)", args[2], args[1], matched));
+            return;
+        }
+        for (const std::string& line : LogSites::Get().Describe()) {
+            cvarManager->log(line);
+        }
+    }, "List log call sites, or switch them with: on|off <all|File.cpp|File.cpp:line>", PERMISSION_ALL);
+
+    // twitchChatQuickChat_export_trace [file name]   written to the data folder
+    cvarManager->registerNotifier("twitchChatQuickChat_export_trace", [this](std::vector<std::string> args) {
+        std::filesystem::path path = gameWrapper->GetDataFolder() / "TwitchChatQuickChat" /
+            (args.size() >= 2 ? std::filesystem::path(args[1]).filename() : std::filesystem::path("trace.json"));
+        int64_t spans = Trace::Get().Export(path);
+        cvarManager->log(spans < 0 ? "Couldn't write " + FilePath::ToString(path)
+            : std::format("{} spans written to {}; open it in chrome://tracing or ui.perfetto.dev", spans, FilePath::ToString(path)));
+    }, "Write recorded spans as a Chrome trace (enable with twitchChatQuickChat_trace 1)", PERMISSION_ALL);
+
+    cvarManager->registerNotifier("twitchChatQuickChat_export_latency", [this](std::vector<std::string> args) {
+        std::filesystem::path path = ExportLatency();
+        cvarManager->log(path.empty() ? "Couldn't write latency.json" : "Latency histograms written to " + FilePath::ToString(path));
+    }, "Write the chat latency histograms to latency.json in the data folder", PERMISSION_ALL);
+
+    // twitchChatQuickChat_capture start [file name]   every received message, written to the data folder
+    // twitchChatQuickChat_capture stop
+    cvarManager->registerNotifier("twitchChatQuickChat_capture", [this](std::vector<std::string> args) {
+        if (args.size() >= 2 && args[1] == "start") {
+            std::filesystem::path path = gameWrapper->GetDataFolder() / "TwitchChatQuickChat" /
+                (args.size() >= 3 ? std::filesystem::path(args[2]).filename() : std::filesystem::path("session.cap"));
+            cvarManager->log(SessionCapture::Get().Start(path) ? "Capturing to " + FilePath::ToString(path) : "Couldn't open " + FilePath::ToString(path));
+        } else if (args.size() >= 2 && args[1] == "stop") {
+            cvarManager->log(std::format("Capture stopped, {} messages written", SessionCapture::Get().Stop()));
+        } else {
+            cvarManager->log("Usage: twitchChatQuickChat_capture start [file name] | stop");
+        }
+    }, "Write received EventSub and IRC messages to a capture file for twitchChatQuickChat_replay", PERMISSION_ALL);
+
+    // twitchChatQuickChat_replay <file name> [speed|max]   speed 1 keeps the captured timing
+    // twitchChatQuickChat_replay stop
+    cvarManager->registerNotifier("twitchChatQuickChat_replay", [this](std::vector<std::string> args) {
+        if (args.size() >= 2 && args[1] == "stop") {
+            SessionReplay::Get().Stop();
+            cvarManager->log("Replay stopped");
+            return;
+        }
+        if (args.size() < 2) {
+            cvarManager->log("Usage: twitchChatQuickChat_replay <file name> [speed|max] | stop");
+            return;
+        }
+
+        double speed = 1.0;
+        if (args.size() >= 3 && args[2] != "max") {
+            char* end = nullptr;
+            speed = std::strtod(args[2].c_str(), &end);
+            if (end == args[2].c_str() || *end != '\0') {
+                speed = -1.0;
+            }
+        } else if (args.size() >= 3) {
+            speed = 0.0;
+        }
+        std::filesystem::path path = gameWrapper->GetDataFolder() / "TwitchChatQuickChat" / std::filesystem::path(args[1]).filename();
+
+        // So the Diagnostics tab and latency.json describe just the replay
+        if (chat_) {
+            for (int stage = 0; stage < Chat::LatencyStageCount; ++stage) {
+                chat_->GetLatency(static_cast<Chat::LatencyStage>(stage)).Reset();
+            }
+        }
+        std::string error = SessionReplay::Get().Start(path, speed, eventSub_);
+        cvarManager->log(error.empty()
+            ? "Replaying " + FilePath::ToString(path) + "; chat latency is in the Diagnostics tab and twitchChatQuickChat_export_latency"
+            : error);
+    }, "Feed a capture through the chat pipeline at a speed (1 = as captured, max = as fast as possible)", PERMISSION_ALL);
+
+    // Pick up the login from the last session without opening the browser. The
+    // EventSub handshake doesn't need the token, so it runs alongside validation.
+    if (login_->HasSavedSession()) {
+        PrewarmEventSub();
+        login_->RestoreSession([this](bool success) {
+            if (success) {
+                OnLoginComplete();
+            } else if (eventSub_) {
+                // Nothing will subscribe; drop the early session
+                eventSub_->Disconnect();
+            }
+        });
+    }
+
     LOG("TwitchChatQuickChat: Plugin loaded");
 }
 
@@ -52,6 +189,9 @@ void TwitchChatQuickChat::onUnload()
     // Save settings and disconnect
     cvarManager->backupCfg("twitchChatQuickChat.cfg");
     
+    SessionReplay::Get().Stop();
+    SessionCapture::Get().Stop();
+
     if (chat_) {
         chat_->Disconnect();
     }
@@ -59,22 +199,42 @@ void TwitchChatQuickChat::onUnload()
     if (autoPredictions_) {
         autoPredictions_->Disable();
     }
+
+    if (eventSub_) {
+        eventSub_->Disconnect();
+    }
+
+    // Give queued requests (e.g. the prediction cancel above) a moment, then cancel the
+    // rest and wait for running ones so nothing calls back into the unloaded plugin
+    AsyncExecutor::Get().Shutdown(std::chrono::seconds(2));
+
+    // Whatever didn't make it to Twitch is replayed from the journal next time
+    if (autoPredictions_) {
+        autoPredictions_->FlushOutbox();
+    }
+
+    // Connections are closed; stop the network thread before the DLL goes away
+    NetReactor::Get().Stop();
+
+    // Last, so everything above can still log
+    AsyncLog::Get().Stop();
 }
 
 void TwitchChatQuickChat::OnLoginComplete()
 {
-    //LOG("OnLoginComplete: username='{}', userId='{}'", login_->GetUsername(), login_->GetUserId());
+    DEBUGLOG("OnLoginComplete: username='{}', userId='{}'", login_->GetUsername(), login_->GetUserId());
+    PrewarmEventSub();
 
     // Initialize features based on saved preferences
     CVarWrapper chatCvar = cvarManager->getCvar("twitchChatQuickChat_chat_enabled");
     if (chatCvar && chatCvar.getBoolValue()) {
-        //LOG("OnLoginComplete: Chat is enabled, connecting...");
+        DEBUGLOG("OnLoginComplete: Chat is enabled, connecting...");
         ConnectToTwitchChat();
     }
 
     CVarWrapper predictionsCvar = cvarManager->getCvar("twitchChatQuickChat_predictions_enabled");
     if (predictionsCvar && predictionsCvar.getBoolValue()) {
-        //LOG("OnLoginComplete: Predictions is enabled, enabling...");
+        DEBUGLOG("OnLoginComplete: Predictions is enabled, enabling...");
         EnablePredictions();
     }
 }
@@ -99,21 +259,45 @@ void TwitchChatQuickChat::ConnectToTwitchChat()
         twitchChannel_ = twitchChannel_.substr(1);
     }
 
+    // Our own channel needs no lookup; login already gave us the id
+    std::string channelLower = twitchChannel_;
+    std::transform(channelLower.begin(), channelLower.end(), channelLower.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (channelLower == login_->GetUsername()) {
+        StartChat(login_->GetUserId());
+        return;
+    }
+
     // Fetch the broadcaster's user ID, then connect
-    login_->FetchBroadcasterId(twitchChannel_, [this](const std::string& fetchedId) {
-        if (fetchedId.empty()) {
-            return;
+    login_->FetchUserIds({ channelLower }, [this, channelLower](const Login::UserIds& ids) {
+        auto it = ids.find(channelLower);
+        if (it != ids.end()) {
+            StartChat(it->second);
         }
+    });
+}
 
-        twitchChannelId_ = fetchedId;
+void TwitchChatQuickChat::StartChat(const std::string& broadcasterId)
+{
+    StartupTimeline::Get().Mark(StartupTimeline::BroadcasterResolved);
+    twitchChannelId_ = broadcasterId;
 
-        if (!chat_) {
-            chat_ = std::make_unique<Chat>(gameWrapper);
-        }
+    if (!chat_) {
+        chat_ = std::make_unique<Chat>(gameWrapper, cvarManager, eventSub_);
+    }
 
-        chat_->Initialize(login_->GetAccessToken(), login_->GetUserId(), twitchChannelId_);
-        chat_->Connect();
-    });
+    chat_->Initialize(login_->GetUserId(), twitchChannelId_);
+    chat_->Connect();
+}
+
+void TwitchChatQuickChat::PrewarmEventSub()
+{
+    CVarWrapper chatCvar = cvarManager->getCvar("twitchChatQuickChat_chat_enabled");
+    CVarWrapper predictionsCvar = cvarManager->getCvar("twitchChatQuickChat_predictions_enabled");
+    bool needed = (chatCvar && chatCvar.getBoolValue()) || (predictionsCvar && predictionsCvar.getBoolValue());
+    if (needed && eventSub_) {
+        eventSub_->Prewarm();
+    }
 }
 
 void TwitchChatQuickChat::EnablePredictions()
@@ -123,10 +307,34 @@ void TwitchChatQuickChat::EnablePredictions()
     }
 
     if (!autoPredictions_) {
-        autoPredictions_ = std::make_unique<AutoPredictions>(gameWrapper, cvarManager);
+        autoPredictions_ = std::make_unique<AutoPredictions>(gameWrapper, cvarManager, helix_, eventSub_);
     }
 
-    //LOG("EnablePredictions: Calling Initialize with userId: {}", login_->GetUserId());
-    autoPredictions_->Initialize(login_->GetAccessToken(), login_->GetUserId());
+    DEBUGLOG("EnablePredictions: Calling Initialize with userId: {}", login_->GetUserId());
+    autoPredictions_->Initialize(login_->GetUserId());
 }
 
+std::filesystem::path TwitchChatQuickChat::ExportLatency()
+{
+    std::string json = "{\"chat\":{";
+    if (chat_) {
+        json += "\"socket_to_parsed\":" + chat_->GetLatency(Chat::SocketToParsed).ToJson();
+        json += ",\"parsed_to_game_thread\":" + chat_->GetLatency(Chat::ParsedToGameThread).ToJson();
+        json += ",\"game_thread_to_chatbox\":" + chat_->GetLatency(Chat::GameThreadToChatbox).ToJson();
+        json += ",\"socket_to_chatbox\":" + chat_->GetLatency(Chat::SocketToChatbox).ToJson();
+    }
+    json += "},\"eventsub\":{";
+    if (eventSub_) {
+        json += "\"twitch_to_socket\":" + eventSub_->GetDeliveryDelay().ToJson();
+    }
+    json += "}}\n";
+
+    std::filesystem::path path = gameWrapper->GetDataFolder() / "TwitchChatQuickChat" / "latency.json";
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(json.data(), json.size())) {
+        return {};
+    }
+    return path;
+}
@@ -7,12 +7,18 @@
 #include "Chat.h"
 #include "AutoPredictions.h"
 #include "version.h"
+#include <filesystem>
 
 constexpr auto plugin_version = stringify(VERSION_MAJOR) "." stringify(VERSION_MINOR) "." stringify(VERSION_PATCH) "." stringify(VERSION_BUILD);
 
 class TwitchChatQuickChat: public BakkesMod::Plugin::BakkesModPlugin
     ,public SettingsWindowBase
 {
+    // Shared Helix connection pool
+    std::shared_ptr<HelixClient> helix_;
+    // Shared EventSub session for chat and prediction events
+    std::shared_ptr<TwitchEventSub> eventSub_;
+
     // Feature modules
     std::unique_ptr<Login> login_;
     std::unique_ptr<Chat> chat_;
@@ -27,8 +33,13 @@ class TwitchChatQuickChat: public BakkesMod::Plugin::BakkesModPlugin
 
     // Helper methods called by CVars and settings
     void ConnectToTwitchChat();
+    void StartChat(const std::string& broadcasterId);
+    // Opens the EventSub socket early when a feature will need it
+    void PrewarmEventSub();
     void EnablePredictions();
     void OnLoginComplete();
+    // Writes every latency histogram to latency.json in the data folder; empty path on failure
+    std::filesystem::path ExportLatency();
 
 public:
     void RenderSettings() override;
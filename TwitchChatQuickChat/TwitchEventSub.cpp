@@ -1,407 +1,604 @@
 #include "pch.h"
 #include "TwitchEventSub.h"
+#include "Trace.h"
+#include "SessionCapture.h"
+#include "AsyncExecutor.h"
+#include "StartupTimeline.h"
 #include "logging.h"
-#include <random>
 #include <sstream>
-#include <iomanip>
-#include <httplib.h>
+#include <algorithm>
 
-TwitchEventSub::TwitchEventSub() {
-    WSADATA wsaData;
-    WSAStartup(MAKEWORD(2, 2), &wsaData);
+TwitchEventSub::TwitchEventSub(std::shared_ptr<HelixClient> helix)
+    : TwitchEventSub(std::move(helix), Endpoint{}) {
+}
+
+TwitchEventSub::TwitchEventSub(std::shared_ptr<HelixClient> helix, Endpoint endpoint)
+    : helix_(std::move(helix)), endpoint_(std::move(endpoint)) {
 }
 
 TwitchEventSub::~TwitchEventSub() {
     Disconnect();
-    WSACleanup();
 }
 
-bool TwitchEventSub::Connect(const std::string& accessToken, const std::string& clientId,
-                              const std::string& userId, const std::string& broadcasterId) {
-    accessToken_ = accessToken;
-    clientId_ = clientId;
-    userId_ = userId;
-    broadcasterId_ = broadcasterId;
-
-    // Create socket
-    socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (socket_ == INVALID_SOCKET) {
-        //LOG("Failed to create socket");
-        return false;
+TwitchEventSub::SubscriptionId TwitchEventSub::Subscribe(const std::string& type, const std::string& version,
+                                                         const std::string& conditionJson, EventHandler handler) {
+    auto subscription = std::make_shared<Subscription>();
+    subscription->type = type;
+    subscription->version = version;
+    subscription->condition = conditionJson;
+    subscription->handler = std::move(handler);
+
+    bool needConnect = false;
+    std::string sessionId;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscription->id = nextId_++;
+        subscriptions_.push_back(subscription);
+        sessionId = sessionId_;
+        needConnect = !connected_ && !connecting_.exchange(true);
     }
 
-    // Resolve hostname
-    struct addrinfo hints = {}, *result = nullptr;
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    
-    if (getaddrinfo("eventsub.wss.twitch.tv", "443", &hints, &result) != 0) {
-        //LOG("Failed to resolve EventSub hostname");
-        closesocket(socket_);
-        return false;
+    if (needConnect) {
+        // Subscriptions are created once session_welcome arrives
+        AsyncExecutor::Get().Submit([weak = weak_from_this()]() {
+            if (auto self = weak.lock(); self && !self->Connect()) {
+                self->ScheduleReconnect();
+            }
+        });
+    } else if (!sessionId.empty()) {
+        AsyncExecutor::Get().Submit([weak = weak_from_this(), sessionId]() {
+            if (auto self = weak.lock()) {
+                self->RegisterSubscriptions(sessionId);
+            }
+        });
     }
 
-    // Connect
-    if (connect(socket_, result->ai_addr, static_cast<int>(result->ai_addrlen)) == SOCKET_ERROR) {
-        //LOG("Failed to connect to EventSub");
-        freeaddrinfo(result);
-        closesocket(socket_);
-        return false;
-    }
-    freeaddrinfo(result);
+    return subscription->id;
+}
 
-    // Initialize OpenSSL
-    SSL_library_init();
-    SSL_load_error_strings();
-    
-    sslCtx_ = SSL_CTX_new(TLS_client_method());
-    if (!sslCtx_) {
-        //LOG("Failed to create SSL context");
-        closesocket(socket_);
-        return false;
+void TwitchEventSub::Prewarm() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (connected_ || connecting_.exchange(true)) {
+            return;
+        }
+        prewarm_ = true;
     }
 
-    ssl_ = SSL_new(sslCtx_);
-    SSL_set_fd(ssl_, static_cast<int>(socket_));
-    SSL_set_tlsext_host_name(ssl_, "eventsub.wss.twitch.tv");
+    AsyncExecutor::Get().Submit([weak = weak_from_this()]() {
+        // Only retried once something subscribes
+        if (auto self = weak.lock(); self && !self->Connect()) {
+            self->ScheduleReconnect();
+        }
+    });
+}
 
-    if (SSL_connect(ssl_) != 1) {
-        //LOG("SSL handshake failed");
-        SSL_free(ssl_);
-        SSL_CTX_free(sslCtx_);
-        closesocket(socket_);
-        return false;
+void TwitchEventSub::Unsubscribe(SubscriptionId id) {
+    std::string twitchId;
+    bool last = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = std::find_if(subscriptions_.begin(), subscriptions_.end(),
+            [id](const std::shared_ptr<Subscription>& s) { return s->id == id; });
+        if (it == subscriptions_.end()) {
+            return;
+        }
+        std::shared_ptr<Subscription> subscription = *it;
+        twitchId = subscription->twitchId;
+        subscriptions_.erase(it);
+        last = subscriptions_.empty();
+
+        // Handlers capture their owner, which may be destroyed once this returns.
+        // Dispatch only runs on the reactor thread, where the call in progress is our caller.
+        if (!NetReactor::Get().IsReactorThread()) {
+            dispatchDone_.wait(lock, [&subscription]() { return subscription->dispatching == 0; });
+        }
     }
 
-    // Perform WebSocket handshake
-    if (!PerformWebSocketHandshake()) {
-        //LOG("WebSocket handshake failed");
+    // WebSocket subscriptions end with their session, so closing it is enough
+    if (last) {
         Disconnect();
+        return;
+    }
+
+    if (!twitchId.empty()) {
+        AsyncExecutor::Get().Submit([helix = helix_, twitchId]() {
+            helix->Delete("/helix/eventsub/subscriptions?id=" + twitchId, HelixPriority::Background);
+        });
+    }
+}
+
+bool TwitchEventSub::IsSubscribed(SubscriptionId id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& subscription : subscriptions_) {
+        if (subscription->id == id) {
+            return subscription->active;
+        }
+    }
+    return false;
+}
+
+bool TwitchEventSub::Connect() {
+    auto connection = std::make_shared<Connection>(*this);
+    if (!connection->transport.Connect(endpoint_.host, endpoint_.path, endpoint_.port)) {
+        LOG("Failed to connect to EventSub");
+        connecting_ = false;
         return false;
     }
 
-    connected_ = true;
+    connection->lastMessage = NetReactor::Clock::now();
 
-    // Start read loop - subscription happens after receiving session_welcome
-    readThread_ = std::thread(&TwitchEventSub::ReadLoop, this);
+    std::shared_ptr<Connection> previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connecting_ = false;
+        // Everything unsubscribed while the handshake was running
+        if (subscriptions_.empty() && !prewarm_) {
+            connection->transport.Close();
+            return false;
+        }
+        previous = std::move(active_);
+        active_ = connection;
+        activeClosed_ = false;
+        connected_ = true;
+    }
+
+    if (previous) {
+        Retire(previous);
+    }
+
+    StartupTimeline::Get().Mark(StartupTimeline::EventSubConnected);
 
-    //LOG("Connected to Twitch EventSub WebSocket");
+    // Reads are driven by the reactor - subscription happens after receiving session_welcome
+    NetReactor::Get().Add(connection->transport.Socket(), connection.get());
+
+    LOG("Connected to Twitch EventSub WebSocket");
     return true;
 }
 
-void TwitchEventSub::Disconnect() {
-    connected_ = false;
-    
-    if (readThread_.joinable()) {
-        readThread_.join();
+void TwitchEventSub::Reconnect(const std::string& url) {
+    // wss://eventsub.wss.twitch.tv/ws?id=...
+    const std::string scheme = "wss://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        return;
+    }
+    size_t pathStart = url.find('/', scheme.size());
+    std::string host = url.substr(scheme.size(), pathStart - scheme.size());
+    std::string path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+
+    // Only follow redirects to Twitch's own servers
+    const std::string domain = ".twitch.tv";
+    if (host.size() <= domain.size() || host.compare(host.size() - domain.size(), domain.size(), domain) != 0) {
+        LOG("Ignoring EventSub reconnect to {}", host);
+        return;
     }
 
-    if (ssl_) {
-        SSL_shutdown(ssl_);
-        SSL_free(ssl_);
-        ssl_ = nullptr;
+    auto connection = std::make_shared<Connection>(*this);
+    if (!connection->transport.Connect(host, path)) {
+        LOG("EventSub reconnect to {} failed", host);
+        return;
+    }
+    connection->lastMessage = NetReactor::Clock::now();
+
+    std::shared_ptr<Connection> previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!connected_) {
+            connection->transport.Close();
+            return;
+        }
+        previous = std::move(reconnecting_);
+        reconnecting_ = connection;
     }
 
-    if (sslCtx_) {
-        SSL_CTX_free(sslCtx_);
-        sslCtx_ = nullptr;
+    if (previous) {
+        Retire(previous);
+    }
+
+    // The old connection keeps delivering until this one is welcomed
+    NetReactor::Get().Add(connection->transport.Socket(), connection.get());
+}
+
+void TwitchEventSub::Retire(std::shared_ptr<Connection> connection) {
+    // Unregistered now, so no later tick or read reaches the owner through it; off the
+    // reactor thread this also waits for a callback already running
+    NetReactor::Get().Remove(connection.get());
+    connection->retired = true;
+    // The close is deferred so a connection is never torn down from inside its own callback
+    NetReactor::Get().Post([connection]() {
+        connection->transport.Close();
+    });
+}
+
+void TwitchEventSub::Disconnect() {
+    connected_ = false;
+    generation_.fetch_add(1);
+    stats_.Clear();
+
+    std::shared_ptr<Connection> active;
+    std::shared_ptr<Connection> reconnecting;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active = std::move(active_);
+        reconnecting = std::move(reconnecting_);
+        activeClosed_ = false;
+        prewarm_ = false;
     }
 
-    if (socket_ != INVALID_SOCKET) {
-        closesocket(socket_);
-        socket_ = INVALID_SOCKET;
+    // Off the reactor thread, Remove() waits for any in-flight callback before the
+    // transport goes away. On it (Unsubscribe() from a handler) the caller may be one
+    // of these connections' own callbacks, so the close has to be deferred.
+    bool onReactor = NetReactor::Get().IsReactorThread();
+    for (const auto& connection : { active, reconnecting }) {
+        if (!connection) {
+            continue;
+        }
+        if (onReactor) {
+            Retire(connection);
+        } else {
+            NetReactor::Get().Remove(connection.get());
+            connection->transport.Close();
+        }
     }
+    ResetSession();
 }
 
 bool TwitchEventSub::IsConnected() const {
     return connected_;
 }
 
-void TwitchEventSub::SetMessageCallback(MessageCallback callback) {
-    messageCallback_ = std::move(callback);
+void TwitchEventSub::ResetSession() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessionId_.clear();
+    for (auto& subscription : subscriptions_) {
+        subscription->twitchId.clear();
+        subscription->active = false;
+    }
 }
 
-bool TwitchEventSub::PerformWebSocketHandshake() {
-    // Generate random WebSocket key
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dist(0, 255);
-    
-    unsigned char keyBytes[16];
-    for (int i = 0; i < 16; ++i) {
-        keyBytes[i] = static_cast<unsigned char>(dist(gen));
-    }
-    
-    // Base64 encode the key
-    static const char* b64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    std::string wsKey;
-    int val = 0, valb = -6;
-    for (int i = 0; i < 16; ++i) {
-        val = (val << 8) + keyBytes[i];
-        valb += 8;
-        while (valb >= 0) {
-            wsKey.push_back(b64[(val >> valb) & 0x3F]);
-            valb -= 6;
+void TwitchEventSub::RegisterSubscriptions(const std::string& sessionId) {
+    std::vector<std::shared_ptr<Subscription>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Subscribe() and the welcome can both start a registration; each
+        // subscription is only requested once per session
+        for (const auto& subscription : subscriptions_) {
+            if (!subscription->active && subscription->registering != sessionId) {
+                subscription->registering = sessionId;
+                pending.push_back(subscription);
+            }
         }
     }
-    if (valb > -6) wsKey.push_back(b64[((val << 8) >> (valb + 8)) & 0x3F]);
-    while (wsKey.size() % 4) wsKey.push_back('=');
-
-    // Send HTTP upgrade request
-    std::ostringstream request;
-    request << "GET /ws HTTP/1.1\r\n"
-            << "Host: eventsub.wss.twitch.tv\r\n"
-            << "Upgrade: websocket\r\n"
-            << "Connection: Upgrade\r\n"
-            << "Sec-WebSocket-Key: " << wsKey << "\r\n"
-            << "Sec-WebSocket-Version: 13\r\n"
-            << "\r\n";
-
-    std::string reqStr = request.str();
-    if (SSL_write(ssl_, reqStr.c_str(), static_cast<int>(reqStr.size())) <= 0) {
+
+    for (const auto& subscription : pending) {
+        std::string twitchId;
+        bool created = !AsyncExecutor::IsCancellationRequested() &&
+            CreateSubscription(sessionId, *subscription, twitchId);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Failed ones are tried again by the next registration for this session
+        if (subscription->registering == sessionId) {
+            subscription->registering.clear();
+        }
+        // The session may have ended while the request was in flight
+        if (created && sessionId_ == sessionId) {
+            subscription->twitchId = twitchId;
+            subscription->active = true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool allActive = !subscriptions_.empty() && std::all_of(subscriptions_.begin(), subscriptions_.end(),
+        [](const std::shared_ptr<Subscription>& s) { return s->active; });
+    if (allActive) {
+        StartupTimeline::Get().Mark(StartupTimeline::SubscriptionsActive);
+    }
+}
+
+bool TwitchEventSub::CreateSubscription(const std::string& sessionId, const Subscription& subscription, std::string& twitchId) {
+    LOG("Subscribing to {} with session {}", subscription.type, sessionId);
+
+    // Build subscription request JSON
+    std::ostringstream json;
+    json << "{"
+         << "\"type\":\"" << subscription.type << "\","
+         << "\"version\":\"" << subscription.version << "\","
+         << "\"condition\":" << subscription.condition << ","
+         << "\"transport\":{"
+         << "\"method\":\"websocket\","
+         << "\"session_id\":\"" << sessionId << "\""
+         << "}"
+         << "}";
+
+    DEBUGLOG("Subscription request: {}", json.str());
+
+    auto result = helix_->Post("/helix/eventsub/subscriptions", json.str());
+
+    if (!result) {
+        LOG("Subscription request failed - no response");
         return false;
     }
 
-    // Read response
-    char buffer[1024];
-    int bytesRead = SSL_read(ssl_, buffer, sizeof(buffer) - 1);
-    if (bytesRead <= 0) {
+    DEBUGLOG("Subscription response: {} - {}", result->status, result->body);
+
+    if (result->status != 202) {
+        LOG("Subscription failed with status {}", result->status);
         return false;
     }
-    buffer[bytesRead] = '\0';
 
-    // Check for 101 Switching Protocols
-    std::string response(buffer);
-    return response.find("101") != std::string::npos;
+    // {"data":[{"id":"...","status":"enabled",...}],...}
+    Json::Value data = Json::Find(Json::Parse(result->body), "data");
+    Json::ForEachElement(data, [&twitchId](const Json::Value& entry) {
+        twitchId = Json::Find(entry, "id").ToString();
+        return false;
+    });
+    return true;
 }
 
-void TwitchEventSub::SendWebSocketFrame(const std::string& data) {
-    std::vector<unsigned char> frame;
-    
-    // Text frame opcode with FIN bit
-    frame.push_back(0x81);
-    
-    // Mask bit set + payload length
-    size_t len = data.size();
-    if (len <= 125) {
-        frame.push_back(static_cast<unsigned char>(0x80 | len));
-    } else if (len <= 65535) {
-        frame.push_back(0xFE);
-        frame.push_back(static_cast<unsigned char>((len >> 8) & 0xFF));
-        frame.push_back(static_cast<unsigned char>(len & 0xFF));
-    } else {
-        frame.push_back(0xFF);
-        for (int i = 7; i >= 0; --i) {
-            frame.push_back(static_cast<unsigned char>((len >> (8 * i)) & 0xFF));
+size_t TwitchEventSub::HandleMessage(Connection* connection, std::string_view payload, NetReactor::Clock::time_point received) {
+    TraceSpan span("eventsub", "HandleMessage");
+    DEBUGLOG("EventSub message: {}", payload);
+
+    // Anything at all, even a keepalive, shows the connection is alive
+    if (connection) {
+        connection->lastMessage = received;
+    }
+
+    EventSubMessage message;
+    if (!EventSubMessage::Parse(payload, message)) {
+        return 0;
+    }
+    message.receivedAt = received;
+
+    // Handle notification
+    if (message.messageType == "notification") {
+        // Both connections deliver during a reconnect handover
+        if (!RememberMessageId(message.messageId)) {
+            return 0;
         }
+
+        // A replayed message's timestamp is from when it was captured
+        std::chrono::system_clock::time_point sent;
+        if (connection && EventSubMessage::ParseTimestamp(message.messageTimestamp, sent)) {
+            auto receivedWall = std::chrono::system_clock::now() - (NetReactor::Clock::now() - received);
+            deliveryDelay_.Record(receivedWall - sent);
+        }
+
+        return Dispatch(message);
     }
 
-    // Masking key
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dist(0, 255);
-    unsigned char mask[4];
-    for (int i = 0; i < 4; ++i) {
-        mask[i] = static_cast<unsigned char>(dist(gen));
-        frame.push_back(mask[i]);
+    // Session messages change the connection they came on; a replayed one has none
+    if (!connection) {
+        return 0;
     }
 
-    // Masked payload
-    for (size_t i = 0; i < data.size(); ++i) {
-        frame.push_back(data[i] ^ mask[i % 4]);
+    // Handle session_keepalive - just ignore, connection is alive
+    if (message.messageType == "session_keepalive") {
+        return 0;
     }
 
-    SSL_write(ssl_, frame.data(), static_cast<int>(frame.size()));
-}
+    // Handle session_welcome
+    if (message.messageType == "session_welcome") {
+        std::string sessionId = Json::Find(message.session, "id").ToString();
+        if (!sessionId.empty()) {
+            LOG("Received session_welcome with id: {}", sessionId);
+            int64_t keepalive = Json::Find(message.session, "keepalive_timeout_seconds").ToInt(10);
+            connection->keepaliveTimeout = std::chrono::seconds((std::max)(keepalive, int64_t(1)));
+            stats_.OnRecovered();
+            StartupTimeline::Get().Mark(StartupTimeline::EventSubWelcomed);
+
+            std::shared_ptr<Connection> previous;
+            bool handover = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                backoff_.Reset();
+                sessionId_ = sessionId;
+                handover = connection == reconnecting_.get();
+                if (handover) {
+                    previous = std::move(active_);
+                    active_ = std::move(reconnecting_);
+                    activeClosed_ = false;
+                }
+            }
+
+            // Subscriptions move with the session on a reconnect; nothing to re-create
+            if (handover) {
+                LOG("EventSub reconnected, session {}", sessionId);
+                if (previous) {
+                    Retire(previous);
+                }
+                return 0;
+            }
 
-std::string TwitchEventSub::ReceiveFrame() {
-    unsigned char header[2];
-    if (SSL_read(ssl_, header, 2) != 2) {
-        return "";
-    }
-
-    int opcode = header[0] & 0x0F;
-    bool masked = (header[1] & 0x80) != 0;
-    uint64_t payloadLen = header[1] & 0x7F;
-
-    if (payloadLen == 126) {
-        unsigned char extLen[2];
-        SSL_read(ssl_, extLen, 2);
-        payloadLen = (extLen[0] << 8) | extLen[1];
-    } else if (payloadLen == 127) {
-        unsigned char extLen[8];
-        SSL_read(ssl_, extLen, 8);
-        payloadLen = 0;
-        for (int i = 0; i < 8; ++i) {
-            payloadLen = (payloadLen << 8) | extLen[i];
+            // Subscribe on a worker to not block the read loop
+            AsyncExecutor::Get().Submit([weak = weak_from_this(), sessionId]() {
+                if (auto self = weak.lock()) {
+                    self->RegisterSubscriptions(sessionId);
+                }
+            });
         }
+        return 0;
     }
 
-    unsigned char mask[4] = {0};
-    if (masked) {
-        SSL_read(ssl_, mask, 4);
+    // Twitch is moving this session to another server
+    if (message.messageType == "session_reconnect") {
+        std::string url = Json::Find(message.session, "reconnect_url").ToString();
+        if (!url.empty()) {
+            LOG("EventSub session_reconnect to {}", url);
+            AsyncExecutor::Get().Submit([weak = weak_from_this(), url]() {
+                if (auto self = weak.lock()) {
+                    self->Reconnect(url);
+                }
+            });
+        }
+        return 0;
     }
 
-    std::string payload;
-    payload.resize(static_cast<size_t>(payloadLen));
-    if (payloadLen > 0) {
-        SSL_read(ssl_, &payload[0], static_cast<int>(payloadLen));
-        if (masked) {
-            for (size_t i = 0; i < payload.size(); ++i) {
-                payload[i] ^= mask[i % 4];
+    // Twitch dropped a subscription (auth revoked, user removed...)
+    if (message.messageType == "revocation") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& subscription : subscriptions_) {
+            if (subscription->twitchId == message.subscriptionId) {
+                subscription->twitchId.clear();
+                subscription->active = false;
             }
         }
     }
+    return 0;
+}
 
-    // Handle ping - respond with pong
-    if (opcode == 0x09) {
-        std::vector<unsigned char> pong;
-        pong.push_back(0x8A); // Pong frame
-        pong.push_back(0x80); // Masked, zero length
-        unsigned char pongMask[4] = {0, 0, 0, 0};
-        pong.insert(pong.end(), pongMask, pongMask + 4);
-        SSL_write(ssl_, pong.data(), static_cast<int>(pong.size()));
-        return "";
+size_t TwitchEventSub::Dispatch(const EventSubMessage& message) {
+    // Handlers run unlocked; Unsubscribe() waits for the count to drop
+    std::vector<std::shared_ptr<Subscription>> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& subscription : subscriptions_) {
+            if (subscription->type == message.subscriptionType) {
+                subscription->dispatching++;
+                targets.push_back(subscription);
+            }
+        }
     }
 
-    // Close frame
-    if (opcode == 0x08) {
-        connected_ = false;
-        return "";
+    for (const auto& subscription : targets) {
+        subscription->handler(message);
     }
 
-    return payload;
-}
-
-std::string TwitchEventSub::ParseJsonString(const std::string& json, const std::string& key) {
-    std::string searchKey = "\"" + key + "\":\"";
-    size_t pos = json.find(searchKey);
-    if (pos == std::string::npos) {
-        // Try without quotes for nested objects
-        searchKey = "\"" + key + "\":";
-        pos = json.find(searchKey);
-        if (pos == std::string::npos) return "";
-        
-        size_t start = pos + searchKey.length();
-        if (start < json.length() && json[start] == '"') {
-            start++;
-            size_t end = json.find('"', start);
-            if (end != std::string::npos) {
-                return json.substr(start, end - start);
+    if (!targets.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& subscription : targets) {
+                subscription->dispatching--;
             }
         }
-        return "";
-    }
-    
-    size_t start = pos + searchKey.length();
-    size_t end = json.find('"', start);
-    if (end == std::string::npos) return "";
-    
-    return json.substr(start, end - start);
+        dispatchDone_.notify_all();
+    }
+    return targets.size();
 }
 
-bool TwitchEventSub::SubscribeToChatMessages(const std::string& sessionId) {
-    //LOG("Subscribing to chat messages with session: {}", sessionId);
-    
-    // Use httplib to make the subscription request
-    httplib::SSLClient client("api.twitch.tv");
-    client.set_connection_timeout(10);
-    client.set_read_timeout(10);
-    
-    httplib::Headers headers = {
-        {"Authorization", "Bearer " + accessToken_},
-        {"Client-Id", clientId_},
-        {"Content-Type", "application/json"}
-    };
-    
-    // Build subscription request JSON
-    std::ostringstream json;
-    json << "{"
-         << "\"type\":\"channel.chat.message\","
-         << "\"version\":\"1\","
-         << "\"condition\":{"
-         << "\"broadcaster_user_id\":\"" << broadcasterId_ << "\","
-         << "\"user_id\":\"" << userId_ << "\""
-         << "},"
-         << "\"transport\":{"
-         << "\"method\":\"websocket\","
-         << "\"session_id\":\"" << sessionId << "\""
-         << "}"
-         << "}";
-    
-    //LOG("Subscription request: {}", json.str());
-    
-    auto result = client.Post("/helix/eventsub/subscriptions", headers, json.str(), "application/json");
-    
-    if (!result) {
-        //LOG("Subscription request failed - no response");
+size_t TwitchEventSub::Replay(std::string_view payload, NetReactor::Clock::time_point received) {
+    return HandleMessage(nullptr, payload, received);
+}
+
+bool TwitchEventSub::RememberMessageId(std::string_view messageId) {
+    if (messageId.empty()) {
+        return true;
+    }
+
+    std::string id(messageId);
+    if (!recentMessageIdSet_.insert(id).second) {
         return false;
     }
-    
-    //LOG("Subscription response: {} - {}", result->status, result->body);
-    
-    if (result->status == 202) {
-        //LOG("Successfully subscribed to chat messages");
-        return true;
+
+    recentMessageIds_.push_back(std::move(id));
+    if (recentMessageIds_.size() > kDedupWindow) {
+        recentMessageIdSet_.erase(recentMessageIds_.front());
+        recentMessageIds_.pop_front();
     }
-    
-    //LOG("Subscription failed with status {}", result->status);
-    return false;
+    return true;
 }
 
-void TwitchEventSub::HandleMessage(const std::string& payload) {
-    //LOG("EventSub message: {}", payload);
-    
-    // Handle session_welcome
-    if (payload.find("\"session_welcome\"") != std::string::npos || 
-        payload.find("\"message_type\":\"session_welcome\"") != std::string::npos) {
-        std::string sessionId = ParseJsonString(payload, "id");
-        if (!sessionId.empty()) {
-            //LOG("Received session_welcome with id: {}", sessionId);
-            // Subscribe in a separate thread to not block the read loop
-            std::thread([this, sessionId]() {
-                SubscribeToChatMessages(sessionId);
-            }).detach();
+void TwitchEventSub::OnConnectionReadable(Connection& connection) {
+    bool open = connection.transport.ReadMessages([this, &connection](const WebSocketFrame& message) {
+        // Retired by an earlier message in this read (a handler disconnecting); the
+        // transport stays open until the posted close, but nothing more is delivered
+        if (connection.retired) {
+            return;
         }
-        return;
+        NetReactor::Clock::time_point received = NetReactor::Clock::now();
+        SessionCapture::Get().Write(SessionCapture::EventSub, received, message.payload);
+        HandleMessage(&connection, message.payload, received);
+    });
+
+    if (!open && !connection.retired) {
+        OnConnectionLost(connection, false);
     }
-    
-    // Handle session_keepalive - just ignore, connection is alive
-    if (payload.find("\"session_keepalive\"") != std::string::npos) {
-        return;
+}
+
+void TwitchEventSub::OnConnectionTick(Connection& connection, NetReactor::Clock::time_point now) {
+    // Twitch sends a keepalive whenever a session is otherwise quiet for
+    // keepalive_timeout_seconds, so silence past that means the connection is dead
+    std::chrono::seconds timeout = connection.keepaliveTimeout.count() > 0
+        ? connection.keepaliveTimeout + kKeepaliveGrace
+        : kWelcomeTimeout;
+
+    if (now - connection.lastMessage > timeout) {
+        LOG("EventSub connection stalled");
+        OnConnectionLost(connection, true);
     }
-    
-    // Handle notification (chat message)
-    if (payload.find("\"notification\"") != std::string::npos && 
-        payload.find("\"channel.chat.message\"") != std::string::npos) {
-        
-        // Parse the chat message from the event
-        std::string chatterName = ParseJsonString(payload, "chatter_user_name");
-        std::string messageText = ParseJsonString(payload, "message_text");
-        
-        // If message_text not found, try just "text" in message object
-        if (messageText.empty()) {
-            size_t messagePos = payload.find("\"message\":{");
-            if (messagePos != std::string::npos) {
-                std::string messageSection = payload.substr(messagePos);
-                messageText = ParseJsonString(messageSection, "text");
+}
+
+void TwitchEventSub::OnConnectionLost(Connection& connection, bool stalled) {
+    NetReactor::Get().Remove(&connection);
+
+    std::shared_ptr<Connection> finished;
+    std::shared_ptr<Connection> closedActive;
+    bool lost = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (&connection == reconnecting_.get()) {
+            // The replacement failed before its welcome. The current one carries on,
+            // unless it has already closed too, in which case the session is gone.
+            finished = std::move(reconnecting_);
+            if (activeClosed_) {
+                lost = connected_.exchange(false);
+                closedActive = std::move(active_);
+                activeClosed_ = false;
+                prewarm_ = false;
             }
+        } else if (&connection == active_.get() && reconnecting_) {
+            // The old server closing first is expected; the replacement's welcome
+            // retires this one, and its failure ends the session
+            activeClosed_ = true;
+        } else if (&connection == active_.get()) {
+            lost = connected_.exchange(false);
+            finished = std::move(active_);
+            prewarm_ = false;
         }
-        
-        if (!chatterName.empty() && !messageText.empty() && messageCallback_) {
-            messageCallback_(chatterName, messageText);
+    }
+
+    for (const auto& retired : { finished, closedActive }) {
+        if (retired) {
+            Retire(retired);
         }
-        return;
+    }
+    if (lost) {
+        LOG("EventSub connection lost");
+        ResetSession();
+        stats_.OnDropped(stalled);
+        ScheduleReconnect();
     }
 }
 
-void TwitchEventSub::ReadLoop() {
-    while (connected_) {
-        std::string frame = ReceiveFrame();
-        if (frame.empty()) {
-            continue;
+void TwitchEventSub::ScheduleReconnect() {
+    std::chrono::milliseconds delay;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (subscriptions_.empty()) {
+            return;
         }
-        
-        HandleMessage(frame);
+        delay = backoff_.Next();
     }
-}
\ No newline at end of file
+
+    LOG("EventSub reconnecting in {} ms", delay.count());
+    uint64_t generation = generation_.load();
+    NetReactor::Get().PostAfter(delay, [weak = weak_from_this(), generation]() {
+        auto self = weak.lock();
+        if (!self) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(self->mutex_);
+            if (generation != self->generation_.load() || self->subscriptions_.empty() ||
+                self->connected_ || self->connecting_.exchange(true)) {
+                return;
+            }
+        }
+
+        AsyncExecutor::Get().Submit([weak]() {
+            if (auto self = weak.lock(); self && !self->Connect()) {
+                self->ScheduleReconnect();
+            }
+        });
+    });
+}
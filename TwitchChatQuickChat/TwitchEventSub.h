@@ -1,48 +1,168 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <functional>
-#include <thread>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include <cstdint>
 
-#define WIN32_LEAN_AND_MEAN
-#include <WinSock2.h>
-#include <WS2tcpip.h>
-#include <openssl/ssl.h>
-#include <openssl/err.h>
+#include "WebSocketTransport.h"
+#include "NetReactor.h"
+#include "HelixClient.h"
+#include "EventSubMessage.h"
+#include "ReconnectPolicy.h"
+#include "LatencyHistogram.h"
 
-#pragma comment(lib, "ws2_32.lib")
-
-class TwitchEventSub {
+// One EventSub WebSocket session shared by every feature that needs Twitch events.
+//
+// Features register the event types they want; the session is opened with the first
+// subscription, every subscription is created with Helix once the session is welcomed,
+// and the socket is closed again when the last one is removed.
+//
+// When Twitch sends session_reconnect, a second connection is opened to the given URL
+// while the first keeps delivering; once the new one is welcomed it takes over and the
+// old one is closed. Subscriptions carry over, and notifications seen on both during
+// the overlap are dropped by message_id.
+//
+// A watchdog on the reactor tick treats a connection as dead when nothing (not even a
+// keepalive) arrives within the session's keepalive_timeout_seconds plus some grace.
+// Lost sessions are reopened with jittered exponential backoff.
+//
+// Must be owned by a shared_ptr: queued work and reactor timers hold a weak_ptr,
+// so they do nothing once the object is gone.
+class TwitchEventSub : public std::enable_shared_from_this<TwitchEventSub> {
 public:
-    using MessageCallback = std::function<void(const std::string& username, const std::string& message)>;
+    // Called on the network thread; the message only lives for the duration of the call
+    using EventHandler = std::function<void(const EventSubMessage& message)>;
+    using SubscriptionId = uint64_t;
+
+    // Where sessions are opened; tests point this at a local server
+    struct Endpoint {
+        std::string host = "eventsub.wss.twitch.tv";
+        std::string path = "/ws";
+        std::string port = "443";
+    };
 
-    TwitchEventSub();
+    explicit TwitchEventSub(std::shared_ptr<HelixClient> helix);
+    TwitchEventSub(std::shared_ptr<HelixClient> helix, Endpoint endpoint);
     ~TwitchEventSub();
 
-    bool Connect(const std::string& accessToken, const std::string& clientId, 
-                 const std::string& userId, const std::string& broadcasterId);
+    // conditionJson is the subscription's "condition" object, e.g. {"broadcaster_user_id":"123"}
+    SubscriptionId Subscribe(const std::string& type, const std::string& version,
+                             const std::string& conditionJson, EventHandler handler);
+    // Once this returns the handler isn't running and won't be called again. From a
+    // handler (the network thread) it can't wait, so later handlers may still be called.
+    void Unsubscribe(SubscriptionId id);
+    // True once Helix has accepted the subscription on the current session
+    bool IsSubscribed(SubscriptionId id) const;
+
+    // Opens the session ahead of the first Subscribe() so the handshake overlaps with
+    // lookups still running. Twitch closes sessions that get no subscription within
+    // a few seconds of the welcome, and such a session isn't reopened.
+    void Prewarm();
+
     void Disconnect();
     bool IsConnected() const;
-    void SetMessageCallback(MessageCallback callback);
+
+    ReconnectStats::Snapshot GetReconnectStats() const { return stats_.Get(); }
+    // Notification message_timestamp to our receive time; includes any clock
+    // difference between Twitch and this machine
+    LatencyHistogram& GetDeliveryDelay() { return deliveryDelay_; }
+
+    // Hands a captured message to HandleMessage as if it had just arrived, so it is
+    // deduplicated and dispatched like a live one. It came on no connection, so session
+    // messages (welcome, reconnect, revocation) are ignored and the delivery delay isn't
+    // recorded. Reactor thread only. Returns how many handlers it reached.
+    size_t Replay(std::string_view payload, NetReactor::Clock::time_point received);
 
 private:
-    void ReadLoop();
-    bool PerformWebSocketHandshake();
-    std::string ReceiveFrame();
-    void SendWebSocketFrame(const std::string& data);
-    bool SubscribeToChatMessages(const std::string& sessionId);
-    void HandleMessage(const std::string& payload);
-    std::string ParseJsonString(const std::string& json, const std::string& key);
-
-    SOCKET socket_ = INVALID_SOCKET;
-    SSL_CTX* sslCtx_ = nullptr;
-    SSL* ssl_ = nullptr;
+    // One WebSocket to EventSub; there are two only while a reconnect is in progress
+    class Connection : public NetReactor::Handler {
+    public:
+        explicit Connection(TwitchEventSub& owner) : owner_(owner) {}
+        WebSocketTransport transport;
+
+        // Watchdog state, reactor thread only after registration
+        NetReactor::Clock::time_point lastMessage;
+        std::chrono::seconds keepaliveTimeout{ 0 };     // 0 until welcomed
+        bool retired = false;                           // unregistered, close posted
+
+    private:
+        void OnReadable() override { owner_.OnConnectionReadable(*this); }
+        // ReadMessages() flushes queued output before it reads
+        bool WantsWrite() override { return transport.HasPendingWrites(); }
+        void OnWritable() override { owner_.OnConnectionReadable(*this); }
+        void OnTick(NetReactor::Clock::time_point now) override { owner_.OnConnectionTick(*this, now); }
+        TwitchEventSub& owner_;
+    };
+
+    struct Subscription {
+        SubscriptionId id = 0;
+        std::string type;
+        std::string version;
+        std::string condition;
+        EventHandler handler;
+
+        // Per-session state
+        std::string twitchId;
+        bool active = false;
+        std::string registering;    // session a create request is in flight for
+
+        int dispatching = 0;        // handler calls in progress, guarded by mutex_
+    };
+
+    bool Connect();
+    void Reconnect(const std::string& url);
+    // Unregisters a connection that is no longer current and closes it on the reactor thread
+    static void Retire(std::shared_ptr<Connection> connection);
+    void OnConnectionReadable(Connection& connection);
+    void OnConnectionTick(Connection& connection, NetReactor::Clock::time_point now);
+    // The connection closed or stalled; reconnects if it was carrying the session
+    void OnConnectionLost(Connection& connection, bool stalled);
+    void ScheduleReconnect();
+    void RegisterSubscriptions(const std::string& sessionId);
+    bool CreateSubscription(const std::string& sessionId, const Subscription& subscription, std::string& twitchId);
+    // Every received message goes through here: live ones with the connection they came
+    // on, replayed ones with none. Returns how many handlers it reached.
+    size_t HandleMessage(Connection* connection, std::string_view payload, NetReactor::Clock::time_point received);
+    // Calls every handler subscribed to the notification's type; returns how many
+    size_t Dispatch(const EventSubMessage& message);
+    // False if this notification was already delivered (reactor thread only)
+    bool RememberMessageId(std::string_view messageId);
+    void ResetSession();
+
+    std::shared_ptr<HelixClient> helix_;
+    Endpoint endpoint_;
     std::atomic<bool> connected_{ false };
-    std::thread readThread_;
-    MessageCallback messageCallback_;
-    
-    std::string accessToken_;
-    std::string clientId_;
-    std::string userId_;
-    std::string broadcasterId_;
-};
\ No newline at end of file
+    std::atomic<bool> connecting_{ false };
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Subscription>> subscriptions_;
+    std::condition_variable dispatchDone_;
+    SubscriptionId nextId_ = 1;
+    std::string sessionId_;
+    std::shared_ptr<Connection> active_;
+    std::shared_ptr<Connection> reconnecting_;
+    bool activeClosed_ = false; // active_ closed while reconnecting_ waits for its welcome
+    bool prewarm_ = false;      // keep the session open with no subscriptions yet
+
+    // Extra time past keepalive_timeout_seconds before a session counts as stalled,
+    // and how long a fresh connection may take to be welcomed
+    static constexpr std::chrono::seconds kKeepaliveGrace{ 5 };
+    static constexpr std::chrono::seconds kWelcomeTimeout{ 15 };
+    ReconnectBackoff backoff_;          // guarded by mutex_
+    ReconnectStats stats_;
+    LatencyHistogram deliveryDelay_;
+    // Bumped by Disconnect() so pending reconnect timers know they're stale
+    std::atomic<uint64_t> generation_{ 0 };
+
+    // Recently delivered notification ids, oldest first
+    static constexpr size_t kDedupWindow = 256;
+    std::deque<std::string> recentMessageIds_;
+    std::unordered_set<std::string> recentMessageIdSet_;
+};
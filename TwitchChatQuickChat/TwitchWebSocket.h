@@ -1,44 +1,73 @@
-#pragma once
-#include <string>
-#include <functional>
-#include <thread>
-#include <atomic>
-
-#define WIN32_LEAN_AND_MEAN
-#include <WinSock2.h>
-#include <WS2tcpip.h>
-#include <openssl/ssl.h>
-#include <openssl/err.h>
-
-#pragma comment(lib, "ws2_32.lib")
-
-class TwitchWebSocket {
-public:
-    using MessageCallback = std::function<void(const std::string&)>;
-
-    TwitchWebSocket();
-    ~TwitchWebSocket();
-
-    bool Connect(const std::string& accessToken, const std::string& nickname, const std::string& channel);
-    void Disconnect();
-    bool IsConnected() const;
-    void SetMessageCallback(MessageCallback callback);
-    bool SendMessage(const std::string& channel, const std::string& message);
-
-private:
-    void ReadLoop();
-    bool PerformWebSocketHandshake();
-    bool SendRaw(const std::string& data);
-    std::string ReceiveFrame();
-    void SendWebSocketFrame(const std::string& data);
-
-    SOCKET socket_ = INVALID_SOCKET;
-    SSL_CTX* sslCtx_ = nullptr;
-    SSL* ssl_ = nullptr;
-    std::atomic<bool> connected_{ false };
-    std::thread readThread_;
-    MessageCallback messageCallback_;
-    std::string accessToken_;
-    std::string nickname_;
-    std::string channel_;
+#pragma once
+#include <string>
+#include <string_view>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#include "WebSocketTransport.h"
+#include "NetReactor.h"
+#include "IrcMessage.h"
+#include "ReconnectPolicy.h"
+
+// Twitch IRC over WebSocket.
+//
+// Twitch PINGs roughly every five minutes, which is too slow to notice a dead socket,
+// so when the line has been quiet for a while we PING the server ourselves; no reply
+// within kPongTimeout counts as a stall. Dropped and stalled connections rejoin with
+// jittered exponential backoff.
+//
+// Must be owned by a shared_ptr: reconnect timers and queued work hold a weak_ptr,
+// so they do nothing once the object is gone.
+class TwitchWebSocket : public NetReactor::Handler, public std::enable_shared_from_this<TwitchWebSocket> {
+public:
+    // Called on the network thread for each PRIVMSG line; the message only lives for the call
+    using MessageCallback = std::function<void(const IrcMessage& message)>;
+
+    TwitchWebSocket();
+    ~TwitchWebSocket();
+
+    bool Connect(const std::string& accessToken, const std::string& nickname, const std::string& channel);
+    void Disconnect();
+    bool IsConnected() const;
+    void SetMessageCallback(MessageCallback callback);
+    bool SendMessage(const std::string& channel, const std::string& message);
+
+    ReconnectStats::Snapshot GetReconnectStats() const { return stats_.Get(); }
+
+    // Hands a captured frame to the same line handling as a live one. It came on no
+    // connection, so PINGs aren't answered and a welcome doesn't reset the reconnect
+    // state. Reactor thread only. Returns how many PRIVMSGs reached the callback.
+    size_t Replay(std::string_view frame);
+
+private:
+    void OnReadable() override;
+    // ReadMessages() flushes queued output before it reads
+    bool WantsWrite() override { return transport_.HasPendingWrites(); }
+    void OnWritable() override { OnReadable(); }
+    void OnTick(NetReactor::Clock::time_point now) override;
+    void OnConnectionLost(bool stalled);
+    void ScheduleReconnect();
+    // live is false for replayed frames; both return how many PRIVMSGs were delivered
+    size_t HandleIrcFrame(std::string_view frame, bool live);
+    bool HandleIrcLine(const IrcMessage& message, bool live);
+
+    WebSocketTransport transport_;
+    std::atomic<bool> connected_{ false };
+    MessageCallback messageCallback_;
+    std::string accessToken_;
+    std::string nickname_;
+    std::string channel_;
+
+    static constexpr std::chrono::seconds kIdleBeforePing{ 60 };
+    static constexpr std::chrono::seconds kPongTimeout{ 10 };
+    // Reactor thread only after registration
+    NetReactor::Clock::time_point lastReceived_;
+    bool pingPending_ = false;
+
+    ReconnectBackoff backoff_;          // reactor thread only
+    ReconnectStats stats_;
+    // Bumped by Disconnect() so pending reconnect timers know they're stale
+    std::atomic<uint64_t> generation_{ 0 };
 };
\ No newline at end of file
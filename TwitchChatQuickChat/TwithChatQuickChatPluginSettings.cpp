@@ -1,11 +1,14 @@
 # include "pch.h"
 # include "TwitchChatQuickChat.h"
+# include "FilePath.h"
 
 void TwitchChatQuickChat::RenderSettings() {
     // Login section
     if (!login_ || !login_->IsLoggedIn()) {
         if (login_ && login_->IsAuthenticating()) {
             ImGui::TextUnformatted("Authenticating... Please complete login in your browser.");
+        } else if (login_ && login_->IsRestoring()) {
+            ImGui::TextUnformatted("Restoring saved login...");
         } else {
             if (ImGui::Button("Login with Twitch")) {
                 login_->StartOAuthFlow([this](bool success) {
@@ -45,6 +48,105 @@ void TwitchChatQuickChat::RenderSettings() {
                 }
             }
 
+            CVarWrapper budgetCvar = cvarManager->getCvar("twitchChatQuickChat_chat_frame_budget");
+            if (budgetCvar) {
+                int frameBudget = budgetCvar.getIntValue();
+                if (ImGui::SliderInt("Messages per frame", &frameBudget, 1, 100)) {
+                    budgetCvar.setValue(frameBudget);
+                }
+                if (ImGui::IsItemDeactivatedAfterEdit()) {
+                    cvarManager->backupCfg("twitchChatQuickChat.cfg");
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Limits how many chat messages are shown each frame; the rest wait for the next frame");
+                }
+            }
+
+            ImGui::Spacing();
+            ImGui::TextUnformatted("Flood control");
+
+            CVarWrapper rateCvar = cvarManager->getCvar("twitchChatQuickChat_chat_max_per_second");
+            if (rateCvar) {
+                int maxPerSecond = rateCvar.getIntValue();
+                if (ImGui::SliderInt("Messages per second", &maxPerSecond, 0, 50, maxPerSecond == 0 ? "Unlimited" : "%d")) {
+                    rateCvar.setValue(maxPerSecond);
+                }
+                if (ImGui::IsItemDeactivatedAfterEdit()) {
+                    cvarManager->backupCfg("twitchChatQuickChat.cfg");
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Messages over this rate wait in a short backlog; 0 shows everything");
+                }
+            }
+
+            CVarWrapper policyCvar = cvarManager->getCvar("twitchChatQuickChat_chat_overflow_policy");
+            if (policyCvar) {
+                int policy = policyCvar.getIntValue();
+                const char* policies[] = { "Drop oldest", "Sample 1-in-N" };
+                if (ImGui::Combo("When backed up", &policy, policies, IM_ARRAYSIZE(policies))) {
+                    policyCvar.setValue(policy);
+                    cvarManager->backupCfg("twitchChatQuickChat.cfg");
+                }
+
+                CVarWrapper sampleCvar = cvarManager->getCvar("twitchChatQuickChat_chat_sample_every");
+                if (policy == 1 && sampleCvar) {
+                    int sampleEvery = sampleCvar.getIntValue();
+                    if (ImGui::SliderInt("Show 1 in N", &sampleEvery, 2, 100)) {
+                        sampleCvar.setValue(sampleEvery);
+                    }
+                    if (ImGui::IsItemDeactivatedAfterEdit()) {
+                        cvarManager->backupCfg("twitchChatQuickChat.cfg");
+                    }
+                }
+            }
+
+            CVarWrapper collapseCvar = cvarManager->getCvar("twitchChatQuickChat_chat_collapse_duplicates");
+            if (collapseCvar) {
+                bool collapse = collapseCvar.getBoolValue();
+                if (ImGui::Checkbox("Collapse duplicates", &collapse)) {
+                    collapseCvar.setValue(collapse);
+                    cvarManager->backupCfg("twitchChatQuickChat.cfg");
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Identical messages within about a second are shown once with a count, e.g. \"PogChamp x37\"");
+                }
+            }
+
+            CVarWrapper userCapCvar = cvarManager->getCvar("twitchChatQuickChat_chat_user_cap");
+            if (userCapCvar) {
+                int userCap = userCapCvar.getIntValue();
+                if (ImGui::SliderInt("Per-user cap (10s)", &userCap, 0, 20, userCap == 0 ? "Unlimited" : "%d")) {
+                    userCapCvar.setValue(userCap);
+                }
+                if (ImGui::IsItemDeactivatedAfterEdit()) {
+                    cvarManager->backupCfg("twitchChatQuickChat.cfg");
+                }
+            }
+
+            if (chat_) {
+                ChatFloodControl::Stats stats = chat_->GetFloodStats();
+                uint64_t dropped = stats.droppedUserCap + stats.droppedSampled + stats.droppedOverflow + stats.droppedQueueFull;
+                ImGui::Text("Shown: %llu  Merged: %llu  Dropped: %llu",
+                    (unsigned long long)stats.shown, (unsigned long long)stats.merged, (unsigned long long)dropped);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Dropped by user cap: %llu\nSampled out: %llu\nBacklog full: %llu\nQueue full: %llu",
+                        (unsigned long long)stats.droppedUserCap, (unsigned long long)stats.droppedSampled,
+                        (unsigned long long)stats.droppedOverflow, (unsigned long long)stats.droppedQueueFull);
+                }
+            }
+
+            if (eventSub_) {
+                ReconnectStats::Snapshot reconnects = eventSub_->GetReconnectStats();
+                ImGui::Text("EventSub: %s  Reconnects: %llu  Drops: %llu (%llu stalled)",
+                    reconnects.down ? "reconnecting" : (eventSub_->IsConnected() ? "connected" : "idle"),
+                    (unsigned long long)reconnects.reconnects, (unsigned long long)reconnects.drops,
+                    (unsigned long long)reconnects.stalls);
+                if (reconnects.lastRecoveryMs >= 0 && ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Last recovery: %lld ms\nSlowest recovery: %lld ms",
+                        (long long)reconnects.lastRecoveryMs, (long long)reconnects.maxRecoveryMs);
+                }
+            }
+
             ImGui::EndTabItem();
         }
 
@@ -69,6 +171,87 @@ void TwitchChatQuickChat::RenderSettings() {
             ImGui::EndTabItem();
         }
 
+        // Diagnostics Tab
+        if (ImGui::BeginTabItem("Diagnostics")) {
+            ImGui::TextUnformatted("Where chat messages spend their time, since the plugin loaded");
+            ImGui::Spacing();
+
+            struct Row {
+                const char* name;
+                const char* tooltip;
+                LatencyHistogram* histogram;
+            };
+            Row rows[] = {
+                { "Socket -> parsed", "Frame read to chat event parsed, on the network thread",
+                    chat_ ? &chat_->GetLatency(Chat::SocketToParsed) : nullptr },
+                { "Parsed -> game thread", "Queued until the game thread picks the message up",
+                    chat_ ? &chat_->GetLatency(Chat::ParsedToGameThread) : nullptr },
+                { "Game thread -> chatbox", "Held by flood control, then written to the chatbox",
+                    chat_ ? &chat_->GetLatency(Chat::GameThreadToChatbox) : nullptr },
+                { "Socket -> chatbox", "The whole way through the plugin",
+                    chat_ ? &chat_->GetLatency(Chat::SocketToChatbox) : nullptr },
+                { "Twitch -> socket", "EventSub message_timestamp to receive time; includes any clock difference with Twitch",
+                    eventSub_ ? &eventSub_->GetDeliveryDelay() : nullptr },
+            };
+
+            ImGui::Columns(6, "LatencyColumns");
+            for (const char* header : { "Stage", "Count", "p50 ms", "p99 ms", "p99.9 ms", "Max ms" }) {
+                ImGui::TextUnformatted(header);
+                ImGui::NextColumn();
+            }
+            ImGui::Separator();
+            for (const Row& row : rows) {
+                LatencyHistogram::Snapshot snapshot = row.histogram ? row.histogram->GetSnapshot() : LatencyHistogram::Snapshot();
+                ImGui::TextUnformatted(row.name);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("%s", row.tooltip);
+                }
+                ImGui::NextColumn();
+                ImGui::Text("%llu", (unsigned long long)snapshot.count);
+                ImGui::NextColumn();
+                for (int64_t value : { snapshot.p50Us, snapshot.p99Us, snapshot.p999Us, snapshot.maxUs }) {
+                    ImGui::Text("%.2f", value / 1000.0);
+                    ImGui::NextColumn();
+                }
+            }
+            ImGui::Columns(1);
+
+            ImGui::Spacing();
+            if (ImGui::Button("Export JSON")) {
+                std::filesystem::path path = ExportLatency();
+                cvarManager->log(path.empty() ? "Couldn't write latency.json" : "Latency histograms written to " + FilePath::ToString(path));
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Writes every histogram to latency.json in the BakkesMod data folder");
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Reset")) {
+                for (const Row& row : rows) {
+                    if (row.histogram) {
+                        row.histogram->Reset();
+                    }
+                }
+            }
+
+            ImGui::Spacing();
+            CVarWrapper traceCvar = cvarManager->getCvar("twitchChatQuickChat_trace");
+            if (traceCvar) {
+                bool tracing = traceCvar.getBoolValue();
+                if (ImGui::Checkbox("Record trace", &tracing)) {
+                    traceCvar.setValue(tracing);
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Keeps the last spans of every plugin thread: connects, handshakes, Helix calls, message handling");
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Export trace")) {
+                    cvarManager->executeCommand("twitchChatQuickChat_export_trace");
+                }
+            }
+
+            ImGui::EndTabItem();
+        }
+
         ImGui::EndTabBar();
     }
 }
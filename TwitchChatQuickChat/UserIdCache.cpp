@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "UserIdCache.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+UserIdCache::UserIdCache(std::filesystem::path file)
+    : file_(std::move(file))
+{
+    Load();
+}
+
+UserIdCache::Lookup UserIdCache::Find(const std::string& login) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(login);
+    if (it == entries_.end()) {
+        return {};
+    }
+
+    int64_t age = Now() - it->second.fetchedAt;
+    if (age > kExpireAfterSeconds) {
+        return {};
+    }
+    return { it->second.id, age > kRefreshAfterSeconds };
+}
+
+void UserIdCache::Store(const std::string& login, const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[login];
+    entry.id = id;
+    entry.fetchedAt = Now();
+    dirty_ = true;
+
+    // Channels looked at once long ago go first
+    while (entries_.size() > kMaxEntries) {
+        auto oldest = std::min_element(entries_.begin(), entries_.end(),
+            [](const auto& a, const auto& b) { return a.second.fetchedAt < b.second.fetchedAt; });
+        entries_.erase(oldest);
+    }
+}
+
+void UserIdCache::Save() {
+    // Lookups on different workers can save at once; they share the temp file, and
+    // the newest snapshot has to be the one renamed in last
+    std::lock_guard<std::mutex> saveLock(saveMutex_);
+
+    std::ostringstream out;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!dirty_) {
+            return;
+        }
+        // Stores made while writing mark it dirty again for the next save
+        dirty_ = false;
+
+        // One "login id fetchedAt" per line
+        for (const auto& [login, entry] : entries_) {
+            out << login << ' ' << entry.id << ' ' << entry.fetchedAt << '\n';
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(file_.parent_path(), error);
+
+    std::filesystem::path temp = file_;
+    temp += ".tmp";
+    bool written = false;
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        file << out.str();
+        file.close();
+        written = !file.fail();
+    }
+    if (written) {
+        std::filesystem::rename(temp, file_, error);
+    }
+
+    if (!written || error) {
+        // Try again on the next save
+        std::lock_guard<std::mutex> lock(mutex_);
+        dirty_ = true;
+    }
+}
+
+void UserIdCache::Load() {
+    std::ifstream file(file_);
+    std::string login;
+    std::string id;
+    int64_t fetchedAt = 0;
+    while (file >> login >> id >> fetchedAt) {
+        entries_[login] = { id, fetchedAt };
+    }
+}
+
+int64_t UserIdCache::Now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
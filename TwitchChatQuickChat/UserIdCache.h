@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <filesystem>
+#include <cstdint>
+
+// Twitch login -> user id, kept on disk between sessions.
+//
+// Ids never change, but a login can be given up and reused by another account, so
+// entries are refreshed in the background once they're a day old and no longer
+// trusted after kExpireAfter.
+class UserIdCache
+{
+public:
+    static constexpr int64_t kRefreshAfterSeconds = 24 * 60 * 60;
+    static constexpr int64_t kExpireAfterSeconds = 30 * 24 * 60 * 60;
+    static constexpr size_t kMaxEntries = 256;
+
+    struct Lookup {
+        std::string id;         // empty on a miss
+        bool stale = false;     // usable, but due for a refresh
+    };
+
+    explicit UserIdCache(std::filesystem::path file);
+
+    // login must already be lowercase
+    Lookup Find(const std::string& login) const;
+    void Store(const std::string& login, const std::string& id);
+
+    // Writes the cache out if anything changed since the last successful save
+    void Save();
+
+private:
+    struct Entry {
+        std::string id;
+        int64_t fetchedAt = 0;  // unix seconds
+    };
+
+    static int64_t Now();
+    void Load();
+
+    std::filesystem::path file_;
+    mutable std::mutex mutex_;
+    // Held for a whole Save(), so two saves never write the temp file at once
+    std::mutex saveMutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    bool dirty_ = false;
+};
@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "WebSocketFrame.h"
+#include "WebSocketMask.h"
+#include <cstring>
+
+WebSocketFrameReader::WebSocketFrameReader(size_t initialCapacity)
+    : buffer_(initialCapacity) {
+}
+
+char* WebSocketFrameReader::Prepare(size_t minSpace) {
+    if (buffer_.size() - writePos_ < minSpace) {
+        // Slide unread bytes to the front before growing
+        size_t pending = writePos_ - readPos_;
+        if (readPos_ > 0) {
+            if (pending > 0) {
+                std::memmove(buffer_.data(), buffer_.data() + readPos_, pending);
+            }
+            readPos_ = 0;
+            writePos_ = pending;
+        }
+        if (buffer_.size() - writePos_ < minSpace) {
+            buffer_.resize(writePos_ + minSpace);
+        }
+    }
+    return buffer_.data() + writePos_;
+}
+
+void WebSocketFrameReader::Commit(size_t count) {
+    writePos_ += count;
+}
+
+bool WebSocketFrameReader::Next(WebSocketFrame& frame) {
+    while (!error_) {
+        size_t available = writePos_ - readPos_;
+        if (available < 2) {
+            return false;
+        }
+
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(buffer_.data() + readPos_);
+        bool fin = (header[0] & 0x80) != 0;
+        uint8_t opcode = header[0] & 0x0F;
+        bool masked = (header[1] & 0x80) != 0;
+        uint64_t payloadLen = header[1] & 0x7F;
+
+        size_t headerLen = 2;
+        if (payloadLen == 126) {
+            headerLen += 2;
+        } else if (payloadLen == 127) {
+            headerLen += 8;
+        }
+        if (masked) {
+            headerLen += 4;
+        }
+        if (available < headerLen) {
+            return false;
+        }
+
+        if (payloadLen == 126) {
+            payloadLen = (static_cast<uint64_t>(header[2]) << 8) | header[3];
+        } else if (payloadLen == 127) {
+            payloadLen = 0;
+            for (int i = 0; i < 8; ++i) {
+                payloadLen = (payloadLen << 8) | header[2 + i];
+            }
+        }
+
+        if (payloadLen > kMaxMessageSize) {
+            error_ = true;
+            return false;
+        }
+        if (available - headerLen < payloadLen) {
+            // Make sure the whole frame fits once the rest arrives
+            Prepare(static_cast<size_t>(payloadLen) + headerLen - available);
+            return false;
+        }
+
+        char* payload = buffer_.data() + readPos_ + headerLen;
+        size_t len = static_cast<size_t>(payloadLen);
+        if (masked) {
+            const unsigned char* mask = header + headerLen - 4;
+            ApplyWebSocketMask(reinterpret_cast<unsigned char*>(payload), len, mask);
+        }
+        readPos_ += headerLen + len;
+        if (readPos_ == writePos_) {
+            readPos_ = writePos_ = 0;
+        }
+
+        // Control frames are never fragmented and may arrive mid-message
+        if (opcode & 0x08) {
+            frame.opcode = opcode;
+            frame.payload = std::string_view(payload, len);
+            return true;
+        }
+
+        if (opcode == WebSocketOpcode::Continuation) {
+            if (fragmentOpcode_ == 0 || fragments_.size() + len > kMaxMessageSize) {
+                error_ = true;
+                return false;
+            }
+            fragments_.append(payload, len);
+            if (!fin) {
+                continue;
+            }
+            frame.opcode = fragmentOpcode_;
+            frame.payload = fragments_;
+            fragmentOpcode_ = 0;
+            return true;
+        }
+
+        // A new text or binary frame while a fragmented message is still open
+        // is a protocol error (RFC 6455 5.4), not a fresh start
+        if (fragmentOpcode_ != 0) {
+            error_ = true;
+            return false;
+        }
+
+        if (!fin) {
+            fragments_.assign(payload, len);
+            fragmentOpcode_ = opcode;
+            continue;
+        }
+
+        frame.opcode = opcode;
+        frame.payload = std::string_view(payload, len);
+        return true;
+    }
+    return false;
+}
+
+void WebSocketFrameReader::Reset() {
+    readPos_ = 0;
+    writePos_ = 0;
+    fragments_.clear();
+    fragmentOpcode_ = 0;
+    error_ = false;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace WebSocketOpcode {
+    constexpr uint8_t Continuation = 0x00;
+    constexpr uint8_t Text = 0x01;
+    constexpr uint8_t Binary = 0x02;
+    constexpr uint8_t Close = 0x08;
+    constexpr uint8_t Ping = 0x09;
+    constexpr uint8_t Pong = 0x0A;
+}
+
+// A decoded WebSocket message. The payload points into the reader's buffers
+// and is only valid until the next call to Prepare() or Next().
+struct WebSocketFrame {
+    uint8_t opcode = 0;
+    std::string_view payload;
+};
+
+// Incremental RFC 6455 frame decoder.
+//
+// Callers read as much as the socket has into Prepare()/Commit() and then pull
+// every complete frame out with Next(). Partial headers and payloads simply stay
+// buffered until the rest arrives, so short reads and frames larger than one TLS
+// record are handled. Fragmented text/binary messages are reassembled; control
+// frames are returned as they arrive.
+class WebSocketFrameReader {
+public:
+    static constexpr size_t kDefaultCapacity = 16 * 1024;
+    static constexpr size_t kMaxMessageSize = 16 * 1024 * 1024;
+
+    explicit WebSocketFrameReader(size_t initialCapacity = kDefaultCapacity);
+
+    // Returns a pointer to at least minSpace writable bytes at the end of the buffer.
+    char* Prepare(size_t minSpace);
+    // Marks count bytes written through Prepare() as received.
+    void Commit(size_t count);
+
+    // Decodes the next complete message. Returns false when more data is needed
+    // or the stream is invalid (see HasError()).
+    bool Next(WebSocketFrame& frame);
+
+    bool HasError() const { return error_; }
+    size_t Buffered() const { return writePos_ - readPos_; }
+    void Reset();
+
+private:
+    std::vector<char> buffer_;
+    size_t readPos_ = 0;
+    size_t writePos_ = 0;
+
+    std::string fragments_;
+    uint8_t fragmentOpcode_ = 0;
+    bool error_ = false;
+};
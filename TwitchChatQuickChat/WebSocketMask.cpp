@@ -0,0 +1,132 @@
+#include "pch.h"
+#include "WebSocketMask.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WS_MASK_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define WS_MASK_TARGET_AVX2
+#else
+#define WS_MASK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+    // Finishes the bytes a wider kernel left over; mask repeats every 4 bytes
+    // and every kernel consumes a multiple of 4, so the tail starts at mask[0]
+    void MaskTail(unsigned char* data, size_t len, const unsigned char mask[4]) {
+        for (size_t i = 0; i < len; ++i) {
+            data[i] ^= mask[i % 4];
+        }
+    }
+
+    size_t MaskWords(unsigned char* data, size_t len, const unsigned char mask[4]) {
+        uint32_t mask32;
+        std::memcpy(&mask32, mask, 4);
+        uint64_t mask64 = (static_cast<uint64_t>(mask32) << 32) | mask32;
+
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            word ^= mask64;
+            std::memcpy(data + i, &word, 8);
+        }
+        return i;
+    }
+
+#ifdef WS_MASK_X86
+    size_t MaskSse2(unsigned char* data, size_t len, const unsigned char mask[4]) {
+        int32_t mask32;
+        std::memcpy(&mask32, mask, 4);
+        const __m128i key = _mm_set1_epi32(mask32);
+
+        size_t i = 0;
+        for (; i + 64 <= len; i += 64) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 32));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 48));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(a, key));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i + 16), _mm_xor_si128(b, key));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i + 32), _mm_xor_si128(c, key));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i + 48), _mm_xor_si128(d, key));
+        }
+        for (; i + 16 <= len; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(a, key));
+        }
+        return i;
+    }
+
+    WS_MASK_TARGET_AVX2 size_t MaskAvx2(unsigned char* data, size_t len, const unsigned char mask[4]) {
+        int32_t mask32;
+        std::memcpy(&mask32, mask, 4);
+        const __m256i key = _mm256_set1_epi32(mask32);
+
+        size_t i = 0;
+        for (; i + 128 <= len; i += 128) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 64));
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 96));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(a, key));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 32), _mm256_xor_si256(b, key));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 64), _mm256_xor_si256(c, key));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i + 96), _mm256_xor_si256(d, key));
+        }
+        for (; i + 32 <= len; i += 32) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(a, key));
+        }
+        return i;
+    }
+
+    bool CpuHasAvx2() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx) {
+            return false;
+        }
+        // The OS has to save the YMM registers on context switches
+        if ((_xgetbv(0) & 0x6) != 0x6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+} // namespace
+
+void ApplyWebSocketMask(unsigned char* data, size_t len, const unsigned char mask[4]) {
+    size_t done;
+#ifdef WS_MASK_X86
+    static const bool useAvx2 = CpuHasAvx2();
+    if (useAvx2 && len >= 32) {
+        done = MaskAvx2(data, len, mask);
+    } else {
+        // SSE2 is part of the x64 baseline
+        done = MaskSse2(data, len, mask);
+    }
+#else
+    done = 0;
+#endif
+    done += MaskWords(data + done, len - done, mask);
+    MaskTail(data + done, len - done, mask);
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <cstddef>
+
+// XORs data in place with the 4-byte WebSocket masking key (RFC 6455 5.3).
+// Masking and unmasking are the same operation. Uses AVX2 or SSE2 where the
+// CPU has them and falls back to 64-bit words otherwise.
+void ApplyWebSocketMask(unsigned char* data, size_t len, const unsigned char mask[4]);
@@ -0,0 +1,404 @@
+#include "pch.h"
+#include "WebSocketTransport.h"
+#include "WebSocketMask.h"
+#include "TlsContext.h"
+#include "HostConnector.h"
+#include "AsyncExecutor.h"
+#include "Trace.h"
+#include "logging.h"
+#include <algorithm>
+#include <random>
+#include <cstring>
+
+#ifndef _WIN32
+#define closesocket close
+#endif
+
+WebSocketTransport::WebSocketTransport() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    // Seed once per connection; masks and handshake keys come from the cheap generator below
+    std::random_device rd;
+    prngState_ = (static_cast<uint64_t>(rd()) << 32) | rd();
+    if (prngState_ == 0) {
+        prngState_ = 0x9E3779B97F4A7C15ull;
+    }
+
+    sendBuffer_.reserve(4096);
+}
+
+WebSocketTransport::~WebSocketTransport() {
+    Close();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+bool WebSocketTransport::Connect(const std::string& host, const std::string& path, const std::string& port) {
+    TraceSpan span("net", "Connect", host);
+    Close();
+
+    // Cached resolution, then IPv6 and IPv4 raced with a timeout per address
+    {
+        TraceSpan tcpSpan("net", "TcpConnect", host);
+        socket_ = HostConnector::Connect(host, port);
+    }
+    if (socket_ == INVALID_SOCKET) {
+        // HostConnector has logged why
+        return false;
+    }
+
+    // The context is shared so reconnects can resume the previous TLS session
+    ssl_ = TlsContext::Get().NewConnection(host);
+    if (!ssl_) {
+        LOG("Failed to create SSL session");
+        Close();
+        return false;
+    }
+    SSL_set_fd(ssl_, static_cast<int>(socket_));
+
+    // The socket is already non-blocking, so a silent server can't hold this thread
+    // (an executor worker that shutdown waits for) past the deadline
+    Clock::time_point deadline = Clock::now() + kHandshakeTimeout;
+    int handshake;
+    {
+        TraceSpan tlsSpan("net", "TlsHandshake", host);
+        while ((handshake = SSL_connect(ssl_)) != 1 && WaitForHandshake(handshake, deadline)) {
+        }
+    }
+    if (handshake != 1) {
+        LOG("SSL handshake failed");
+        Close();
+        return false;
+    }
+    TlsContext::Get().OnHandshakeComplete(ssl_);
+
+    frameReader_.Reset();
+
+    // Perform WebSocket handshake
+    bool upgraded;
+    {
+        TraceSpan upgradeSpan("net", "WebSocketHandshake", host);
+        upgraded = PerformHandshake(host, path, deadline);
+    }
+    if (!upgraded) {
+        LOG("WebSocket handshake failed");
+        Close();
+        return false;
+    }
+
+    // From here on the reactor drives reads and flushes queued writes
+    SSL_set_mode(ssl_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    open_ = true;
+    return true;
+}
+
+void WebSocketTransport::Close() {
+    open_ = false;
+
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    pendingWrite_.clear();
+
+    if (ssl_) {
+        SSL_shutdown(ssl_);
+        SSL_free(ssl_);
+        ssl_ = nullptr;
+    }
+
+    if (socket_ != INVALID_SOCKET) {
+        closesocket(socket_);
+        socket_ = INVALID_SOCKET;
+    }
+}
+
+uint32_t WebSocketTransport::NextRandom() {
+    // xorshift64* - masking keys only need to be unpredictable to intermediaries, not cryptographic
+    prngState_ ^= prngState_ >> 12;
+    prngState_ ^= prngState_ << 25;
+    prngState_ ^= prngState_ >> 27;
+    return static_cast<uint32_t>((prngState_ * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+bool WebSocketTransport::PerformHandshake(const std::string& host, const std::string& path, Clock::time_point deadline) {
+    // Generate random WebSocket key
+    unsigned char keyBytes[16];
+    for (int i = 0; i < 16; i += 4) {
+        uint32_t r = NextRandom();
+        std::memcpy(keyBytes + i, &r, 4);
+    }
+
+    // Base64 encode the key
+    static const char* b64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string wsKey;
+    int val = 0, valb = -6;
+    for (int i = 0; i < 16; ++i) {
+        val = (val << 8) + keyBytes[i];
+        valb += 8;
+        while (valb >= 0) {
+            wsKey.push_back(b64[(val >> valb) & 0x3F]);
+            valb -= 6;
+        }
+    }
+    if (valb > -6) wsKey.push_back(b64[((val << 8) >> (valb + 8)) & 0x3F]);
+    while (wsKey.size() % 4) wsKey.push_back('=');
+
+    // Send HTTP upgrade request
+    std::string request;
+    request.reserve(256);
+    request.append("GET ").append(path).append(" HTTP/1.1\r\n")
+           .append("Host: ").append(host).append("\r\n")
+           .append("Upgrade: websocket\r\n")
+           .append("Connection: Upgrade\r\n")
+           .append("Sec-WebSocket-Key: ").append(wsKey).append("\r\n")
+           .append("Sec-WebSocket-Version: 13\r\n")
+           .append("\r\n");
+
+    if (!WriteAll(request.data(), request.size(), deadline)) {
+        return false;
+    }
+
+    // Read until the end of the response headers; the server may already have
+    // sent its first frame in the same record, so keep whatever follows
+    std::string response;
+    size_t headerEnd = std::string::npos;
+    char buffer[4096];
+    while (headerEnd == std::string::npos) {
+        if (response.size() >= kMaxHandshakeSize) {
+            return false;
+        }
+        int bytesRead = SSL_read(ssl_, buffer, sizeof(buffer));
+        if (bytesRead <= 0) {
+            if (WaitForHandshake(bytesRead, deadline)) {
+                continue;
+            }
+            return false;
+        }
+        response.append(buffer, static_cast<size_t>(bytesRead));
+        headerEnd = response.find("\r\n\r\n");
+    }
+
+    size_t bodyStart = headerEnd + 4;
+    if (bodyStart < response.size()) {
+        size_t extra = response.size() - bodyStart;
+        std::memcpy(frameReader_.Prepare(extra), response.data() + bodyStart, extra);
+        frameReader_.Commit(extra);
+    }
+
+    // Check for 101 Switching Protocols
+    size_t statusEnd = response.find("\r\n");
+    return response.compare(0, 9, "HTTP/1.1 ") == 0 &&
+           response.find(" 101", 8) < statusEnd;
+}
+
+bool WebSocketTransport::WaitForHandshake(int result, Clock::time_point deadline) {
+    int err = SSL_get_error(ssl_, result);
+    if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE) {
+        return false;
+    }
+
+    pollfd pfd = {};
+    pfd.fd = socket_;
+    pfd.events = err == SSL_ERROR_WANT_WRITE ? POLLOUT : POLLIN;
+
+    // In slices, so an unload doesn't wait out the whole deadline
+    while (!AsyncExecutor::IsCancellationRequested()) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+        if (remaining.count() <= 0) {
+            return false;
+        }
+        int timeoutMs = static_cast<int>((std::min)(remaining, AsyncExecutor::kCancelPollInterval).count());
+#ifdef _WIN32
+        int ready = WSAPoll(&pfd, 1, timeoutMs);
+#else
+        int ready = poll(&pfd, 1, timeoutMs);
+#endif
+        if (ready != 0) {
+            return ready > 0;
+        }
+    }
+    return false;
+}
+
+bool WebSocketTransport::WriteAll(const void* data, size_t size, Clock::time_point deadline) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        int written = SSL_write(ssl_, p, static_cast<int>(size));
+        if (written <= 0) {
+            // Retried with the same bytes, as TLS requires
+            if (WaitForHandshake(written, deadline)) {
+                continue;
+            }
+            return false;
+        }
+        p += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool WebSocketTransport::HasPendingWrites() {
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    return !pendingWrite_.empty();
+}
+
+bool WebSocketTransport::FlushWrites() {
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    return FlushWritesLocked();
+}
+
+bool WebSocketTransport::FlushWritesLocked() {
+    if (!ssl_) {
+        return false;
+    }
+
+    size_t offset = 0;
+    while (offset < pendingWrite_.size()) {
+        int written = SSL_write(ssl_, pendingWrite_.data() + offset, static_cast<int>(pendingWrite_.size() - offset));
+        if (written <= 0) {
+            // Full send buffer (or a renegotiation read): keep the rest for the next
+            // writable event. A retry must repeat the same bytes, which the queue does.
+            int err = SSL_get_error(ssl_, written);
+            if (err != SSL_ERROR_WANT_WRITE && err != SSL_ERROR_WANT_READ) {
+                pendingWrite_.clear();
+                return false;
+            }
+            break;
+        }
+        offset += static_cast<size_t>(written);
+    }
+    pendingWrite_.erase(pendingWrite_.begin(), pendingWrite_.begin() + offset);
+    return true;
+}
+
+bool WebSocketTransport::SendText(std::string_view data) {
+    return SendFrame(WebSocketOpcode::Text, data);
+}
+
+bool WebSocketTransport::SendFrame(uint8_t opcode, std::string_view data) {
+    std::lock_guard<std::mutex> lock(ioMutex_);
+    return SendFrameLocked(opcode, data);
+}
+
+bool WebSocketTransport::SendFrameLocked(uint8_t opcode, std::string_view data) {
+    if (!ssl_) {
+        return false;
+    }
+
+    size_t len = data.size();
+    size_t headerLen = 2 + 4 + (len <= 125 ? 0 : len <= 65535 ? 2 : 8);
+    sendBuffer_.resize(headerLen + len);
+    unsigned char* frame = sendBuffer_.data();
+
+    // Opcode with FIN bit
+    frame[0] = static_cast<unsigned char>(0x80 | opcode);
+
+    // Mask bit set + payload length
+    size_t pos = 2;
+    if (len <= 125) {
+        frame[1] = static_cast<unsigned char>(0x80 | len);
+    } else if (len <= 65535) {
+        frame[1] = 0xFE;
+        frame[pos++] = static_cast<unsigned char>((len >> 8) & 0xFF);
+        frame[pos++] = static_cast<unsigned char>(len & 0xFF);
+    } else {
+        frame[1] = 0xFF;
+        for (int i = 7; i >= 0; --i) {
+            frame[pos++] = static_cast<unsigned char>((static_cast<uint64_t>(len) >> (8 * i)) & 0xFF);
+        }
+    }
+
+    // Masking key
+    uint32_t maskWord = NextRandom();
+    unsigned char* mask = frame + pos;
+    std::memcpy(mask, &maskWord, 4);
+    pos += 4;
+
+    // Masked payload
+    unsigned char* payload = frame + pos;
+    if (len > 0) {
+        std::memcpy(payload, data.data(), len);
+        ApplyWebSocketMask(payload, len, mask);
+    }
+
+    // Queued behind anything still waiting, so frames never interleave
+    if (pendingWrite_.size() + sendBuffer_.size() > kMaxPendingWrite) {
+        return false;
+    }
+    pendingWrite_.insert(pendingWrite_.end(), sendBuffer_.begin(), sendBuffer_.end());
+    return FlushWritesLocked();
+}
+
+bool WebSocketTransport::ReadMessages(const MessageHandler& onMessage) {
+    WebSocketFrame frame;
+    while (open_) {
+        {
+            std::lock_guard<std::mutex> lock(ioMutex_);
+            if (!ssl_) {
+                open_ = false;
+                return false;
+            }
+
+            // Output queued while the socket was full goes first
+            if (!pendingWrite_.empty() && !FlushWritesLocked()) {
+                open_ = false;
+                return false;
+            }
+
+            // Decode everything already buffered before touching the socket again
+            while (frameReader_.Next(frame)) {
+                // Handle ping - respond with pong carrying the same payload
+                if (frame.opcode == WebSocketOpcode::Ping) {
+                    if (!SendFrameLocked(WebSocketOpcode::Pong, frame.payload)) {
+                        open_ = false;
+                        return false;
+                    }
+                    continue;
+                }
+
+                // Close frame - echo it back and stop
+                if (frame.opcode == WebSocketOpcode::Close) {
+                    SendFrameLocked(WebSocketOpcode::Close, frame.payload.substr(0, 2));
+                    open_ = false;
+                    return false;
+                }
+
+                if (frame.opcode == WebSocketOpcode::Text || frame.opcode == WebSocketOpcode::Binary) {
+                    break;
+                }
+            }
+        }
+
+        // Messages are delivered without the lock so handlers can send
+        if (frame.opcode == WebSocketOpcode::Text || frame.opcode == WebSocketOpcode::Binary) {
+            onMessage(frame);
+            frame.opcode = 0;
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(ioMutex_);
+        if (frameReader_.HasError()) {
+            LOG("WebSocket received a malformed frame");
+            open_ = false;
+            return false;
+        }
+
+        // Pull whatever the TLS layer has ready in one go
+        char* space = frameReader_.Prepare(kReadChunkSize);
+        int bytesRead = SSL_read(ssl_, space, static_cast<int>(kReadChunkSize));
+        if (bytesRead <= 0) {
+            int err = SSL_get_error(ssl_, bytesRead);
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+                // Drained; wait for the reactor to report more
+                return true;
+            }
+            open_ = false;
+            return false;
+        }
+        frameReader_.Commit(static_cast<size_t>(bytesRead));
+    }
+    return false;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+using SOCKET = int;
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+#endif
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include "WebSocketFrame.h"
+
+// A single secure WebSocket connection: TCP socket, TLS session and the RFC 6455
+// codec. TwitchEventSub and TwitchWebSocket both sit on top of this.
+//
+// After Connect() the socket is non-blocking: the NetReactor thread calls
+// ReadMessages() when it becomes readable, while any thread may send. Sends never
+// wait for the socket; whatever TLS can't take yet is queued and written by
+// FlushWrites() once the reactor reports the socket writable. All TLS calls are
+// serialized internally.
+class WebSocketTransport {
+public:
+    using MessageHandler = std::function<void(const WebSocketFrame& message)>;
+
+    WebSocketTransport();
+    ~WebSocketTransport();
+
+    WebSocketTransport(const WebSocketTransport&) = delete;
+    WebSocketTransport& operator=(const WebSocketTransport&) = delete;
+
+    // Connects to wss://host:port/path and completes the upgrade handshake. The TLS
+    // and upgrade handshakes together get kHandshakeTimeout.
+    bool Connect(const std::string& host, const std::string& path, const std::string& port = "443");
+    // Releases the TLS session and socket. Unregister from the reactor first.
+    void Close();
+    bool IsOpen() const { return open_; }
+    SOCKET Socket() const { return socket_; }
+
+    // Drains everything the socket has ready without blocking and hands each
+    // text or binary message to onMessage. Pings are answered and close frames
+    // end the connection. Returns false once the connection is gone.
+    bool ReadMessages(const MessageHandler& onMessage);
+
+    // False once the connection is gone or too much output is queued
+    bool SendText(std::string_view data);
+    bool SendFrame(uint8_t opcode, std::string_view data);
+
+    // Output is waiting for the socket to become writable
+    bool HasPendingWrites();
+    // Writes as much queued output as the socket takes; false if the connection failed
+    bool FlushWrites();
+
+    static constexpr std::chrono::milliseconds kHandshakeTimeout{ 10000 };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    bool PerformHandshake(const std::string& host, const std::string& path, Clock::time_point deadline);
+    // Waits for whatever the failed TLS call needs from the socket; false on a real
+    // error, once the deadline has passed, or when the executor is cancelling
+    bool WaitForHandshake(int result, Clock::time_point deadline);
+    // Writes the upgrade request, waiting for the socket until the deadline
+    bool WriteAll(const void* data, size_t size, Clock::time_point deadline);
+    bool SendFrameLocked(uint8_t opcode, std::string_view data);
+    bool FlushWritesLocked();
+    uint32_t NextRandom();
+
+    static constexpr size_t kReadChunkSize = 16 * 1024;
+    static constexpr size_t kMaxHandshakeSize = 16 * 1024;
+    // A peer that stops reading is dropped rather than buffered for indefinitely
+    static constexpr size_t kMaxPendingWrite = 1024 * 1024;
+
+    SOCKET socket_ = INVALID_SOCKET;
+    SSL* ssl_ = nullptr;
+    std::atomic<bool> open_{ false };
+
+    WebSocketFrameReader frameReader_;
+
+    std::mutex ioMutex_;
+    std::vector<unsigned char> sendBuffer_;
+    std::vector<unsigned char> pendingWrite_;   // framed bytes TLS hasn't accepted yet
+    uint64_t prngState_ = 0;
+};
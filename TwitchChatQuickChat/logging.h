@@ -1,87 +1,74 @@
-﻿// ReSharper disable CppNonExplicitConvertingConstructor
-#pragma once
+﻿#pragma once
 #include <string>
 #include <source_location>
 #include <format>
 #include <memory>
 
 #include "bakkesmod/wrappers/cvarmanagerwrapper.h"
+#include "AsyncLog.h"
+#include "LogSite.h"
 
 extern std::shared_ptr<CVarManagerWrapper> _globalCvarManager;
 constexpr bool DEBUG_LOG = false;
 
 
-struct FormatString
-{
-	std::string_view str;
-	std::source_location loc{};
-
-	FormatString(const char* str, const std::source_location& loc = std::source_location::current()) : str(str), loc(loc)
-	{
-	}
-
-	FormatString(const std::string&& str, const std::source_location& loc = std::source_location::current()) : str(str), loc(loc)
-	{
-	}
-
-	[[nodiscard]] std::string GetLocation() const
-	{
-		return std::format("[{} ({}:{})]", loc.function_name(), loc.file_name(), loc.line());
-	}
-};
-
-struct FormatWstring
+// LOG/DEBUGLOG declare a constinit LogSite per call site, so the location is fixed at
+// compile time and each site can be switched off at runtime (see LogSites). Format
+// strings are std::format_string, checked against the arguments when compiling.
+#define LOG(...) \
+	do \
+	{ \
+		static constinit LogSite logSite_(std::source_location::current()); \
+		LogAt(logSite_, __VA_ARGS__); \
+	} while (false)
+
+#define DEBUGLOG(...) \
+	do \
+	{ \
+		if constexpr (DEBUG_LOG) \
+		{ \
+			static constinit LogSite logSite_(std::source_location::current()); \
+			DebugLogAt(logSite_, __VA_ARGS__); \
+		} \
+	} while (false)
+
+
+// Queued to AsyncLog and formatted on the logging thread
+template <typename... Args>
+void LogAt(LogSite& site, std::format_string<Args...> format_str, Args&&... args)
 {
-	std::wstring_view str;
-	std::source_location loc{};
-
-	FormatWstring(const wchar_t* str, const std::source_location& loc = std::source_location::current()) : str(str), loc(loc)
+	if (LogSites::Get().IsEnabled(site))
 	{
+		AsyncLog::Get().Write(format_str.get(), nullptr, args...);
 	}
-
-	FormatWstring(const std::wstring&& str, const std::source_location& loc = std::source_location::current()) : str(str), loc(loc)
-	{
-	}
-
-	[[nodiscard]] std::wstring GetLocation() const
-	{
-		auto basic_string = std::format("[{} ({}:{})]", loc.function_name(), loc.file_name(), loc.line());
-		return std::wstring(basic_string.begin(), basic_string.end());
-	}
-};
-
-
-template <typename... Args>
-void LOG(std::string_view format_str, Args&&... args)
-{
-	_globalCvarManager->log(std::vformat(format_str, std::make_format_args(args...)));
 }
 
 template <typename... Args>
-void LOG(std::wstring_view format_str, Args&&... args)
+void LogAt(LogSite& site, std::wformat_string<Args...> format_str, Args&&... args)
 {
-	_globalCvarManager->log(std::vformat(format_str, std::make_wformat_args(args...)));
+	if (LogSites::Get().IsEnabled(site))
+	{
+		_globalCvarManager->log(std::format(format_str, std::forward<Args>(args)...));
+	}
 }
 
 
 template <typename... Args>
-void DEBUGLOG(const FormatString& format_str, Args&&... args)
+void DebugLogAt(LogSite& site, std::format_string<Args...> format_str, Args&&... args)
 {
-	if constexpr (DEBUG_LOG)
+	if (LogSites::Get().IsEnabled(site))
 	{
-		auto text = std::vformat(format_str.str, std::make_format_args(args...));
-		auto location = format_str.GetLocation();
-		_globalCvarManager->log(std::format("{} {}", text, location));
+		AsyncLog::Get().Write(format_str.get(), &site, args...);
 	}
 }
 
 template <typename... Args>
-void DEBUGLOG(const FormatWstring& format_str, Args&&... args)
+void DebugLogAt(LogSite& site, std::wformat_string<Args...> format_str, Args&&... args)
 {
-	if constexpr (DEBUG_LOG)
+	if (LogSites::Get().IsEnabled(site))
 	{
-		auto text = std::vformat(format_str.str, std::make_wformat_args(args...));
-		auto location = format_str.GetLocation();
-		_globalCvarManager->log(std::format(L"{} {}", text, location));
+		std::string location = LogSites::Get().Location(site);
+		_globalCvarManager->log(std::format(L"{} {}", std::format(format_str, std::forward<Args>(args)...),
+			std::wstring(location.begin(), location.end())));
 	}
 }
@@ -0,0 +1,125 @@
+#include "Check.h"
+#include "AsyncExecutor.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Shutdown() is what onUnload waits on, so it has to come back within the drain
+// timeout even when every worker is stuck in a blocking socket call, and leave no
+// task behind. The executor is a process-wide singleton, so the cases run in order
+// against the one instance and the first one shuts it down.
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::chrono::milliseconds kDrainTimeout{ 300 };
+    // Joining the workers after the cancel callbacks ran
+    constexpr std::chrono::milliseconds kMargin{ 400 };
+
+    struct SocketPair {
+        int fds[2] = { -1, -1 };
+        SocketPair() { socketpair(AF_UNIX, SOCK_STREAM, 0, fds); }
+        ~SocketPair() {
+            close(fds[0]);
+            close(fds[1]);
+        }
+    };
+
+    bool WaitUntil(const std::atomic<int>& value, int expected) {
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+        while (value.load() < expected) {
+            if (Clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    std::atomic<int> started{ 0 };
+
+} // namespace
+
+// Three workers block in recv() on sockets nobody writes to, the way an httplib
+// request waits out its read timeout; a fourth polls the flag like the connect loops.
+// One more task is still queued behind them when Shutdown() runs.
+TEST(ShutdownBreaksOffBlockedSocketCalls) {
+    std::vector<SocketPair> pairs(AsyncExecutor::kMaxWorkers - 1);
+    std::vector<AsyncTask<long>> blocked;
+    for (SocketPair& pair : pairs) {
+        int fd = pair.fds[0];
+        blocked.push_back(AsyncExecutor::Get().Submit([fd]() -> long {
+            AsyncExecutor::CancelScope cancel([fd]() { shutdown(fd, SHUT_RDWR); });
+            if (AsyncExecutor::IsCancellationRequested()) {
+                return -2;
+            }
+            started++;
+            char buffer[16];
+            return static_cast<long>(recv(fd, buffer, sizeof(buffer), 0));
+        }));
+    }
+
+    AsyncTask<bool> polling = AsyncExecutor::Get().Submit([]() {
+        started++;
+        while (!AsyncExecutor::IsCancellationRequested()) {
+            std::this_thread::sleep_for(AsyncExecutor::kCancelPollInterval);
+        }
+        return true;
+    });
+
+    std::atomic<bool> queuedRan{ false };
+    AsyncTask<void> queued = AsyncExecutor::Get().Submit([&queuedRan]() { queuedRan = true; });
+
+    if (!CHECK(WaitUntil(started, static_cast<int>(AsyncExecutor::kMaxWorkers)))) {
+        return;
+    }
+    // Let the sockets settle into recv()
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    Clock::time_point begin = Clock::now();
+    AsyncExecutor::Get().Shutdown(kDrainTimeout);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin);
+    std::printf("  shutdown took %lld ms\n", static_cast<long long>(elapsed.count()));
+
+    CHECK(elapsed >= kDrainTimeout);
+    CHECK(elapsed < kDrainTimeout + kMargin);
+    CHECK(AsyncExecutor::Get().Outstanding() == 0);
+
+    // Every task has finished or been dropped; none is still running
+    for (const AsyncTask<long>& task : blocked) {
+        CHECK(task.IsReady());
+        CHECK(task.Get() == 0);     // recv() saw the shutdown as end of stream
+    }
+    CHECK(polling.IsReady());
+    CHECK(polling.Get());
+
+    CHECK(queued.IsReady());
+    CHECK(!queuedRan);
+    bool threw = false;
+    try {
+        queued.Get();
+    } catch (const TaskCancelled&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST(SubmitAfterShutdownIsCancelled) {
+    AsyncTask<int> task = AsyncExecutor::Get().Submit([]() { return 1; });
+    CHECK(task.IsReady());
+    bool threw = false;
+    try {
+        task.Get();
+    } catch (const TaskCancelled&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(AsyncExecutor::Get().Outstanding() == 0);
+}
+
+int main() {
+    return RunTests();
+}
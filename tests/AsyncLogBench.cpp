@@ -0,0 +1,103 @@
+#include "logging.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Cost of a LOG call on the calling thread while the logging thread formats and
+// drains the ring, from 1 to 8 calling threads, and of a call to a site that has been
+// switched off. Each sample times a batch of calls, since one call is close to the
+// clock's own cost.
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int kBatch = 16;
+    constexpr int kSamplesPerThread = 1600;
+
+    struct Stats {
+        double p50;
+        double p99;
+        double mean;
+    };
+
+    Stats Summarize(std::vector<double>& samples) {
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (double sample : samples) {
+            sum += sample;
+        }
+        return { samples[samples.size() / 2], samples[samples.size() * 99 / 100], sum / samples.size() };
+    }
+
+    // A typical chat-path line: a string and two numbers
+    void LogOnce(const std::string& channel, int index) {
+        LOG("Bench: message from {} ({} bytes, #{})", channel, 42, index);
+    }
+
+    void LogDisabled(const std::string& channel, int index) {
+        LOG("Bench: disabled site {} #{}", channel, index);
+    }
+
+    template <typename Fn>
+    Stats Run(int threads, Fn&& call) {
+        std::vector<std::vector<double>> perThread(threads);
+        std::vector<std::thread> workers;
+        std::atomic<int> ready{ 0 };
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                std::string channel = "channel" + std::to_string(t);
+                std::vector<double>& samples = perThread[t];
+                samples.reserve(kSamplesPerThread);
+                ready++;
+                while (ready < threads) {
+                }
+                for (int i = 0; i < kSamplesPerThread; ++i) {
+                    Clock::time_point start = Clock::now();
+                    for (int j = 0; j < kBatch; ++j) {
+                        call(channel, j);
+                    }
+                    samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / kBatch);
+                    // Roughly the gap between bursts of chat; keeps the ring from filling
+                    std::this_thread::sleep_for(std::chrono::microseconds(20));
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        std::vector<double> all;
+        for (const auto& samples : perThread) {
+            all.insert(all.end(), samples.begin(), samples.end());
+        }
+        return Summarize(all);
+    }
+
+} // namespace
+
+int main() {
+    std::atomic<uint64_t> printed{ 0 };
+    AsyncLog::Get().Start([&printed](const std::string& line) { printed += line.size() > 0; });
+
+    std::printf("%8s %10s %10s %10s %8s\n", "threads", "p50 ns", "p99 ns", "mean ns", "dropped");
+    for (int threads : { 1, 2, 4, 8 }) {
+        uint64_t droppedBefore = AsyncLog::Get().Dropped();
+        Stats stats = Run(threads, LogOnce);
+        std::printf("%8d %10.1f %10.1f %10.1f %8llu\n", threads, stats.p50, stats.p99, stats.mean,
+            static_cast<unsigned long long>(AsyncLog::Get().Dropped() - droppedBefore));
+    }
+
+    // Register the site, then switch its file off
+    LogDisabled("warmup", 0);
+    LogSites::Get().SetEnabled("AsyncLogBench.cpp", false);
+    Stats disabled = Run(1, LogDisabled);
+    std::printf("%8s %10.1f %10.1f %10.1f\n", "disabled", disabled.p50, disabled.p99, disabled.mean);
+
+    AsyncLog::Get().Stop();
+    std::printf("%llu lines written\n", static_cast<unsigned long long>(printed.load()));
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "Check.h"
+#include "ChatFloodControl.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Duplicate collapsing with the default settings (no display rate limit), where every
+// drain empties the backlog: copies arriving over later drains still fold into one
+// line with a count.
+namespace {
+
+    using Clock = ChatFloodControl::Clock;
+    using std::chrono::milliseconds;
+
+    struct Line {
+        std::string username;
+        std::string message;
+
+        bool operator==(const Line&) const = default;
+    };
+
+    // One Chat::DrainMessages: submit what arrived, then show what flood control allows
+    std::vector<Line> Drain(ChatFloodControl& flood, Clock::time_point now, const std::vector<Line>& arrived) {
+        for (const Line& line : arrived) {
+            flood.Submit(line.username, line.message, now, now);
+        }
+        std::vector<Line> shown;
+        flood.Flush(now, 10, [&shown](const std::string& username, const std::string& message,
+                                      Clock::time_point, Clock::time_point) {
+            shown.push_back({ username, message });
+        });
+        return shown;
+    }
+
+    void CollapseOnly(ChatFloodControl& flood) {
+        ChatFloodControl::Settings settings;
+        settings.collapseDuplicates = true;
+        flood.Configure(settings);
+    }
+
+} // namespace
+
+TEST(CollapsesAcrossDrains) {
+    ChatFloodControl flood;
+    CollapseOnly(flood);
+    Clock::time_point start = Clock::now();
+
+    CHECK(Drain(flood, start, { { "first", "PogChamp" } }) == std::vector<Line>{ { "first", "PogChamp" } });
+    CHECK(!flood.HasBacklog());
+
+    // 36 more over the next few drains: held, while other text goes straight through
+    for (int drain = 1; drain <= 6; ++drain) {
+        std::vector<Line> arrived;
+        for (int i = 0; i < 6; ++i) {
+            arrived.push_back({ "viewer" + std::to_string(drain), "PogChamp" });
+        }
+        if (drain == 3) {
+            arrived.push_back({ "other", "gg" });
+        }
+        std::vector<Line> shown = Drain(flood, start + milliseconds(100 * drain), arrived);
+        CHECK(shown == (drain == 3 ? std::vector<Line>{ { "other", "gg" } } : std::vector<Line>{}));
+        CHECK(flood.HasBacklog());
+    }
+    CHECK(flood.TimeUntilNextSlot(start + milliseconds(600)) == milliseconds(400));
+
+    // The window ends: one line for all of them
+    CHECK(Drain(flood, start + milliseconds(1000), {}) ==
+          std::vector<Line>{ { "viewer1 and others", "PogChamp x36" } });
+    CHECK(!flood.HasBacklog());
+    CHECK(flood.GetStats().merged == 36);
+
+    // That line opened a window of its own; a copy after it is shown again
+    CHECK(Drain(flood, start + milliseconds(1500), { { "late", "PogChamp" } }).empty());
+    CHECK(Drain(flood, start + milliseconds(2000), {}) == std::vector<Line>{ { "late", "PogChamp" } });
+    CHECK(Drain(flood, start + milliseconds(3100), { { "later", "PogChamp" } }) ==
+          std::vector<Line>{ { "later", "PogChamp" } });
+}
+
+TEST(CollapsesWithinOneDrain) {
+    ChatFloodControl flood;
+    CollapseOnly(flood);
+    Clock::time_point now = Clock::now();
+    CHECK(Drain(flood, now, { { "a", "KEKW" }, { "a", "KEKW" }, { "b", "hi" }, { "a", "KEKW" } }) ==
+          (std::vector<Line>{ { "a", "KEKW x3" }, { "b", "hi" } }));
+}
+
+TEST(TurningCollapseOffReleasesHeldCopies) {
+    ChatFloodControl flood;
+    CollapseOnly(flood);
+    Clock::time_point start = Clock::now();
+    Drain(flood, start, { { "a", "LUL" } });
+    CHECK(Drain(flood, start + milliseconds(100), { { "b", "LUL" }, { "c", "LUL" } }).empty());
+
+    flood.Configure({});
+    CHECK(Drain(flood, start + milliseconds(200), { { "d", "LUL" } }) ==
+          (std::vector<Line>{ { "b and others", "LUL x2" }, { "d", "LUL" } }));
+    CHECK(!flood.HasBacklog());
+}
+
+int main() {
+    return RunTests();
+}
@@ -0,0 +1,122 @@
+#include "EventSubMessage.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Throughput of EventSubMessage::Parse plus what Chat::OnChatEvent reads on a corpus of
+// channel.chat.message notifications shaped like Twitch's: plain text, emote fragments,
+// escaped text, a reply and a cheer.
+namespace {
+
+    std::string Notification(std::string_view event) {
+        return std::string(
+            "{\"metadata\":{\"message_id\":\"befa7b53-d79d-478f-86b9-120f112b044e\",\"message_type\":\"notification\","
+            "\"message_timestamp\":\"2023-11-06T18:11:47.492253549Z\",\"subscription_type\":\"channel.chat.message\","
+            "\"subscription_version\":\"1\"},\"payload\":{\"subscription\":{\"id\":\"0b7f3361-672b-4d39-b307-dd5b576c9b27\","
+            "\"status\":\"enabled\",\"type\":\"channel.chat.message\",\"version\":\"1\",\"condition\":{"
+            "\"broadcaster_user_id\":\"1971641\",\"user_id\":\"2914196\"},\"transport\":{\"method\":\"websocket\","
+            "\"session_id\":\"AgoQHR3s6Mb4T8GFB1l3DlPfiRIGY2VsbC1h\"},\"created_at\":\"2023-11-06T18:11:47.492253549Z\","
+            "\"cost\":0},\"event\":") + std::string(event) + "}}";
+    }
+
+    std::vector<std::string> Corpus() {
+        const std::string chatter =
+            "\"broadcaster_user_id\":\"1971641\",\"broadcaster_user_login\":\"streamer\",\"broadcaster_user_name\":\"streamer\","
+            "\"chatter_user_id\":\"4145994\",\"chatter_user_login\":\"viewer32\",\"chatter_user_name\":\"viewer32\","
+            "\"message_id\":\"cc106a89-1814-919d-454c-f4f2f970aae7\",";
+        const std::string badges =
+            "\"color\":\"#00FF7F\",\"badges\":[{\"set_id\":\"moderator\",\"id\":\"1\",\"info\":\"\"},"
+            "{\"set_id\":\"subscriber\",\"id\":\"12\",\"info\":\"16\"},{\"set_id\":\"sub-gifter\",\"id\":\"1\",\"info\":\"\"}],";
+        const std::string noExtras =
+            "\"message_type\":\"text\",\"cheer\":null,\"reply\":null,\"channel_points_custom_reward_id\":null,"
+            "\"source_broadcaster_user_id\":null,\"source_broadcaster_user_login\":null,\"source_broadcaster_user_name\":null,"
+            "\"source_message_id\":null,\"source_badges\":null}";
+
+        return {
+            Notification("{" + chatter +
+                "\"message\":{\"text\":\"what a save, that was close\",\"fragments\":[{\"type\":\"text\","
+                "\"text\":\"what a save, that was close\",\"cheermote\":null,\"emote\":null,\"mention\":null}]}," +
+                badges + noExtras),
+            Notification("{" + chatter +
+                "\"message\":{\"text\":\"Kappa Kappa nice shot\",\"fragments\":[{\"type\":\"emote\",\"text\":\"Kappa\","
+                "\"cheermote\":null,\"emote\":{\"id\":\"25\",\"emote_set_id\":\"0\",\"owner_id\":\"0\",\"format\":[\"static\"]},"
+                "\"mention\":null},{\"type\":\"text\",\"text\":\" \",\"cheermote\":null,\"emote\":null,\"mention\":null},"
+                "{\"type\":\"emote\",\"text\":\"Kappa\",\"cheermote\":null,\"emote\":{\"id\":\"25\",\"emote_set_id\":\"0\","
+                "\"owner_id\":\"0\",\"format\":[\"static\"]},\"mention\":null},{\"type\":\"text\",\"text\":\" nice shot\","
+                "\"cheermote\":null,\"emote\":null,\"mention\":null}]}," + badges + noExtras),
+            Notification("{" + chatter +
+                "\"message\":{\"text\":\"he said \\\"gg\\\" \\u2764 then left\\\\quit\",\"fragments\":[{\"type\":\"text\","
+                "\"text\":\"he said \\\"gg\\\" \\u2764 then left\\\\quit\",\"cheermote\":null,\"emote\":null,\"mention\":null}]}," +
+                badges + noExtras),
+            Notification("{" + chatter +
+                "\"message\":{\"text\":\"@streamer no way\",\"fragments\":[{\"type\":\"mention\",\"text\":\"@streamer\","
+                "\"cheermote\":null,\"emote\":null,\"mention\":{\"user_id\":\"1971641\",\"user_name\":\"streamer\","
+                "\"user_login\":\"streamer\"}},{\"type\":\"text\",\"text\":\" no way\",\"cheermote\":null,\"emote\":null,"
+                "\"mention\":null}]},\"color\":\"\",\"badges\":[],\"message_type\":\"text\",\"cheer\":null,"
+                "\"reply\":{\"parent_message_id\":\"a4d4b8a2-5d1e-4a8f-9c3b-2e7f6d5c4b3a\",\"parent_message_body\":\"that was "
+                "the best goal of the night\",\"parent_user_id\":\"1971641\",\"parent_user_name\":\"streamer\","
+                "\"parent_user_login\":\"streamer\",\"thread_parent_message_id\":\"a4d4b8a2-5d1e-4a8f-9c3b-2e7f6d5c4b3a\","
+                "\"thread_parent_user_id\":\"1971641\",\"thread_parent_user_name\":\"streamer\","
+                "\"thread_parent_user_login\":\"streamer\"},\"channel_points_custom_reward_id\":null}"),
+            Notification("{" + chatter +
+                "\"message\":{\"text\":\"Cheer100 go go go\",\"fragments\":[{\"type\":\"cheermote\",\"text\":\"Cheer100\","
+                "\"cheermote\":{\"prefix\":\"cheer\",\"bits\":100,\"tier\":100},\"emote\":null,\"mention\":null},"
+                "{\"type\":\"text\",\"text\":\" go go go\",\"cheermote\":null,\"emote\":null,\"mention\":null}]}," + badges +
+                "\"message_type\":\"text\",\"cheer\":{\"bits\":100},\"reply\":null,\"channel_points_custom_reward_id\":null}"),
+        };
+    }
+
+    // What Chat::OnChatEvent pulls out of the event
+    size_t ReadChatFields(const EventSubMessage& message) {
+        Json::Value chatterName, messageObject;
+        Json::ForEachMember(message.event, [&](const Json::Value& key, const Json::Value& value) {
+            if (key.raw == "chatter_user_name") {
+                chatterName = value;
+            } else if (key.raw == "message") {
+                messageObject = value;
+            }
+            return !chatterName || !messageObject;
+        });
+        Json::Value messageText = Json::Find(messageObject, "text");
+        return chatterName.ToString().size() + messageText.ToString().size();
+    }
+
+} // namespace
+
+int main() {
+    const std::vector<std::string> corpus = Corpus();
+    size_t bytes = 0;
+    for (const std::string& payload : corpus) {
+        EventSubMessage message;
+        if (!EventSubMessage::Parse(payload, message) || message.subscriptionType != "channel.chat.message" ||
+            !message.event.IsObject() || ReadChatFields(message) == 0) {
+            std::printf("corpus payload failed to parse: %s\n", payload.c_str());
+            return 1;
+        }
+        bytes += payload.size();
+    }
+
+    std::printf("%10s %14s %10s %10s\n", "", "msg/s", "ns/msg", "MB/s");
+    for (int run = 0; run < 3; ++run) {
+        const size_t rounds = 200000;
+        size_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t round = 0; round < rounds; ++round) {
+            for (const std::string& payload : corpus) {
+                EventSubMessage message;
+                if (EventSubMessage::Parse(payload, message)) {
+                    checksum += message.messageType.size() + ReadChatFields(message);
+                }
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double messages = static_cast<double>(rounds * corpus.size());
+        std::printf("%10s %14.0f %10.1f %10.1f  (%zu)\n", ("run " + std::to_string(run + 1)).c_str(),
+            messages / elapsed.count(), elapsed.count() * 1e9 / messages,
+            static_cast<double>(rounds * bytes) / elapsed.count() / 1e6, checksum & 0xFF);
+    }
+    return 0;
+}
@@ -0,0 +1,321 @@
+#include "Check.h"
+#include "HelixScheduler.h"
+#include "AsyncExecutor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// HelixScheduler against a mock of Twitch's token bucket that can be told to answer
+// with 429s, 5xx or a dropped connection: priority reserves, which failures are
+// retried for idempotent calls and for POST, giving up at the deadline, and Critical
+// calls getting through the executor while Background ones hold every worker.
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    int64_t UnixNow() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    double MsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // api.twitch.tv as far as the scheduler can tell: a bucket of `limit` points that
+    // refills at Ratelimit-Reset, reported on every response
+    class MockHelix {
+    public:
+        explicit MockHelix(int limit) : limit_(limit), remaining_(limit), resetUnix_(UnixNow() + 60) {}
+
+        void SetBucket(int remaining, int64_t resetInSeconds) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            remaining_ = remaining;
+            resetUnix_ = UnixNow() + resetInSeconds;
+        }
+
+        // Answers for the next requests, ahead of the bucket: 429, 5xx, or 0 for a
+        // connection lost before any response
+        void Inject(std::initializer_list<int> statuses) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            injected_.insert(injected_.end(), statuses);
+        }
+
+        HelixScheduler::SendFn Request(std::string label) {
+            return [this, label]() { return Send(label); };
+        }
+
+        std::vector<std::string> Calls() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return calls_;
+        }
+        size_t CallCount() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return calls_.size();
+        }
+        // 429s the scheduler ran into on its own, i.e. it overdrew the bucket
+        int Overdrawn() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return overdrawn_;
+        }
+
+    private:
+        HelixResponseInfo Send(const std::string& label) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            calls_.push_back(label);
+
+            int64_t now = UnixNow();
+            if (now >= resetUnix_) {
+                remaining_ = limit_;
+                resetUnix_ = now + 60;
+            }
+
+            int status = 200;
+            if (!injected_.empty()) {
+                status = injected_.front();
+                injected_.pop_front();
+            } else if (remaining_ == 0) {
+                status = 429;
+                overdrawn_++;
+            }
+
+            HelixResponseInfo info;
+            if (status == 0) {
+                return info;
+            }
+            info.status = status;
+            if (status == 429) {
+                // Twitch's bucket refills continuously; after a 429 it has room again within a second
+                remaining_ = 0;
+                resetUnix_ = (std::min)(resetUnix_, now + 1);
+            } else {
+                remaining_ = (std::max)(remaining_ - 1, 0);
+            }
+            info.limit = limit_;
+            info.remaining = remaining_;
+            info.resetUnix = resetUnix_;
+            return info;
+        }
+
+        mutable std::mutex mutex_;
+        int limit_;
+        int remaining_;
+        int64_t resetUnix_;
+        std::deque<int> injected_;
+        std::vector<std::string> calls_;
+        int overdrawn_ = 0;
+    };
+
+    // Runs one Execute on its own thread, like a task on the AsyncExecutor
+    struct Caller {
+        HelixResponseInfo info;
+        double elapsedMs = 0;
+        std::thread thread;
+
+        Caller(HelixScheduler& scheduler, HelixPriority priority, bool idempotent, HelixScheduler::SendFn send) {
+            thread = std::thread([this, &scheduler, priority, idempotent, send]() {
+                Clock::time_point start = Clock::now();
+                info = scheduler.Execute(priority, idempotent, send);
+                elapsedMs = MsSince(start);
+            });
+        }
+        void Join() { thread.join(); }
+    };
+
+    // One request so the scheduler learns the bucket, then the bucket as given
+    void Prime(HelixScheduler& scheduler, MockHelix& helix, int remaining, int64_t resetInSeconds) {
+        helix.SetBucket(remaining + 1, resetInSeconds);
+        scheduler.Execute(HelixPriority::Critical, true, helix.Request("prime"));
+    }
+
+} // namespace
+
+// With 40 points left of 200, Background (reserve 40) waits for the reset while Normal
+// and Critical go straight through; with 5 left Normal waits too
+TEST(ReservesHoldBackLowerPriorities) {
+    HelixScheduler scheduler;
+    MockHelix helix(200);
+    Prime(scheduler, helix, 40, 2);
+
+    Caller background(scheduler, HelixPriority::Background, true, helix.Request("background"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    Caller normal(scheduler, HelixPriority::Normal, true, helix.Request("normal"));
+    normal.Join();
+    Caller critical(scheduler, HelixPriority::Critical, true, helix.Request("critical"));
+    critical.Join();
+    background.Join();
+
+    CHECK(normal.info.status == 200);
+    CHECK(critical.info.status == 200);
+    CHECK(background.info.status == 200);
+    CHECK(normal.elapsedMs < 100);
+    CHECK(critical.elapsedMs < 100);
+    CHECK(background.elapsedMs > 900);     // held until the bucket refilled
+    CHECK(helix.Calls() == std::vector<std::string>{ "prime", "normal", "critical", "background" });
+
+    Prime(scheduler, helix, 5, 2);
+    Caller held(scheduler, HelixPriority::Normal, true, helix.Request("normal"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    Caller urgent(scheduler, HelixPriority::Critical, true, helix.Request("critical"));
+    urgent.Join();
+    held.Join();
+    CHECK(urgent.elapsedMs < 100);
+    CHECK(held.elapsedMs > 900);
+    CHECK(helix.Overdrawn() == 0);
+}
+
+// Critical spends the last points of the bucket, never going over
+TEST(CriticalSpendsTheReserve) {
+    HelixScheduler scheduler;
+    MockHelix helix(200);
+    Prime(scheduler, helix, 3, 30);
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < 3; ++i) {
+        CHECK(scheduler.Execute(HelixPriority::Critical, false, helix.Request("critical")).status == 200);
+    }
+    CHECK(MsSince(start) < 100);
+    CHECK(helix.Overdrawn() == 0);
+    CHECK(scheduler.GetStats().remaining == 0);
+}
+
+// A 429 is retried once the bucket resets, for idempotent calls and POST alike,
+// since Twitch didn't process the request
+TEST(ThrottledRequestsAreRetried) {
+    HelixScheduler scheduler;
+    MockHelix helix(800);
+
+    helix.Inject({ 429 });
+    HelixResponseInfo get = scheduler.Execute(HelixPriority::Critical, true, helix.Request("get"));
+    CHECK(get.status == 200);
+
+    helix.Inject({ 429 });
+    HelixResponseInfo post = scheduler.Execute(HelixPriority::Critical, false, helix.Request("post"));
+    CHECK(post.status == 200);
+
+    CHECK(helix.CallCount() == 4);
+    HelixScheduler::Stats stats = scheduler.GetStats();
+    CHECK(stats.throttled == 2);
+    CHECK(stats.retried == 2);
+    CHECK(stats.gaveUp == 0);
+}
+
+// 5xx and lost connections are retried with backoff only when repeating is harmless
+TEST(TransientFailuresRetryOnlyIdempotentCalls) {
+    HelixScheduler scheduler;
+    MockHelix helix(800);
+
+    helix.Inject({ 503, 0, 500 });
+    Clock::time_point start = Clock::now();
+    HelixResponseInfo get = scheduler.Execute(HelixPriority::Normal, true, helix.Request("get"));
+    CHECK(get.status == 200);
+    CHECK(helix.CallCount() == 4);
+    // Three backoff steps from kRetryBase: at least half of 250 + 500 + 1000 ms
+    CHECK(MsSince(start) >= 875);
+
+    helix.Inject({ 503 });
+    HelixResponseInfo post = scheduler.Execute(HelixPriority::Normal, false, helix.Request("post"));
+    CHECK(post.status == 503);
+
+    helix.Inject({ 0 });
+    HelixResponseInfo lost = scheduler.Execute(HelixPriority::Normal, false, helix.Request("post"));
+    CHECK(lost.status == 0);
+
+    CHECK(helix.CallCount() == 6);
+    HelixScheduler::Stats stats = scheduler.GetStats();
+    CHECK(stats.retried == 3);
+    CHECK(stats.gaveUp == 0);
+
+    // Client errors are final either way
+    helix.Inject({ 400 });
+    CHECK(scheduler.Execute(HelixPriority::Normal, true, helix.Request("get")).status == 400);
+    CHECK(helix.CallCount() == 7);
+}
+
+// A call that can't be sent before its priority's deadline gives up without sending,
+// and one that keeps failing stops retrying at the deadline
+TEST(GivesUpAtTheDeadline) {
+    HelixScheduler scheduler;
+    MockHelix helix(200);
+    Prime(scheduler, helix, 0, 60);
+
+    auto deadline = std::chrono::duration<double, std::milli>(HelixScheduler::DeadlineFor(HelixPriority::Background)).count();
+    Clock::time_point start = Clock::now();
+    HelixResponseInfo info = scheduler.Execute(HelixPriority::Background, true, helix.Request("background"));
+    double elapsed = MsSince(start);
+    std::printf("  background gave up after %.0f ms\n", elapsed);
+
+    CHECK(info.status == 0);
+    CHECK(helix.CallCount() == 1);     // only the prime
+    CHECK(elapsed >= deadline - 1);
+    CHECK(elapsed < deadline + 500);
+    CHECK(scheduler.GetStats().gaveUp == 1);
+
+    // Failing 5xx until the deadline: every retry fits inside it
+    HelixScheduler failing;
+    MockHelix broken(800);
+    broken.Inject({ 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500 });
+    start = Clock::now();
+    info = failing.Execute(HelixPriority::Background, true, broken.Request("get"));
+    elapsed = MsSince(start);
+    CHECK(info.status == 500);
+    CHECK(elapsed < deadline + 100);
+    CHECK(broken.CallCount() >= 4);
+    CHECK(failing.GetStats().gaveUp == 1);
+}
+
+// Background calls waiting out the reserve park every executor worker inside
+// Execute(); a Critical resolve submitted as urgent still goes out right away instead
+// of queueing behind them
+TEST(CriticalRunsWhileBackgroundHoldsThePool) {
+    HelixScheduler scheduler;
+    MockHelix helix(200);
+    Prime(scheduler, helix, 10, 3);
+
+    std::atomic<int> parked{ 0 };
+    std::vector<AsyncTask<HelixResponseInfo>> background;
+    for (size_t i = 0; i < AsyncExecutor::kMaxWorkers; ++i) {
+        background.push_back(AsyncExecutor::Get().Submit([&scheduler, &helix, &parked]() {
+            parked++;
+            return scheduler.Execute(HelixPriority::Background, true, helix.Request("background"));
+        }));
+    }
+    Clock::time_point start = Clock::now();
+    while (parked.load() < static_cast<int>(AsyncExecutor::kMaxWorkers) && MsSince(start) < 1000) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(parked.load() == static_cast<int>(AsyncExecutor::kMaxWorkers));
+
+    // A plain task queues behind them
+    AsyncTask<void> queued = AsyncExecutor::Get().Submit([]() {});
+
+    start = Clock::now();
+    AsyncTask<HelixResponseInfo> critical = AsyncExecutor::Get().SubmitUrgent([&scheduler, &helix]() {
+        return scheduler.Execute(HelixPriority::Critical, false, helix.Request("critical"));
+    });
+    CHECK(critical.WaitFor(std::chrono::milliseconds(1000)));
+    double criticalMs = MsSince(start);
+    std::printf("  critical done after %.0f ms with the pool saturated\n", criticalMs);
+    CHECK(critical.Get().status == 200);
+    CHECK(criticalMs < 500);
+    CHECK(!queued.IsReady());
+
+    for (const auto& task : background) {
+        CHECK(task.Get().status == 200);
+    }
+    CHECK(queued.WaitFor(std::chrono::milliseconds(1000)));
+    CHECK(helix.Calls().size() == 2 + AsyncExecutor::kMaxWorkers);
+    CHECK(helix.Calls()[1] == "critical");
+    CHECK(helix.Overdrawn() == 0);
+}
+
+int main() {
+    int result = RunTests();
+    AsyncExecutor::Get().Shutdown();
+    return result;
+}
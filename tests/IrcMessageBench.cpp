@@ -0,0 +1,59 @@
+#include "IrcMessage.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// Throughput of ForEachIrcLine + IrcMessage::Parse on what TwitchWebSocket reads:
+// one full PRIVMSG with 16 tags per frame, and frames packing several lines.
+namespace {
+
+    const std::string kPrivmsg =
+        "@badge-info=subscriber/8;badges=subscriber/6,premium/1;client-nonce=0c2bd5e3f4d1a6f8a9b7c6d5e4f3a2b1;"
+        "color=#1E90FF;display-name=SomeViewer;emotes=25:0-4;first-msg=0;flags=;"
+        "id=b34ccfc7-4977-403a-8a94-33c6bac34fb8;mod=0;returning-chatter=0;room-id=12345678;subscriber=1;"
+        "tmi-sent-ts=1700000000000;turbo=0;user-id=87654321;user-type= "
+        ":someviewer!someviewer@someviewer.tmi.twitch.tv PRIVMSG #somechannel :Kappa what a save, that was close\r\n";
+
+    struct Result {
+        double linesPerSecond;
+        double megabytesPerSecond;
+        size_t checksum;
+    };
+
+    Result Measure(const std::string& frame, size_t linesPerFrame) {
+        const size_t rounds = (size_t(4) << 20) / linesPerFrame;
+        size_t checksum = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t round = 0; round < rounds; ++round) {
+            ForEachIrcLine(frame, [&checksum](std::string_view line) {
+                IrcMessage message;
+                if (IrcMessage::Parse(line, message)) {
+                    // What Chat reads for every message
+                    checksum += message.Tag(IrcTag::DisplayName).size() + message.Tag(IrcTag::Color).size() +
+                        message.Nick().size() + message.trailing.size();
+                }
+            });
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double lines = static_cast<double>(rounds * linesPerFrame);
+        return { lines / elapsed.count(), static_cast<double>(rounds * frame.size()) / elapsed.count() / 1e6, checksum };
+    }
+
+} // namespace
+
+int main() {
+    std::printf("%16s %14s %10s %10s\n", "lines per frame", "lines/s", "ns/line", "MB/s");
+    for (size_t linesPerFrame : { size_t(1), size_t(4), size_t(32) }) {
+        std::string frame;
+        for (size_t i = 0; i < linesPerFrame; ++i) {
+            frame += kPrivmsg;
+        }
+        Result result = Measure(frame, linesPerFrame);
+        std::printf("%16zu %14.0f %10.1f %10.1f  (%zu)\n", linesPerFrame, result.linesPerSecond,
+            1e9 / result.linesPerSecond, result.megabytesPerSecond, result.checksum & 0xFF);
+    }
+    return 0;
+}
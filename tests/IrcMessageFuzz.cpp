@@ -0,0 +1,73 @@
+#include "Fuzz.h"
+#include "IrcMessage.h"
+#include <string_view>
+
+// Splits the input into IRC lines and parses each one; every view the parser hands
+// back must point into its own line, and every line into the frame.
+namespace {
+
+    bool Inside(std::string_view view, std::string_view outer) {
+        if (view.empty()) {
+            return true;
+        }
+        return view.data() >= outer.data() && view.data() + view.size() <= outer.data() + outer.size();
+    }
+
+    // A few keys outside IrcTag, to reach the scanning lookup
+    constexpr std::string_view kOtherKeys[] = { "pinned-chat-paid-amount", "msg-param-months", "", "=", "id" };
+
+} // namespace
+
+std::vector<std::string> FuzzSeeds() {
+    return {
+        "@badge-info=subscriber/8;badges=subscriber/6,premium/1;color=#1E90FF;display-name=Viewer;emotes=25:0-4;"
+        "first-msg=0;flags=;id=b34ccfc7-4977-403a-8a94-33c6bac34fb8;mod=0;returning-chatter=0;room-id=12345;"
+        "subscriber=1;tmi-sent-ts=1700000000000;turbo=0;user-id=67890;user-type= "
+        ":viewer!viewer@viewer.tmi.twitch.tv PRIVMSG #channel :Kappa what a save\r\n",
+        "PING :tmi.twitch.tv\r\n",
+        ":tmi.twitch.tv 001 justinfan123 :Welcome, GLHF!\r\n:tmi.twitch.tv 002 justinfan123 :Your host is tmi.twitch.tv\r\n",
+        "@ban-duration=600;room-id=1;target-user-id=2;tmi-sent-ts=3 :tmi.twitch.tv CLEARCHAT #channel :someone\r\n",
+        "@msg-id=subs_on;system-msg=A\\sB\\:C\\\\D\\r\\n :tmi.twitch.tv NOTICE #channel :on",
+        ":a!b@c JOIN #channel",
+        "CAP * ACK :twitch.tv/tags twitch.tv/commands",
+    };
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string_view frame(reinterpret_cast<const char*>(data), size);
+
+    ForEachIrcLine(frame, [frame](std::string_view line) {
+        FUZZ_CHECK(!line.empty() && Inside(line, frame));
+
+        IrcMessage message;
+        if (!IrcMessage::Parse(line, message)) {
+            return;
+        }
+
+        FUZZ_CHECK(!message.command.empty() && Inside(message.command, line));
+        FUZZ_CHECK(Inside(message.tags, line));
+        FUZZ_CHECK(Inside(message.prefix, line));
+        FUZZ_CHECK(message.paramCount <= IrcMessage::kMaxParams);
+        for (size_t i = 0; i < message.paramCount; ++i) {
+            FUZZ_CHECK(Inside(message.params[i], line));
+        }
+        FUZZ_CHECK(Inside(message.trailing, line));
+        FUZZ_CHECK(message.hasTrailing || message.trailing.empty());
+        FUZZ_CHECK(Inside(message.Nick(), message.prefix));
+
+        for (uint8_t id = 0; id < IrcTag::Count; ++id) {
+            std::string_view value = message.Tag(static_cast<IrcTag::Id>(id));
+            FUZZ_CHECK(Inside(value, message.tags));
+            // Unescaping only ever shortens a value
+            FUZZ_CHECK(UnescapeTagValue(value).size() <= value.size());
+            // Looking a known key up by name lands on the same view
+            std::string_view byName = message.Tag(IrcTag::kNames[id]);
+            FUZZ_CHECK(byName.data() == value.data() && byName.size() == value.size());
+        }
+        for (std::string_view key : kOtherKeys) {
+            FUZZ_CHECK(Inside(message.Tag(key), message.tags));
+        }
+        FUZZ_CHECK(!message.HasTag(IrcTag::Unknown));
+    });
+    return 0;
+}
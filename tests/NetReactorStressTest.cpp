@@ -0,0 +1,485 @@
+#include "Check.h"
+#include "NetReactor.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Hundreds of loopback TCP connections through the NetReactor singleton: dispatch,
+// write interest, Post/PostAfter wakes, Remove from either thread and restart after
+// Stop. Built once against epoll and once with NET_REACTOR_POLL for the poll() loop.
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int kConnections = 256;
+
+    struct Pair {
+        int client = -1;    // the test's end, blocking
+        int server = -1;    // registered with the reactor, non-blocking
+    };
+
+    void SetNonBlocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    std::vector<Pair> OpenPairs(int count) {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+        listen(listener, count);
+
+        std::vector<Pair> pairs;
+        for (int i = 0; i < count; ++i) {
+            Pair pair;
+            pair.client = socket(AF_INET, SOCK_STREAM, 0);
+            if (connect(pair.client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                close(pair.client);
+                break;
+            }
+            pair.server = accept(listener, nullptr, nullptr);
+            SetNonBlocking(pair.server);
+            int one = 1;
+            setsockopt(pair.client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            pairs.push_back(pair);
+        }
+        close(listener);
+        return pairs;
+    }
+
+    void ClosePairs(std::vector<Pair>& pairs) {
+        for (Pair& pair : pairs) {
+            close(pair.client);
+            close(pair.server);
+        }
+        pairs.clear();
+    }
+
+    bool SendAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t result = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (result <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(result);
+        }
+        return true;
+    }
+
+    template <typename Fn>
+    bool WaitFor(Fn&& done, std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+        Clock::time_point deadline = Clock::now() + timeout;
+        while (!done()) {
+            if (Clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    // Drains its socket like WebSocketTransport does, and can hold output until the
+    // socket takes it
+    class Handler : public NetReactor::Handler {
+    public:
+        explicit Handler(int socket) : socket_(socket) {}
+
+        void OnReadable() override {
+            Enter();
+            char buffer[4096];
+            while (true) {
+                ssize_t result = recv(socket_, buffer, sizeof(buffer), 0);
+                if (result <= 0) {
+                    break;
+                }
+                received += static_cast<size_t>(result);
+            }
+            if (callbackDelay.count() > 0) {
+                std::this_thread::sleep_for(callbackDelay);
+            }
+            if (removeSelf) {
+                // From the reactor thread: returns without waiting, and no callback follows
+                NetReactor::Get().Remove(this);
+                removed = true;
+            }
+            Leave();
+        }
+
+        bool WantsWrite() override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return written_ < pending_.size();
+        }
+
+        void OnWritable() override {
+            Enter();
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (written_ < pending_.size()) {
+                ssize_t result = send(socket_, pending_.data() + written_, pending_.size() - written_, MSG_NOSIGNAL);
+                if (result <= 0) {
+                    break;
+                }
+                written_ += static_cast<size_t>(result);
+            }
+            writableCalls++;
+            Leave();
+        }
+
+        void OnTick(NetReactor::Clock::time_point) override {
+            Enter();
+            ticks++;
+            Leave();
+        }
+
+        // Reactor thread only, like a transport's sends that hit a full socket
+        void Queue(std::string data) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_ += data;
+        }
+
+        std::atomic<size_t> received{ 0 };
+        std::atomic<int> ticks{ 0 };
+        std::atomic<int> writableCalls{ 0 };
+        // Callbacks that arrived after Remove() returned, or overlapped each other
+        std::atomic<int> violations{ 0 };
+        std::atomic<bool> removed{ false };
+        std::chrono::milliseconds callbackDelay{ 0 };
+        bool removeSelf = false;
+
+    private:
+        void Enter() {
+            if (removed || inCallback_.exchange(true) || !NetReactor::Get().IsReactorThread()) {
+                violations++;
+            }
+        }
+        void Leave() { inCallback_ = false; }
+
+        int socket_;
+        std::atomic<bool> inCallback_{ false };
+        std::mutex mutex_;
+        std::string pending_;
+        size_t written_ = 0;
+    };
+
+    struct Fixture {
+        std::vector<Pair> pairs;
+        std::vector<std::unique_ptr<Handler>> handlers;
+
+        explicit Fixture(int count) {
+            pairs = OpenPairs(count);
+            for (const Pair& pair : pairs) {
+                handlers.push_back(std::make_unique<Handler>(pair.server));
+            }
+        }
+        ~Fixture() {
+            for (auto& handler : handlers) {
+                NetReactor::Get().Remove(handler.get());
+            }
+            handlers.clear();
+            ClosePairs(pairs);
+        }
+
+        void AddAll() {
+            for (size_t i = 0; i < handlers.size(); ++i) {
+                NetReactor::Get().Add(pairs[i].server, handlers[i].get());
+            }
+        }
+        int Violations() const {
+            int total = 0;
+            for (const auto& handler : handlers) {
+                total += handler->violations;
+            }
+            return total;
+        }
+    };
+
+} // namespace
+
+TEST(DispatchesEveryConnection) {
+    Fixture fixture(kConnections);
+    if (!CHECK(fixture.pairs.size() == kConnections)) {
+        return;
+    }
+
+    // Some data is already waiting when the socket is registered
+    std::string early(100, 'e');
+    for (size_t i = 0; i < fixture.pairs.size(); i += 2) {
+        SendAll(fixture.pairs[i].client, early);
+    }
+    fixture.AddAll();
+
+    const std::string chunk(1000, 'x');
+    constexpr int kRounds = 20;
+    for (int round = 0; round < kRounds; ++round) {
+        for (const Pair& pair : fixture.pairs) {
+            SendAll(pair.client, chunk);
+        }
+    }
+
+    bool delivered = WaitFor([&]() {
+        for (size_t i = 0; i < fixture.handlers.size(); ++i) {
+            size_t expected = kRounds * chunk.size() + (i % 2 == 0 ? early.size() : 0);
+            if (fixture.handlers[i]->received != expected) {
+                return false;
+            }
+        }
+        return true;
+    });
+    CHECK(delivered);
+
+    // Every registered handler is ticked
+    CHECK(WaitFor([&]() {
+        return std::all_of(fixture.handlers.begin(), fixture.handlers.end(),
+            [](const auto& handler) { return handler->ticks >= 2; });
+    }));
+    CHECK(fixture.Violations() == 0);
+}
+
+// An idle reactor still runs a post straight away instead of at the next poll timeout
+TEST(PostsWakeTheWait) {
+    Fixture fixture(8);
+    fixture.AddAll();
+    // Let the reactor settle into its wait
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::vector<double> latencies;
+    for (int i = 0; i < 40; ++i) {
+        std::atomic<bool> ran{ false };
+        std::atomic<bool> onReactor{ false };
+        Clock::time_point posted = Clock::now();
+        NetReactor::Get().Post([&ran, &onReactor]() {
+            onReactor = NetReactor::Get().IsReactorThread();
+            ran = true;
+        });
+        CHECK(WaitFor([&ran]() { return ran.load(); }));
+        CHECK(onReactor);
+        latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - posted).count());
+        // Stagger the next post so it lands mid-wait
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double median = latencies[latencies.size() / 2];
+    std::printf("  post latency median %.2f ms, max %.2f ms\n", median, latencies.back());
+    CHECK(median < NetReactor::kPollIntervalMs / 5.0);
+
+    // Many posting threads at once
+    constexpr int kThreads = 8;
+    constexpr int kPostsPerThread = 2000;
+    std::atomic<int> done{ 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&done]() {
+            for (int i = 0; i < kPostsPerThread; ++i) {
+                NetReactor::Get().Post([&done]() { done++; });
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(WaitFor([&done]() { return done == kThreads * kPostsPerThread; }));
+
+    // Timers fire in order, not early, and can schedule more
+    std::vector<int> order;
+    std::atomic<int> fired{ 0 };
+    Clock::time_point start = Clock::now();
+    std::atomic<int64_t> elapsedMs{ 0 };
+    NetReactor::Get().PostAfter(std::chrono::milliseconds(60), [&]() {
+        order.push_back(2);
+        elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        NetReactor::Get().PostAfter(std::chrono::milliseconds(10), [&]() {
+            order.push_back(3);
+            fired++;
+        });
+    });
+    NetReactor::Get().PostAfter(std::chrono::milliseconds(20), [&]() { order.push_back(1); });
+    CHECK(WaitFor([&fired]() { return fired == 1; }));
+    CHECK(order == std::vector<int>{ 1, 2, 3 });
+    CHECK(elapsedMs >= 60);
+    CHECK(fixture.Violations() == 0);
+}
+
+// Remove() off the reactor thread returns only once the handler's callback is done,
+// and nothing reaches the handler afterwards - otherwise destroying it would race
+TEST(RemoveWaitsForCallbacks) {
+    Fixture fixture(kConnections);
+    for (auto& handler : fixture.handlers) {
+        handler->callbackDelay = std::chrono::milliseconds(1);
+    }
+    fixture.AddAll();
+
+    std::atomic<bool> writing{ true };
+    std::thread writer([&]() {
+        const std::string chunk(64, 'w');
+        while (writing) {
+            for (const Pair& pair : fixture.pairs) {
+                send(pair.client, chunk.data(), chunk.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    // Remove every other handler in reverse while traffic flows, and destroy it at once
+    for (size_t i = fixture.handlers.size(); i-- > 0;) {
+        if (i % 2 == 1) {
+            NetReactor::Get().Remove(fixture.handlers[i].get());
+            fixture.handlers[i]->removed = true;
+            if (i % 4 == 1) {
+                CHECK(fixture.handlers[i]->violations == 0);
+                fixture.handlers[i].reset();
+            }
+        }
+    }
+    // Traffic keeps flowing until every handler left registered has been served. A
+    // pass over them all is a millisecond per handler, and where sleeps overshoot
+    // that outlasts any fixed wait.
+    CHECK(WaitFor([&fixture]() {
+        for (size_t i = 0; i < fixture.handlers.size(); i += 2) {
+            if (fixture.handlers[i]->received == 0) {
+                return false;
+            }
+        }
+        return true;
+    }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    writing = false;
+    writer.join();
+
+    int removedViolations = 0;
+    size_t stillReceiving = 0;
+    for (size_t i = 0; i < fixture.handlers.size(); ++i) {
+        if (!fixture.handlers[i]) {
+            continue;
+        }
+        if (i % 2 == 1) {
+            removedViolations += fixture.handlers[i]->violations;
+        } else if (fixture.handlers[i]->received > 0) {
+            stillReceiving++;
+        }
+    }
+    CHECK(removedViolations == 0);
+    // The ones left registered kept being served
+    CHECK(stillReceiving == fixture.handlers.size() / 2);
+
+    fixture.handlers.erase(std::remove(fixture.handlers.begin(), fixture.handlers.end(), nullptr), fixture.handlers.end());
+    CHECK(fixture.Violations() == 0);
+}
+
+// A handler removing itself from its own callback isn't called again
+TEST(RemoveFromCallback) {
+    Fixture fixture(64);
+    for (auto& handler : fixture.handlers) {
+        handler->removeSelf = true;
+    }
+    fixture.AddAll();
+
+    const std::string chunk(10, 'r');
+    for (const Pair& pair : fixture.pairs) {
+        SendAll(pair.client, chunk);
+    }
+    CHECK(WaitFor([&]() {
+        return std::all_of(fixture.handlers.begin(), fixture.handlers.end(),
+            [](const auto& handler) { return handler->removed.load(); });
+    }));
+
+    // More data and a few ticks; none of it may reach the removed handlers
+    for (const Pair& pair : fixture.pairs) {
+        SendAll(pair.client, chunk);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * NetReactor::kTickIntervalMs));
+    CHECK(fixture.Violations() == 0);
+}
+
+// Output the socket can't take yet waits for OnWritable, on every connection at once
+TEST(FlushesWhenWritable) {
+    constexpr int kWriters = 64;
+    constexpr size_t kBytes = 1 << 20;
+    Fixture fixture(kWriters);
+    // Small buffers, so loopback autotuning can't swallow the output in one write
+    for (const Pair& pair : fixture.pairs) {
+        int size = 16 * 1024;
+        setsockopt(pair.server, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(pair.client, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    fixture.AddAll();
+
+    // Far more than the socket buffers hold while the client isn't reading
+    std::atomic<int> queued{ 0 };
+    for (auto& handler : fixture.handlers) {
+        Handler* target = handler.get();
+        NetReactor::Get().Post([target, &queued]() {
+            target->Queue(std::string(kBytes, 'o'));
+            queued++;
+        });
+    }
+    CHECK(WaitFor([&queued]() { return queued == kWriters; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Now read everything, a little from each client in turn
+    std::vector<size_t> read(fixture.pairs.size(), 0);
+    for (const Pair& pair : fixture.pairs) {
+        SetNonBlocking(pair.client);
+    }
+    bool complete = WaitFor([&]() {
+        bool all = true;
+        char buffer[16384];
+        for (size_t i = 0; i < fixture.pairs.size(); ++i) {
+            ssize_t result;
+            while ((result = recv(fixture.pairs[i].client, buffer, sizeof(buffer), 0)) > 0) {
+                read[i] += static_cast<size_t>(result);
+            }
+            all = all && read[i] == kBytes;
+        }
+        return all;
+    }, std::chrono::seconds(20));
+    CHECK(complete);
+
+    for (const auto& handler : fixture.handlers) {
+        // More than one: the first write filled the socket and the rest waited
+        CHECK(handler->writableCalls > 1);
+        CHECK(!handler->WantsWrite());
+    }
+    CHECK(fixture.Violations() == 0);
+}
+
+// Stop() drops every registration; the next Add or Post starts a fresh thread
+TEST(RestartsAfterStop) {
+    NetReactor::Get().Stop();
+
+    Fixture fixture(16);
+    fixture.AddAll();
+    for (const Pair& pair : fixture.pairs) {
+        SendAll(pair.client, "again");
+    }
+    CHECK(WaitFor([&]() {
+        return std::all_of(fixture.handlers.begin(), fixture.handlers.end(),
+            [](const auto& handler) { return handler->received == 5; });
+    }));
+
+    std::atomic<bool> ran{ false };
+    NetReactor::Get().Post([&ran]() { ran = true; });
+    CHECK(WaitFor([&ran]() { return ran.load(); }));
+    CHECK(fixture.Violations() == 0);
+}
+
+int main() {
+#ifdef NET_REACTOR_EPOLL
+    std::printf("backend: epoll\n");
+#else
+    std::printf("backend: poll\n");
+#endif
+    int result = RunTests();
+    NetReactor::Get().Stop();
+    return result;
+}
@@ -0,0 +1,179 @@
+#include "TlsWebSocketServer.h"
+#include "AsyncExecutor.h"
+#include "Chat.h"
+#include "SessionReplay.h"
+#include "logging.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// twitchChatQuickChat_replay as a standalone tool: the plugin's SessionReplay feeds a
+// capture written by twitchChatQuickChat_capture through TwitchEventSub into Chat, and
+// IRC records through TwitchWebSocket, on the reactor thread as in the game. Stubs
+// stand in for the rest:
+//   - support/bakkesmod is the game; its frames run here about every kFrameInterval
+//     and chatbox lines are counted
+//   - the EventSub session is a local server that only sends the welcome
+//   - support/HelixClient.h accepts Chat's subscription
+//
+//   SessionReplayTool <capture> [speed|max]      replay, max (the default) or paced
+//   SessionReplayTool --sample <capture> [count] write a synthetic capture to try it on
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    int WriteSample(const char* path, int count) {
+        if (!SessionCapture::Get().Start(path)) {
+            std::fprintf(stderr, "could not create %s\n", path);
+            return 1;
+        }
+        Clock::time_point at = Clock::now();
+        for (int i = 0; i < count; ++i) {
+            // Roughly a busy channel: a message every 20 ms, a keepalive every 10 s
+            at += std::chrono::milliseconds(20);
+            std::string viewer = "viewer" + std::to_string(i % 97);
+            std::string text = "message " + std::to_string(i) + " \\\"quoted\\\" Kappa";
+            if (i % 500 == 0) {
+                SessionCapture::Get().Write(SessionCapture::EventSub, at,
+                    "{\"metadata\":{\"message_id\":\"k" + std::to_string(i) + "\",\"message_type\":\"session_keepalive\","
+                    "\"message_timestamp\":\"2023-11-06T18:11:47.492253549Z\"},\"payload\":{}}");
+            }
+            if (i % 4 == 3) {
+                SessionCapture::Get().Write(SessionCapture::Irc, at,
+                    "@badge-info=;badges=;color=#1E90FF;display-name=" + viewer + ";emotes=;id=" + std::to_string(i) +
+                    ";mod=0;room-id=1971641;subscriber=0;tmi-sent-ts=1700000000000;turbo=0;user-id=4145994;user-type= :" +
+                    viewer + "!" + viewer + "@" + viewer + ".tmi.twitch.tv PRIVMSG #streamer :" + text + "\r\n");
+                continue;
+            }
+            SessionCapture::Get().Write(SessionCapture::EventSub, at,
+                "{\"metadata\":{\"message_id\":\"m" + std::to_string(i) + "\",\"message_type\":\"notification\","
+                "\"message_timestamp\":\"2023-11-06T18:11:47.492253549Z\",\"subscription_type\":\"channel.chat.message\","
+                "\"subscription_version\":\"1\"},\"payload\":{\"subscription\":{\"id\":\"0b7f3361-672b-4d39-b307-dd5b576c9b27\","
+                "\"status\":\"enabled\",\"type\":\"channel.chat.message\",\"version\":\"1\",\"cost\":0},\"event\":{"
+                "\"broadcaster_user_id\":\"1971641\",\"broadcaster_user_login\":\"streamer\",\"broadcaster_user_name\":\"streamer\","
+                "\"chatter_user_id\":\"4145994\",\"chatter_user_login\":\"" + viewer + "\",\"chatter_user_name\":\"" + viewer +
+                "\",\"message_id\":\"cc106a89-1814-919d-454c-f4f2f970aae7\",\"message\":{\"text\":\"" + text +
+                "\",\"fragments\":[{\"type\":\"text\",\"text\":\"" + text + "\",\"cheermote\":null,\"emote\":null,"
+                "\"mention\":null}]},\"color\":\"#00FF7F\",\"badges\":[],\"message_type\":\"text\",\"cheer\":null,"
+                "\"reply\":null,\"channel_points_custom_reward_id\":null}}}");
+        }
+        std::printf("wrote %llu records to %s\n", static_cast<unsigned long long>(SessionCapture::Get().Stop()), path);
+        return 0;
+    }
+
+    constexpr std::chrono::milliseconds kFrameInterval{ 4 };
+
+    std::string Welcome() {
+        return "{\"metadata\":{\"message_id\":\"96a3f3b5-5dec-4eed-908e-e11ee657416c\",\"message_type\":\"session_welcome\","
+               "\"message_timestamp\":\"2023-07-19T14:56:51.634234626Z\"},\"payload\":{\"session\":{"
+               "\"id\":\"AQoQILE98gtqShGmLD7AM6yJThAB\",\"status\":\"connected\",\"connected_at\":\"2023-07-19T14:56:51.616329898Z\","
+               "\"keepalive_timeout_seconds\":10,\"reconnect_url\":null}}}";
+    }
+
+    // The plugin's chat settings at their defaults
+    std::shared_ptr<CVarManagerWrapper> ChatSettings() {
+        auto cvars = std::make_shared<CVarManagerWrapper>();
+        cvars->registerCvar("twitchChatQuickChat_chat_frame_budget", "10");
+        cvars->registerCvar("twitchChatQuickChat_chat_max_per_second", "0");
+        cvars->registerCvar("twitchChatQuickChat_chat_overflow_policy", "0");
+        cvars->registerCvar("twitchChatQuickChat_chat_sample_every", "5");
+        cvars->registerCvar("twitchChatQuickChat_chat_collapse_duplicates", "0");
+        cvars->registerCvar("twitchChatQuickChat_chat_user_cap", "0");
+        return cvars;
+    }
+
+    void PrintLatency(const char* name, LatencyHistogram& histogram) {
+        LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+        std::printf("  %-22s %8llu  p50 %7lld us  p99 %7lld us  max %7lld us\n", name,
+            static_cast<unsigned long long>(snapshot.count), static_cast<long long>(snapshot.p50Us),
+            static_cast<long long>(snapshot.p99Us), static_cast<long long>(snapshot.maxUs));
+    }
+
+    int Replay(const char* path, double speed) {
+        auto cvars = ChatSettings();
+        // SessionReplay reports through LOG, which writes straight to the console here
+        _globalCvarManager = cvars;
+
+        TlsWebSocketServer server({ Welcome() });
+        TwitchEventSub::Endpoint endpoint;
+        endpoint.host = "127.0.0.1";
+        endpoint.port = server.Port();
+        auto eventSub = std::make_shared<TwitchEventSub>(std::make_shared<HelixClient>(), endpoint);
+
+        auto game = std::make_shared<GameWrapper>();
+        uint64_t chatboxLines = 0;
+        game->onChatbox = [&chatboxLines](const std::string&, const std::string&) { chatboxLines++; };
+
+        auto chat = std::make_unique<Chat>(game, cvars, eventSub);
+        chat->Initialize("2914196", "1971641");
+        chat->Connect();
+
+        // Nothing in the plugin reads IRC chat, so its PRIVMSGs are only counted
+        auto irc = std::make_shared<TwitchWebSocket>();
+        uint64_t ircMessages = 0;
+        irc->SetMessageCallback([&ircMessages](const IrcMessage&) { ircMessages++; });
+
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(10);
+        while (!eventSub->IsConnected() && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        int result = 0;
+        std::string error = SessionReplay::Get().Start(path, speed, eventSub, irc);
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            result = 1;
+        } else {
+            // The game loop: runs until the replay is done and Chat has drained
+            while (SessionReplay::Get().IsRunning() || game->HasQueued()) {
+                game->RunFrame();
+                std::this_thread::sleep_for(kFrameInterval);
+            }
+
+            ChatFloodControl::Stats flood = chat->GetFloodStats();
+            std::printf("chatbox: %llu lines shown (%llu merged, %llu dropped with the queue full, %llu by flood control)\n",
+                static_cast<unsigned long long>(chatboxLines), static_cast<unsigned long long>(flood.merged),
+                static_cast<unsigned long long>(flood.droppedQueueFull),
+                static_cast<unsigned long long>(flood.droppedUserCap + flood.droppedSampled + flood.droppedOverflow));
+            std::printf("irc: %llu PRIVMSGs\n", static_cast<unsigned long long>(ircMessages));
+            std::printf("chat latency:\n");
+            PrintLatency("socket to parsed", chat->GetLatency(Chat::SocketToParsed));
+            PrintLatency("parsed to game thread", chat->GetLatency(Chat::ParsedToGameThread));
+            PrintLatency("game thread to chatbox", chat->GetLatency(Chat::GameThreadToChatbox));
+            PrintLatency("socket to chatbox", chat->GetLatency(Chat::SocketToChatbox));
+        }
+
+        chat->Disconnect();
+        chat.reset();
+        eventSub.reset();
+        irc.reset();
+        AsyncExecutor::Get().Shutdown();
+        NetReactor::Get().Stop();
+        _globalCvarManager.reset();
+        return result;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && std::string_view(argv[1]) == "--sample") {
+        return WriteSample(argv[2], argc >= 4 ? std::atoi(argv[3]) : 10000);
+    }
+    if (argc < 2 || argv[1][0] == '-') {
+        std::fprintf(stderr, "usage: SessionReplayTool <capture> [speed|max]\n"
+                             "       SessionReplayTool --sample <capture> [count]\n");
+        return 2;
+    }
+    double speed = 0.0;
+    if (argc >= 3 && std::string_view(argv[2]) != "max") {
+        speed = std::atof(argv[2]);
+        if (speed <= 0.0) {
+            std::fprintf(stderr, "speed must be a positive number or max\n");
+            return 2;
+        }
+    }
+    return Replay(argv[1], speed);
+}
@@ -0,0 +1,153 @@
+#include "Check.h"
+#include "TlsWebSocketServer.h"
+#include "TwitchEventSub.h"
+#include "AsyncExecutor.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// TwitchEventSub against a local server that plays a session: a welcome followed by
+// chat notifications, with support/HelixClient.h accepting the subscriptions. Covers
+// subscribing on the welcome, closing the session from inside a handler, and replaying
+// captured messages through the same path.
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    std::string Welcome() {
+        return "{\"metadata\":{\"message_id\":\"96a3f3b5-5dec-4eed-908e-e11ee657416c\",\"message_type\":\"session_welcome\","
+               "\"message_timestamp\":\"2023-07-19T14:56:51.634234626Z\"},\"payload\":{\"session\":{"
+               "\"id\":\"AQoQILE98gtqShGmLD7AM6yJThAB\",\"status\":\"connected\",\"connected_at\":\"2023-07-19T14:56:51.616329898Z\","
+               "\"keepalive_timeout_seconds\":10,\"reconnect_url\":null}}}";
+    }
+
+    std::string ChatNotification(const std::string& messageId, const std::string& text) {
+        return "{\"metadata\":{\"message_id\":\"" + messageId + "\",\"message_type\":\"notification\","
+               "\"message_timestamp\":\"2023-11-06T18:11:47.492253549Z\",\"subscription_type\":\"channel.chat.message\","
+               "\"subscription_version\":\"1\"},\"payload\":{\"subscription\":{\"id\":\"sub-1\",\"type\":\"channel.chat.message\","
+               "\"version\":\"1\",\"condition\":{\"broadcaster_user_id\":\"1971641\",\"user_id\":\"2914196\"}},"
+               "\"event\":{\"chatter_user_name\":\"viewer32\",\"message\":{\"text\":\"" + text + "\"}}}}";
+    }
+
+    const std::string kCondition = "{\"broadcaster_user_id\":\"1971641\",\"user_id\":\"2914196\"}";
+
+    template <typename Predicate>
+    bool WaitUntil(Predicate done, std::chrono::milliseconds timeout = std::chrono::milliseconds(10000)) {
+        Clock::time_point deadline = Clock::now() + timeout;
+        while (!done()) {
+            if (Clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+
+    std::shared_ptr<TwitchEventSub> Session(const std::shared_ptr<HelixClient>& helix, const TlsWebSocketServer& server) {
+        TwitchEventSub::Endpoint endpoint;
+        endpoint.host = "127.0.0.1";
+        endpoint.port = server.Port();
+        return std::make_shared<TwitchEventSub>(helix, endpoint);
+    }
+
+} // namespace
+
+// The welcome registers the subscription with Helix and notifications reach the handler
+TEST(SubscribesOnWelcomeAndDelivers) {
+    TlsWebSocketServer server({ Welcome(), ChatNotification("m-1", "hello"), ChatNotification("m-2", "again") });
+    auto helix = std::make_shared<HelixClient>();
+    auto eventSub = Session(helix, server);
+
+    std::atomic<int> delivered{ 0 };
+    auto id = eventSub->Subscribe("channel.chat.message", "1", kCondition, [&delivered](const EventSubMessage&) {
+        delivered++;
+    });
+
+    CHECK(WaitUntil([&]() { return eventSub->IsSubscribed(id); }));
+    CHECK(WaitUntil([&]() { return delivered.load() == 2; }));
+    CHECK(eventSub->IsConnected());
+
+    std::vector<HelixClient::Request> requests = helix->Requests();
+    CHECK(requests.size() == 1);
+    CHECK(!requests.empty() && requests[0].body.find("\"session_id\":\"AQoQILE98gtqShGmLD7AM6yJThAB\"") != std::string::npos);
+
+    eventSub->Unsubscribe(id);
+    CHECK(!eventSub->IsConnected());
+    CHECK(WaitUntil([&]() { return server.Finished() == 1; }));
+}
+
+// Unsubscribing the last handler from inside a dispatch closes the session from the
+// reactor thread while that connection's read is on the stack. The close has to wait
+// until the read returns, and the notification queued behind it is not delivered.
+// The notifications come once Connect() has let go of the connection, so the session
+// holds the last reference (run under ASan to see a close that doesn't wait).
+TEST(UnsubscribesLastHandlerFromDispatch) {
+    TlsWebSocketServer server({ Welcome(), ChatNotification("m-1", "first"), ChatNotification("m-2", "second") },
+        std::chrono::milliseconds(200));
+    auto helix = std::make_shared<HelixClient>();
+    auto eventSub = Session(helix, server);
+
+    std::promise<TwitchEventSub::SubscriptionId> subscribed;
+    std::shared_future<TwitchEventSub::SubscriptionId> idReady = subscribed.get_future().share();
+    std::atomic<int> delivered{ 0 };
+    std::atomic<bool> unsubscribed{ false };
+    auto id = eventSub->Subscribe("channel.chat.message", "1", kCondition,
+        [&delivered, &unsubscribed, idReady, weak = std::weak_ptr<TwitchEventSub>(eventSub)](const EventSubMessage&) {
+            delivered++;
+            if (auto self = weak.lock()) {
+                self->Unsubscribe(idReady.get());
+                unsubscribed = true;
+            }
+        });
+    subscribed.set_value(id);
+
+    CHECK(WaitUntil([&]() { return unsubscribed.load(); }));
+    CHECK(!eventSub->IsConnected());
+    // The posted close reaches the server once the read has unwound
+    CHECK(WaitUntil([&]() { return server.Finished() == 1; }));
+    CHECK(delivered.load() == 1);
+    CHECK(!eventSub->IsSubscribed(id));
+}
+
+// Replayed messages go through the live path's deduplication, on no connection: a
+// captured welcome doesn't register the subscriptions again
+TEST(ReplayDeduplicatesAndIgnoresSessionMessages) {
+    TlsWebSocketServer server({ Welcome(), ChatNotification("m-1", "live") });
+    auto helix = std::make_shared<HelixClient>();
+    auto eventSub = Session(helix, server);
+
+    std::atomic<int> delivered{ 0 };
+    auto id = eventSub->Subscribe("channel.chat.message", "1", kCondition, [&delivered](const EventSubMessage&) {
+        delivered++;
+    });
+    CHECK(WaitUntil([&]() { return delivered.load() == 1; }));
+
+    std::promise<std::vector<size_t>> replayed;
+    NetReactor::Get().Post([&replayed, eventSub]() {
+        NetReactor::Clock::time_point now = NetReactor::Clock::now();
+        replayed.set_value({
+            eventSub->Replay(Welcome(), now),
+            eventSub->Replay(ChatNotification("m-1", "live"), now),
+            eventSub->Replay(ChatNotification("m-2", "captured"), now),
+            eventSub->Replay(ChatNotification("m-2", "captured"), now),
+        });
+    });
+    std::vector<size_t> reached = replayed.get_future().get();
+    CHECK(reached == std::vector<size_t>({ 0, 0, 1, 0 }));
+    CHECK(delivered.load() == 2);
+    CHECK(helix->Requests().size() == 1);
+    CHECK(eventSub->IsConnected());
+
+    eventSub->Unsubscribe(id);
+}
+
+int main() {
+    int result = RunTests();
+    AsyncExecutor::Get().Shutdown();
+    NetReactor::Get().Stop();
+    return result;
+}
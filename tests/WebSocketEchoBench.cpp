@@ -0,0 +1,107 @@
+#include "TlsWebSocketServer.h"
+#include "WebSocketTransport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// WebSocketTransport against a local wss:// echo server: the round trip of one text
+// message at a time, then throughput with a window of messages in flight, at chat
+// sized to snapshot sized payloads. Every echo is compared with what was sent.
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // Waits for the socket like the reactor would, then flushes and drains it
+    bool Pump(WebSocketTransport& transport, const WebSocketTransport::MessageHandler& onMessage) {
+        pollfd pfd = {};
+        pfd.fd = transport.Socket();
+        pfd.events = POLLIN | (transport.HasPendingWrites() ? POLLOUT : 0);
+        if (poll(&pfd, 1, 1000) <= 0) {
+            return false;
+        }
+        if ((pfd.revents & POLLOUT) && !transport.FlushWrites()) {
+            return false;
+        }
+        return transport.ReadMessages(onMessage);
+    }
+
+    struct Result {
+        double p50;
+        double p99;
+        double messagesPerSecond;
+        double megabytesPerSecond;
+        size_t mismatched;
+    };
+
+    Result Measure(WebSocketTransport& transport, size_t size, int roundTrips, int pipelined, int window) {
+        std::string payload(size, 'x');
+        for (size_t i = 0; i < size; ++i) {
+            payload[i] = static_cast<char>('a' + i % 26);
+        }
+        size_t received = 0;
+        size_t mismatched = 0;
+        auto onMessage = [&](const WebSocketFrame& frame) {
+            received++;
+            mismatched += frame.payload != payload;
+        };
+
+        Result result = {};
+        std::vector<double> samples;
+        for (int i = 0; i < roundTrips; ++i) {
+            size_t expected = received + 1;
+            Clock::time_point start = Clock::now();
+            transport.SendText(payload);
+            while (received < expected && Pump(transport, onMessage)) {
+            }
+            samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        std::sort(samples.begin(), samples.end());
+        result.p50 = samples[samples.size() / 2];
+        result.p99 = samples[samples.size() * 99 / 100];
+
+        size_t target = received + pipelined;
+        size_t sent = received;
+        Clock::time_point start = Clock::now();
+        while (received < target) {
+            while (sent < target && sent - received < static_cast<size_t>(window)) {
+                if (!transport.SendText(payload)) {
+                    break;
+                }
+                sent++;
+            }
+            if (!Pump(transport, onMessage)) {
+                break;
+            }
+        }
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        result.messagesPerSecond = pipelined / elapsed.count();
+        result.megabytesPerSecond = result.messagesPerSecond * size / 1e6;
+        result.mismatched = mismatched;
+        return result;
+    }
+
+} // namespace
+
+int main() {
+    TlsWebSocketServer server;
+    WebSocketTransport transport;
+    if (!transport.Connect("127.0.0.1", "/ws", server.Port())) {
+        std::printf("could not connect to the echo server\n");
+        return 1;
+    }
+
+    std::printf("%8s %10s %10s %12s %10s %10s\n", "bytes", "rtt p50 us", "rtt p99 us", "msg/s", "MB/s", "mismatched");
+    for (size_t size : { size_t(64), size_t(512), size_t(4096), size_t(65536) }) {
+        // Keeps the window well under kMaxPendingWrite
+        int window = static_cast<int>((std::min)(size_t(64), (256 * 1024) / size));
+        int pipelined = size >= 65536 ? 2000 : 20000;
+        Result result = Measure(transport, size, 2000, pipelined, window);
+        std::printf("%8zu %10.0f %10.0f %12.0f %10.1f %10zu\n", size, result.p50, result.p99,
+            result.messagesPerSecond, result.megabytesPerSecond, result.mismatched);
+    }
+
+    transport.Close();
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "Check.h"
+#include "WebSocketFrame.h"
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Decoded {
+        uint8_t opcode;
+        std::string payload;
+
+        bool operator==(const Decoded&) const = default;
+    };
+
+    // Encodes one frame the way a server (or, with a mask, a client) would send it
+    std::string Encode(uint8_t opcode, std::string_view payload, bool fin = true, const unsigned char* mask = nullptr) {
+        std::string frame;
+        frame += static_cast<char>((fin ? 0x80 : 0x00) | opcode);
+        unsigned char maskBit = mask ? 0x80 : 0x00;
+        if (payload.size() < 126) {
+            frame += static_cast<char>(maskBit | payload.size());
+        } else if (payload.size() <= 0xFFFF) {
+            frame += static_cast<char>(maskBit | 126);
+            frame += static_cast<char>(payload.size() >> 8);
+            frame += static_cast<char>(payload.size() & 0xFF);
+        } else {
+            frame += static_cast<char>(maskBit | 127);
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                frame += static_cast<char>((static_cast<uint64_t>(payload.size()) >> shift) & 0xFF);
+            }
+        }
+        if (mask) {
+            frame.append(reinterpret_cast<const char*>(mask), 4);
+            for (size_t i = 0; i < payload.size(); ++i) {
+                frame += static_cast<char>(payload[i] ^ mask[i % 4]);
+            }
+        } else {
+            frame.append(payload);
+        }
+        return frame;
+    }
+
+    std::string Pattern(size_t size, char seed) {
+        std::string text(size, '\0');
+        for (size_t i = 0; i < size; ++i) {
+            text[i] = static_cast<char>(seed + i * 7);
+        }
+        return text;
+    }
+
+    // Feeds the stream in chunks of the given sizes (cycled) and collects every message
+    std::vector<Decoded> Feed(WebSocketFrameReader& reader, const std::string& stream, const std::vector<size_t>& chunks) {
+        std::vector<Decoded> decoded;
+        size_t offset = 0;
+        for (size_t i = 0; offset < stream.size(); ++i) {
+            size_t count = (std::min)(chunks[i % chunks.size()], stream.size() - offset);
+            char* space = reader.Prepare(count);
+            std::memcpy(space, stream.data() + offset, count);
+            reader.Commit(count);
+            offset += count;
+
+            WebSocketFrame frame;
+            while (reader.Next(frame)) {
+                decoded.push_back({ frame.opcode, std::string(frame.payload) });
+            }
+            if (reader.HasError()) {
+                break;
+            }
+        }
+        return decoded;
+    }
+
+    struct Stream {
+        std::string bytes;
+        std::vector<Decoded> expected;
+    };
+
+    // Every header length, a fragmented message with a ping in the middle, and a masked frame
+    Stream MixedStream() {
+        static const unsigned char kMask[4] = { 0x12, 0x34, 0x56, 0x78 };
+        Stream stream;
+        auto add = [&stream](uint8_t opcode, const std::string& payload, const unsigned char* mask = nullptr) {
+            stream.bytes += Encode(opcode, payload, true, mask);
+            stream.expected.push_back({ opcode, payload });
+        };
+
+        add(WebSocketOpcode::Text, R"({"metadata":{"message_type":"session_welcome"}})");
+        add(WebSocketOpcode::Text, "");
+        add(WebSocketOpcode::Text, Pattern(125, 'a'));
+        add(WebSocketOpcode::Binary, Pattern(126, 'b'));
+        add(WebSocketOpcode::Text, Pattern(0xFFFF, 'c'));
+        add(WebSocketOpcode::Binary, Pattern(70000, 'd'));
+
+        std::string first = Pattern(3000, 'e');
+        std::string second = Pattern(20, 'f');
+        std::string third = Pattern(50000, 'g');
+        stream.bytes += Encode(WebSocketOpcode::Text, first, false);
+        stream.bytes += Encode(WebSocketOpcode::Continuation, second, false);
+        stream.bytes += Encode(WebSocketOpcode::Ping, "keepalive");
+        stream.bytes += Encode(WebSocketOpcode::Continuation, third, true);
+        stream.expected.push_back({ WebSocketOpcode::Ping, "keepalive" });
+        stream.expected.push_back({ WebSocketOpcode::Text, first + second + third });
+
+        add(WebSocketOpcode::Text, Pattern(1000, 'h'), kMask);
+        add(WebSocketOpcode::Pong, "");
+        add(WebSocketOpcode::Close, std::string("\x03\xE8", 2));
+        return stream;
+    }
+
+} // namespace
+
+TEST(DecodesWholeStream) {
+    Stream stream = MixedStream();
+    WebSocketFrameReader reader;
+    CHECK(Feed(reader, stream.bytes, { stream.bytes.size() }) == stream.expected);
+    CHECK(!reader.HasError());
+    CHECK(reader.Buffered() == 0);
+}
+
+TEST(DecodesByteAtATime) {
+    Stream stream = MixedStream();
+    WebSocketFrameReader reader(16);
+    CHECK(Feed(reader, stream.bytes, { 1 }) == stream.expected);
+    CHECK(!reader.HasError());
+}
+
+TEST(DecodesRandomSplits) {
+    Stream stream = MixedStream();
+    std::mt19937 random(20240611);
+    for (int round = 0; round < 200; ++round) {
+        // Mostly short reads, sometimes a TLS record's worth or more
+        std::vector<size_t> chunks;
+        for (int i = 0; i < 64; ++i) {
+            size_t limit = random() % 4 == 0 ? 40000 : 20;
+            chunks.push_back(1 + random() % limit);
+        }
+        WebSocketFrameReader reader(1 + random() % 64);
+        if (!CHECK(Feed(reader, stream.bytes, chunks) == stream.expected)) {
+            std::fprintf(stderr, "  round %d\n", round);
+            return;
+        }
+        CHECK(reader.Buffered() == 0);
+    }
+}
+
+TEST(KeepsPartialFrameBuffered) {
+    std::string frame = Encode(WebSocketOpcode::Text, Pattern(300, 'x'));
+    WebSocketFrameReader reader;
+    std::vector<Decoded> decoded = Feed(reader, frame.substr(0, frame.size() - 1), { 64 });
+    CHECK(decoded.empty());
+    CHECK(!reader.HasError());
+    CHECK(reader.Buffered() == frame.size() - 1);
+
+    decoded = Feed(reader, frame.substr(frame.size() - 1), { 1 });
+    CHECK(decoded.size() == 1 && decoded[0].payload == Pattern(300, 'x'));
+}
+
+// A data frame that isn't a continuation can't interrupt a fragmented message,
+// whether it arrives in the same read or a later one
+TEST(RejectsDataFrameInsideFragmentedMessage) {
+    for (bool fin : { false, true }) {
+        std::string stream = Encode(WebSocketOpcode::Text, "first half", false) +
+            Encode(WebSocketOpcode::Ping, "") + Encode(WebSocketOpcode::Binary, "interloper", fin);
+        for (size_t split : { stream.size(), size_t(5) }) {
+            WebSocketFrameReader reader;
+            std::vector<Decoded> decoded = Feed(reader, stream, { split });
+            CHECK(decoded == std::vector<Decoded>{ { WebSocketOpcode::Ping, "" } });
+            CHECK(reader.HasError());
+        }
+    }
+}
+
+TEST(RejectsOversizedFrame) {
+    std::string header;
+    header += static_cast<char>(0x80 | WebSocketOpcode::Binary);
+    header += static_cast<char>(127);
+    uint64_t size = WebSocketFrameReader::kMaxMessageSize + 1;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        header += static_cast<char>((size >> shift) & 0xFF);
+    }
+    WebSocketFrameReader reader;
+    CHECK(Feed(reader, header, { header.size() }).empty());
+    CHECK(reader.HasError());
+}
+
+TEST(RejectsContinuationWithoutStart) {
+    WebSocketFrameReader reader;
+    std::string frame = Encode(WebSocketOpcode::Continuation, "orphan");
+    CHECK(Feed(reader, frame, { frame.size() }).empty());
+    CHECK(reader.HasError());
+
+    reader.Reset();
+    CHECK(!reader.HasError());
+    std::string next = Encode(WebSocketOpcode::Text, "after reset");
+    CHECK(Feed(reader, next, { next.size() }) == std::vector<Decoded>{ { WebSocketOpcode::Text, "after reset" } });
+}
+
+int main() {
+    return RunTests();
+}
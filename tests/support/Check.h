@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdio>
+#include <vector>
+
+// Just enough of a test harness for ctest: TEST(name) registers a case, CHECK reports a
+// failed condition and carries on, and RunTests() runs every case and returns the exit
+// code.
+namespace Check {
+
+    struct Case {
+        const char* name;
+        void (*run)();
+    };
+
+    inline std::vector<Case>& Cases() {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    inline int failures = 0;
+
+    struct Registrar {
+        Registrar(const char* name, void (*run)()) { Cases().push_back({ name, run }); }
+    };
+
+    inline bool Report(bool ok, const char* expression, const char* file, int line) {
+        if (!ok) {
+            ++failures;
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+        }
+        return ok;
+    }
+
+} // namespace Check
+
+#define TEST(name) \
+    static void name(); \
+    static Check::Registrar name##Registrar_(#name, name); \
+    static void name()
+
+// Evaluates to the condition, so a case can bail out: if (!CHECK(x)) return;
+#define CHECK(...) Check::Report(static_cast<bool>(__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__)
+
+inline int RunTests() {
+    for (const Check::Case& test : Check::Cases()) {
+        int before = Check::failures;
+        test.run();
+        std::printf("%s %s\n", Check::failures == before ? "ok  " : "FAIL", test.name);
+    }
+    return Check::failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Fuzz targets implement LLVMFuzzerTestOneInput, so with Clang they link against
+// libFuzzer as they are. Elsewhere FuzzDriver.cpp supplies main(): it mutates
+// FuzzSeeds() for -runs=N iterations (or replays the files it is given), which is
+// how ctest runs them.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+// Starting inputs for the standalone driver; libFuzzer ignores them
+std::vector<std::string> FuzzSeeds();
+
+// Aborts rather than counting, so libFuzzer records the input that tripped it
+#define FUZZ_CHECK(...) \
+    do { \
+        if (!(__VA_ARGS__)) { \
+            std::fprintf(stderr, "%s:%d: FUZZ_CHECK(%s) failed\n", __FILE__, __LINE__, #__VA_ARGS__); \
+            std::abort(); \
+        } \
+    } while (false)
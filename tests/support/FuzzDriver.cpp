@@ -0,0 +1,104 @@
+#include "Fuzz.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+// Standalone main() for fuzz targets when libFuzzer isn't available (see Fuzz.h).
+//
+//   Target [-runs=N] [-seed=N]    mutate the seeds N times (default 100000)
+//   Target file...                run each file once, e.g. a crash libFuzzer saved
+namespace {
+
+    // Bytes the parsers give meaning to, so mutations reach the interesting branches
+    constexpr char kSpecial[] = " :@;=!\\\r\n{}[]\",";
+
+    std::string Mutate(std::string input, std::mt19937& random) {
+        int edits = 1 + static_cast<int>(random() % 4);
+        for (int i = 0; i < edits; ++i) {
+            size_t at = input.empty() ? 0 : random() % (input.size() + 1);
+            switch (random() % 6) {
+            case 0:     // flip a byte
+                if (at < input.size()) {
+                    input[at] = static_cast<char>(random());
+                }
+                break;
+            case 1:     // insert a meaningful byte
+                input.insert(input.begin() + at, kSpecial[random() % (sizeof(kSpecial) - 1)]);
+                break;
+            case 2:     // delete a run
+                if (at < input.size()) {
+                    input.erase(at, 1 + random() % 8);
+                }
+                break;
+            case 3:     // duplicate a run
+                if (at < input.size()) {
+                    input.insert(at, input.substr(at, 1 + random() % 16));
+                }
+                break;
+            case 4:     // cut short
+                input.resize(at);
+                break;
+            default:    // replace with a meaningful byte
+                if (at < input.size()) {
+                    input[at] = kSpecial[random() % (sizeof(kSpecial) - 1)];
+                }
+                break;
+            }
+        }
+        return input;
+    }
+
+    void Run(const std::string& input) {
+        // A copy of exactly the input's size, so reads past the end show up under ASan
+        std::vector<uint8_t> data(input.begin(), input.end());
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long runs = 100000;
+    unsigned seed = 1;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "-runs=", 6) == 0) {
+            runs = std::atol(argv[i] + 6);
+        } else if (std::strncmp(argv[i], "-seed=", 6) == 0) {
+            seed = static_cast<unsigned>(std::atol(argv[i] + 6));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (!files.empty()) {
+        for (const char* path : files) {
+            std::ifstream file(path, std::ios::binary);
+            Run(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+        }
+        std::printf("ran %zu inputs\n", files.size());
+        return 0;
+    }
+
+    std::vector<std::string> corpus = FuzzSeeds();
+    corpus.push_back({});
+    for (const std::string& input : corpus) {
+        Run(input);
+    }
+
+    std::mt19937 random(seed);
+    for (long i = 0; i < runs; ++i) {
+        std::string input = corpus[random() % corpus.size()];
+        // Stack a few rounds so inputs drift further from the seeds
+        for (int round = static_cast<int>(random() % 3); round >= 0; --round) {
+            input = Mutate(std::move(input), random);
+        }
+        Run(input);
+        // Keep some mutants around to mutate further, without letting the corpus grow unbounded
+        if (corpus.size() < 512 && random() % 64 == 0) {
+            corpus.push_back(std::move(input));
+        }
+    }
+    std::printf("ran %ld mutated inputs\n", runs);
+    return 0;
+}
@@ -0,0 +1,5 @@
+#include "pch.h"
+
+// Defined by the plugin in TwitchChatQuickChat.cpp; left empty here, so AsyncLog
+// only writes to the sink a test gives it
+std::shared_ptr<CVarManagerWrapper> _globalCvarManager;
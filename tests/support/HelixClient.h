@@ -0,0 +1,70 @@
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "HelixScheduler.h"
+
+// Stands in for the plugin's HelixClient, which needs cpp-httplib. It is copied
+// beside the plugin sources that include it (see CMakeLists.txt), so those build
+// unchanged: results test true when there was a response and have status and body.
+//
+// Nothing goes over the network. Every request is recorded; EventSub subscriptions
+// are accepted with a made-up id and everything else gets an empty 200.
+class HelixClient
+{
+public:
+    struct Response {
+        int status = 0;
+        std::string body;
+    };
+    using Result = std::optional<Response>;
+
+    struct Request {
+        std::string method;
+        std::string path;
+        std::string body;
+    };
+
+    HelixClient() = default;
+
+    void SetAccessToken(const std::string&) {}
+
+    Result Get(const std::string& path, HelixPriority = HelixPriority::Normal) {
+        return Send({ "GET", path, {} });
+    }
+    Result Post(const std::string& path, const std::string& body, HelixPriority = HelixPriority::Normal) {
+        return Send({ "POST", path, body });
+    }
+    Result Patch(const std::string& path, const std::string& body, HelixPriority = HelixPriority::Normal) {
+        return Send({ "PATCH", path, body });
+    }
+    Result Delete(const std::string& path, HelixPriority = HelixPriority::Normal) {
+        return Send({ "DELETE", path, {} });
+    }
+
+    void Warm() {}
+
+    std::vector<Request> Requests() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return requests_;
+    }
+
+private:
+    Result Send(Request request) {
+        size_t count;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            requests_.push_back(request);
+            count = requests_.size();
+        }
+        if (request.method == "POST" && request.path == "/helix/eventsub/subscriptions") {
+            return Response{ 202, "{\"data\":[{\"id\":\"sub-" + std::to_string(count) + "\",\"status\":\"enabled\"}]}" };
+        }
+        return Response{ 200, {} };
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<Request> requests_;
+};
@@ -0,0 +1,252 @@
+#pragma once
+#include "WebSocketFrame.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+// A wss:// server on 127.0.0.1 for the network tests and benchmarks: a self-signed
+// P-256 certificate made at startup, the upgrade handshake, an optional scripted
+// greeting, and every text or binary message sent straight back unmasked. The server keeps OpenSSL's default session
+// cache and TLS 1.3 tickets, so TlsContext can resume against it.
+// One thread per connection, blocking sockets; Linux only.
+class TlsWebSocketServer {
+public:
+    // greeting is sent to each client as text messages right after the upgrade, e.g.
+    // an EventSub session_welcome and the notifications that follow it. The messages
+    // after the first wait for settle, then go out back to back.
+    explicit TlsWebSocketServer(std::vector<std::string> greeting = {},
+                                std::chrono::milliseconds settle = std::chrono::milliseconds(0))
+        : greeting_(std::move(greeting)), settle_(settle) {
+        ctx_ = SSL_CTX_new(TLS_server_method());
+        EVP_PKEY* key = GenerateKey();
+        X509* cert = SelfSign(key);
+        SSL_CTX_use_certificate(ctx_, cert);
+        SSL_CTX_use_PrivateKey(ctx_, key);
+        X509_free(cert);
+        EVP_PKEY_free(key);
+
+        listener_ = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length);
+        listen(listener_, 64);
+        port_ = std::to_string(ntohs(address.sin_port));
+
+        acceptThread_ = std::thread([this]() { AcceptLoop(); });
+    }
+
+    ~TlsWebSocketServer() {
+        stopping_ = true;
+        acceptThread_.join();
+        close(listener_);
+        {
+            // Unblocks connection threads still waiting on a client
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : open_) {
+                shutdown(fd, SHUT_RDWR);
+            }
+        }
+        for (std::thread& thread : connections_) {
+            thread.join();
+        }
+        SSL_CTX_free(ctx_);
+    }
+
+    TlsWebSocketServer(const TlsWebSocketServer&) = delete;
+    TlsWebSocketServer& operator=(const TlsWebSocketServer&) = delete;
+
+    const std::string& Port() const { return port_; }
+    uint64_t Accepted() const { return accepted_.load(); }
+    // Connections the client has closed (or dropped) since
+    uint64_t Finished() const { return finished_.load(); }
+
+private:
+    static EVP_PKEY* GenerateKey() {
+        EVP_PKEY* key = nullptr;
+        EVP_PKEY_CTX* keyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+        EVP_PKEY_keygen_init(keyCtx);
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyCtx, NID_X9_62_prime256v1);
+        EVP_PKEY_keygen(keyCtx, &key);
+        EVP_PKEY_CTX_free(keyCtx);
+        return key;
+    }
+
+    static X509* SelfSign(EVP_PKEY* key) {
+        X509* cert = X509_new();
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        X509_sign(cert, key, EVP_sha256());
+        return cert;
+    }
+
+    void AcceptLoop() {
+        pollfd pfd = {};
+        pfd.fd = listener_;
+        pfd.events = POLLIN;
+        while (!stopping_) {
+            if (poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            int fd = accept(listener_, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            accepted_++;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            open_.push_back(fd);
+            connections_.emplace_back([this, fd]() {
+                Serve(fd);
+                std::lock_guard<std::mutex> lock(mutex_);
+                open_.erase(std::find(open_.begin(), open_.end(), fd));
+                close(fd);
+            });
+        }
+    }
+
+    void Serve(int fd) {
+        SSL* ssl = SSL_new(ctx_);
+        SSL_set_fd(ssl, fd);
+        if (SSL_accept(ssl) == 1 && Upgrade(ssl) && Greet(ssl)) {
+            Echo(ssl);
+        }
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+        finished_++;
+    }
+
+    static bool Upgrade(SSL* ssl) {
+        std::string request;
+        char buffer[4096];
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            int bytesRead = SSL_read(ssl, buffer, sizeof(buffer));
+            if (bytesRead <= 0 || request.size() > 16 * 1024) {
+                return false;
+            }
+            request.append(buffer, static_cast<size_t>(bytesRead));
+        }
+
+        static const std::string kKeyHeader = "Sec-WebSocket-Key: ";
+        size_t keyStart = request.find(kKeyHeader);
+        if (keyStart == std::string::npos) {
+            return false;
+        }
+        keyStart += kKeyHeader.size();
+        std::string key = request.substr(keyStart, request.find("\r\n", keyStart) - keyStart);
+        key += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digestLength = 0;
+        EVP_Digest(key.data(), key.size(), digest, &digestLength, EVP_sha1(), nullptr);
+        unsigned char accept[64];
+        EVP_EncodeBlock(accept, digest, static_cast<int>(digestLength));
+
+        std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                               "Sec-WebSocket-Accept: " + std::string(reinterpret_cast<char*>(accept)) + "\r\n\r\n";
+        return SSL_write(ssl, response.data(), static_cast<int>(response.size())) > 0;
+    }
+
+    bool Greet(SSL* ssl) const {
+        std::vector<unsigned char> out;
+        for (size_t i = 0; i < greeting_.size(); ++i) {
+            if (i == 1) {
+                std::this_thread::sleep_for(settle_);
+            }
+            if (!WriteFrame(ssl, WebSocketOpcode::Text, greeting_[i], out)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void Echo(SSL* ssl) {
+        WebSocketFrameReader reader;
+        WebSocketFrame frame;
+        std::vector<unsigned char> out;
+        while (true) {
+            while (reader.Next(frame)) {
+                if (frame.opcode == WebSocketOpcode::Close) {
+                    WriteFrame(ssl, WebSocketOpcode::Close, frame.payload.substr(0, 2), out);
+                    return;
+                }
+                if (frame.opcode == WebSocketOpcode::Text || frame.opcode == WebSocketOpcode::Binary) {
+                    if (!WriteFrame(ssl, frame.opcode, frame.payload, out)) {
+                        return;
+                    }
+                }
+            }
+            if (reader.HasError()) {
+                return;
+            }
+            int bytesRead = SSL_read(ssl, reader.Prepare(16 * 1024), 16 * 1024);
+            if (bytesRead <= 0) {
+                return;
+            }
+            reader.Commit(static_cast<size_t>(bytesRead));
+        }
+    }
+
+    // Server frames go out unmasked, as RFC 6455 requires
+    static bool WriteFrame(SSL* ssl, uint8_t opcode, std::string_view payload, std::vector<unsigned char>& out) {
+        out.clear();
+        out.push_back(static_cast<unsigned char>(0x80 | opcode));
+        size_t len = payload.size();
+        if (len <= 125) {
+            out.push_back(static_cast<unsigned char>(len));
+        } else if (len <= 65535) {
+            out.push_back(126);
+            out.push_back(static_cast<unsigned char>(len >> 8));
+            out.push_back(static_cast<unsigned char>(len & 0xFF));
+        } else {
+            out.push_back(127);
+            for (int i = 7; i >= 0; --i) {
+                out.push_back(static_cast<unsigned char>((static_cast<uint64_t>(len) >> (8 * i)) & 0xFF));
+            }
+        }
+        out.insert(out.end(), payload.begin(), payload.end());
+        return SSL_write(ssl, out.data(), static_cast<int>(out.size())) == static_cast<int>(out.size());
+    }
+
+    const std::vector<std::string> greeting_;
+    const std::chrono::milliseconds settle_;
+    SSL_CTX* ctx_ = nullptr;
+    int listener_ = -1;
+    std::string port_;
+    std::atomic<bool> stopping_{ false };
+    std::atomic<uint64_t> accepted_{ 0 };
+    std::atomic<uint64_t> finished_{ 0 };
+    std::thread acceptThread_;
+
+    std::mutex mutex_;
+    std::vector<int> open_;
+    std::vector<std::thread> connections_;
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+// Stands in for the SDK's plugin header with just the wrappers the plugin sources
+// built here use
+#include "bakkesmod/wrappers/cvarmanagerwrapper.h"
+#include "bakkesmod/wrappers/GameWrapper.h"
@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The game side of the BakkesMod SDK that Chat uses, with the test driving the frames:
+// Execute() and SetTimeout() queue work for the next RunFrame() that reaches it, and
+// chatbox lines go to onChatbox. Call RunFrame() from one thread, the "game thread".
+class GameWrapper {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void(GameWrapper*)>;
+
+    void Execute(Callback callback) { SetTimeout(std::move(callback), 0.0f); }
+
+    void SetTimeout(Callback callback, float seconds) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.push_back({ Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(seconds)),
+                            std::move(callback) });
+    }
+
+    void LogToChatbox(std::string text, std::string sender) {
+        if (onChatbox) {
+            onChatbox(text, sender);
+        }
+    }
+
+    // Runs what is due; returns how many callbacks ran
+    size_t RunFrame() {
+        std::vector<Callback> due;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Clock::time_point now = Clock::now();
+            for (auto it = queued_.begin(); it != queued_.end();) {
+                if (it->first <= now) {
+                    due.push_back(std::move(it->second));
+                    it = queued_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (Callback& callback : due) {
+            callback(this);
+        }
+        return due.size();
+    }
+
+    bool HasQueued() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !queued_.empty();
+    }
+
+    std::function<void(const std::string& text, const std::string& sender)> onChatbox;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::pair<Clock::time_point, Callback>> queued_;
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include "cvarwrapper.h"
+
+// What logging.h and Chat need from the BakkesMod SDK: somewhere for lines to go when
+// AsyncLog has no console sink (stdout), and cvars to read settings from.
+class CVarManagerWrapper {
+public:
+    void log(const std::string& text) { std::printf("%s\n", text.c_str()); }
+    void log(const std::wstring& text) { std::printf("%ls\n", text.c_str()); }
+
+    // The SDK's range and flag arguments aren't modelled
+    CVarWrapper registerCvar(const std::string& name, const std::string& defaultValue, const std::string& = {}) {
+        auto& value = cvars_[name];
+        if (!value) {
+            value = std::make_shared<std::string>(defaultValue);
+        }
+        return CVarWrapper(value);
+    }
+
+    CVarWrapper getCvar(const std::string& name) {
+        auto it = cvars_.find(name);
+        return it != cvars_.end() ? CVarWrapper(it->second) : CVarWrapper();
+    }
+
+private:
+    std::map<std::string, std::shared_ptr<std::string>> cvars_;
+};
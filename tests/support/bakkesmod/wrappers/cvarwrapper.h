@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+// A cvar as the plugin reads it; a default-constructed one is the null cvar getCvar()
+// returns for unknown names
+class CVarWrapper {
+public:
+    CVarWrapper() = default;
+    explicit CVarWrapper(std::shared_ptr<std::string> value) : value_(std::move(value)) {}
+
+    explicit operator bool() const { return value_ != nullptr; }
+
+    std::string getStringValue() const { return value_ ? *value_ : std::string(); }
+    int getIntValue() const { return value_ ? std::atoi(value_->c_str()) : 0; }
+    float getFloatValue() const { return value_ ? static_cast<float>(std::atof(value_->c_str())) : 0.0f; }
+    bool getBoolValue() const { return getIntValue() != 0; }
+
+    void setValue(std::string value) {
+        if (value_) {
+            *value_ = std::move(value);
+        }
+    }
+    void setValue(int value) { setValue(std::to_string(value)); }
+
+private:
+    std::shared_ptr<std::string> value_;
+};
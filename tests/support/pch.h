@@ -0,0 +1,12 @@
+#pragma once
+
+// Stands in for the plugin's pch.h, which pulls in the BakkesMod SDK and ImGui. The
+// sources built here only need logging.h, whose one SDK header is stubbed under
+// support/bakkesmod.
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+
+#include "logging.h"